@@ -0,0 +1,45 @@
+#ifndef MARTHA_DATA_NAMES_H
+#define MARTHA_DATA_NAMES_H
+
+// Data names only MARTHA logs. The shared names live in the Avionics
+// submodule (data_handling/DataNames.h); these start well above them so the
+// two sets never collide in the log.
+
+#include "data_handling/DataNames.h"
+
+#ifndef ALTITUDE
+#define ALTITUDE 100
+#endif
+
+#define VERTICAL_VELOCITY 101
+#define PREDICTED_APOGEE_TIME 102
+#define APOGEE_DETECTED_TIME 103
+#define APOGEE_UPDATE_MICROS 104
+#define VERTICAL_LINEAR_ACCELERATION 105
+#define FUSION_GAIN_REFRESH_MICROS 106
+#define GYROSCOPE_BIAS_X 107
+#define GYROSCOPE_BIAS_Y 108
+#define GYROSCOPE_BIAS_Z 109
+
+#ifndef MAGNETOMETER_X
+#define MAGNETOMETER_X 110
+#define MAGNETOMETER_Y 111
+#define MAGNETOMETER_Z 112
+#endif
+
+#define PAD_AWAKE 113
+#define STRAPDOWN_VELOCITY_N 114
+#define STRAPDOWN_VELOCITY_E 115
+#define STRAPDOWN_VELOCITY_D 116
+#define STRAPDOWN_POSITION_N 117
+#define STRAPDOWN_POSITION_E 118
+#define STRAPDOWN_POSITION_D 119
+
+// Mean and max cycles of each NXP fusion stage (NXP_STAGE_* added to the
+// base) per logging interval, only logged by AHRS_NXP_PROFILE builds
+#define FUSION_STAGE_CYCLES_MEAN 120 // to 126
+#define FUSION_STAGE_CYCLES_MAX 127  // to 133
+
+#define APOGEE_UPDATE_OVERRUNS 134
+
+#endif
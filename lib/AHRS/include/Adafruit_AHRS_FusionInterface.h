@@ -29,6 +29,26 @@
 #ifndef ADAFRUIT_AHRS_FUSIONINTERFACE_H_
 #define ADAFRUIT_AHRS_FUSIONINTERFACE_H_
 
+#include <stdint.h>
+
+/*!
+ * @brief A block of sensor samples in struct-of-arrays layout, for example one
+ * FIFO read. Every array holds count samples, oldest first.
+ */
+typedef struct {
+  const float *gx; ///< gyroscope x axis (DPS)
+  const float *gy; ///< gyroscope y axis (DPS)
+  const float *gz; ///< gyroscope z axis (DPS)
+  const float *ax; ///< accelerometer x axis (g)
+  const float *ay; ///< accelerometer y axis (g)
+  const float *az; ///< accelerometer z axis (g)
+  const float *mx; ///< magnetometer x axis (uT)
+  const float *my; ///< magnetometer y axis (uT)
+  const float *mz; ///< magnetometer z axis (uT)
+  const uint32_t *timestamp_us; ///< sample times (us)
+  uint16_t count;               ///< number of samples
+} Adafruit_AHRS_SampleBlock;
+
 /*!
  * @brief The common interface for the fusion algorithms.
  */
@@ -62,6 +82,23 @@ public:
   virtual void update(float gx, float gy, float gz, float ax, float ay,
                       float az, float mx, float my, float mz) = 0;
 
+  /**************************************************************************/
+  /*!
+   * @brief Updates the filter with a block of samples. The default calls
+   * update() once per sample; filters that can share work across the block
+   * override it. The samples are assumed to arrive at the rate given to
+   * begin(), the timestamps are there for filters that need them.
+   *
+   * @param block The samples, oldest first.
+   */
+  /**************************************************************************/
+  virtual void updateBatch(const Adafruit_AHRS_SampleBlock &block) {
+    for (uint16_t k = 0; k < block.count; k++) {
+      update(block.gx[k], block.gy[k], block.gz[k], block.ax[k], block.ay[k],
+             block.az[k], block.mx[k], block.my[k], block.mz[k]);
+    }
+  }
+
   /**************************************************************************/
   /*!
    * @brief Gets the current roll of the sensors.
@@ -0,0 +1,165 @@
+/*!
+ * @file Adafruit_AHRS_MagCalibration.h
+ *
+ * Incremental hard and soft iron magnetometer calibration after the 4 and 10
+ * element eigenvalue fits of the NXP sensor fusion library (magnetic.c),
+ * https://github.com/memsindustrygroup/Open-Source-Sensor-Fusion
+ */
+
+#ifndef __Adafruit_AHRS_MagCalibration_h__
+#define __Adafruit_AHRS_MagCalibration_h__
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+#define MAGCAL_SCALE_UT 50.0F  // readings are scaled by this before summing
+#define MAGCAL_MIN_STEP_UT 5.0F // smallest change from the last sample used
+#define MAGCAL_MAX_SAMPLES 1024.0F // the sums are halved at this weight
+#define MAGCAL_MIN_SAMPLES_4 24.0F  // samples before a 4 element fit
+#define MAGCAL_MIN_SAMPLES_10 100.0F // samples before a 10 element fit
+#define MAGCAL_MIN_SPREAD 0.2F // smallest rms spread of the samples along any
+                               // direction, as a fraction of the field
+#define MAGCAL_MIN_B_UT 22.0F  // smallest plausible geomagnetic field (uT)
+#define MAGCAL_MAX_B_UT 67.0F  // largest plausible geomagnetic field (uT)
+#define MAGCAL_MAX_FIT_ERROR_PC 10.0F // largest fit error accepted (%)
+#define MAGCAL_FIT_ERROR_AGING 1.02F  // growth of the fit error per solve
+#define MAGCAL_SUMS 55 // packed upper triangle of the 10x10 normal matrix
+#define MAGCAL_MAX_SWEEPS 16 // Jacobi sweeps of the 10 element fit, as
+                             // eigencompute()
+
+/*!
+ * @brief Magnetometer calibration that learns the hard iron offset V and the
+ * inverse soft iron matrix invW while the magnetometer is read.
+ *
+ * The original NXP calibration keeps a buffer of readings and refits it.
+ * Here every reading that has moved far enough from the last one is folded
+ * into the 55 sums of the normal matrix of the 10 element ellipsoid fit, a
+ * fixed amount of work and no buffer. Both fits follow from those sums: the
+ * 10 element eigenvalue fit once there are enough samples, else the 4 element
+ * hard iron fit with fmatrixAeqInvA(). The result is kept if its fit error
+ * beats the current calibration. Halving the sums at MAGCAL_MAX_SAMPLES keeps
+ * them in float range and lets old readings fade out.
+ *
+ * The 10x10 Jacobi eigen decomposition of the fit takes milliseconds, too long
+ * for one pass of a flight loop. Like the time sliced calibration of the NXP
+ * library, startSolve() snapshots the sums and each solveStep() then does a
+ * bounded slice of the fit, at most one Jacobi rotation, so the loop can run
+ * one step per pass. solve() runs all the steps at once.
+ *
+ * The calibrated field is invW * (m - V). Pass it and getFieldStrength() to
+ * the fusion filter, which uses 4 * B^2 as its magnetic jamming threshold.
+ */
+class Adafruit_AHRS_MagCalibration {
+public:
+  /**************************************************************************/
+  /*!
+   * @brief Clears the sums and the calibration.
+   */
+  /**************************************************************************/
+  void begin();
+
+  /**************************************************************************/
+  /*!
+   * @brief Adds an uncalibrated magnetometer reading to the fit. Readings
+   * closer than MAGCAL_MIN_STEP_UT to the last one used are skipped so hours
+   * on the pad do not outweigh the orientations that matter.
+   *
+   * @param mx The magnetometer x axis. In uT.
+   * @param my The magnetometer y axis. In uT.
+   * @param mz The magnetometer z axis. In uT.
+   */
+  /**************************************************************************/
+  void addSample(float mx, float my, float mz);
+
+  /**************************************************************************/
+  /*!
+   * @brief Fits the calibration to the readings added so far, all steps at
+   * once.
+   *
+   * @return True if the fit replaced the calibration.
+   */
+  /**************************************************************************/
+  bool solve();
+
+  /**************************************************************************/
+  /*!
+   * @brief Starts a fit to the readings added so far, abandoning any fit
+   * still running. Readings added afterwards count towards the next fit.
+   */
+  /**************************************************************************/
+  void startSolve();
+
+  /**************************************************************************/
+  /*!
+   * @brief Runs the next slice of the fit started by startSolve().
+   *
+   * @return True if the fit finished and replaced the calibration.
+   */
+  /**************************************************************************/
+  bool solveStep();
+
+  bool isSolving() const { return Step != 0; }
+
+  /**************************************************************************/
+  /*!
+   * @brief Applies the calibration to a reading.
+   *
+   * @param mx The magnetometer x axis. In uT.
+   * @param my The magnetometer y axis. In uT.
+   * @param mz The magnetometer z axis. In uT.
+   * @param cx The pointer to write the calibrated x axis to. In uT.
+   * @param cy The pointer to write the calibrated y axis to. In uT.
+   * @param cz The pointer to write the calibrated z axis to. In uT.
+   */
+  /**************************************************************************/
+  void apply(float mx, float my, float mz, float *cx, float *cy,
+             float *cz) const;
+
+  bool isValid() const { return ValidMagCal != 0; }
+  float getFieldStrength() const { return B; }
+  float getFourBsq() const { return FourBsq; }
+  float getFitError() const { return FitErrorpc; }
+  uint8_t getSolver() const { return Solver; }
+  float getSampleWeight() const { return Sums[MAGCAL_SUMS - 1]; }
+
+  float V[3];       // hard iron offset (uT)
+  float invW[3][3]; // inverse soft iron matrix
+
+private:
+  bool solve4(float *pfB, float *pfFitErrorpc, float fV[]);
+  bool solve10(float *pfB, float *pfFitErrorpc, float fV[],
+               float finvW[][3]);
+  float minSpread();
+  bool finishSolve();
+
+  float Sums[MAGCAL_SUMS]; // normal matrix of the 10 element fit (packed)
+  float Ref[3];            // first reading, subtracted before summing (uT)
+  float Last[3];           // last reading added to the sums (uT)
+  float B;                 // geomagnetic field strength (uT)
+  float FourBsq;           // 4 * B * B (uT^2)
+  float FitErrorpc;        // fit error of the calibration (%)
+  int8_t ValidMagCal;      // a calibration has been accepted
+  int8_t HaveRef;          // Ref and Last hold a reading
+  uint8_t Solver;          // 0 none, 4 or 10 elements
+
+  // state of the running fit, see solveStep(). The Eig arrays are also the
+  // scratch of the 3x3 decompositions in minSpread() and solve10()
+  float EigA[10][10];    // normal matrix being diagonalized
+  float EigVec[10][10];  // eigenvectors so far
+  float EigVal[10];      // eigenvalues so far
+  float SolveN;          // sample weight of the snapshot
+  float SolveSpread;     // smallest rms spread of the snapshot (uT)
+  float SolveB4;         // field strength of the 4 element fit (uT)
+  float SolveFitError4pc; // fit error of the 4 element fit (%)
+  float SolveV4[3];      // hard iron offset of the 4 element fit (uT)
+  int8_t SolveValid4;    // the 4 element fit succeeded
+  uint8_t Step;          // next MAGCAL_STEP_* slice, 0 if no fit is running
+  int8_t SweepRow;       // element of the next Jacobi rotation
+  int8_t SweepCol;
+  int8_t Sweeps;         // Jacobi sweeps started
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*!
+ * @file Adafruit_AHRS_Mahony.h
+ *
+ * 6DOF Mahony complementary filter after Adafruit_AHRS_Mahony from
+ * https://github.com/adafruit/Adafruit_AHRS, itself based on MahonyAHRS.c by
+ * SOH Madgwick (2011) and on R Mahony et al., "Nonlinear Complementary
+ * Filters on the Special Orthogonal Group" (2008).
+ */
+
+#ifndef __Adafruit_Mahony_h__
+#define __Adafruit_Mahony_h__
+
+#include "Adafruit_AHRS_FusionInterface.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+#define DEFAULT_MAHONY_KP 0.5f // proportional gain (1/s)
+#define DEFAULT_MAHONY_KI 0.0f // integral gain (1/s^2)
+
+/*!
+ * @brief Mahony complementary filter on gyroscope and accelerometer.
+ *
+ * The lightweight counterpart of Adafruit_NXPSensorFusion for running at the
+ * full IMU rate: a quaternion, the integral feedback and a few outputs, about
+ * a hundred bytes of state and a few dozen multiplies per update. The
+ * accelerometer pulls the gyro-integrated orientation towards gravity with
+ * the proportional gain Kp, and the integral gain Ki learns the gyro offset.
+ * The magnetometer is not used, so yaw is the integrated gyro.
+ *
+ * Uses the conventions of Adafruit_NXPSensorFusion so both filters can be
+ * swapped and compared: NED global frame, a sensor frame vector is
+ * R * (global frame vector), the accelerometer reads +1 g along the down
+ * axis, and roll, pitch, yaw and tilt are the NXP NED angles.
+ */
+class Adafruit_Mahony final : public Adafruit_AHRS_FusionInterface {
+public:
+  /**************************************************************************/
+  /*!
+   * @brief Constructs the filter with the default gains.
+   */
+  /**************************************************************************/
+  Adafruit_Mahony() : Adafruit_Mahony(DEFAULT_MAHONY_KP, DEFAULT_MAHONY_KI) {}
+
+  /**************************************************************************/
+  /*!
+   * @brief Constructs the filter.
+   *
+   * @param prop_gain The proportional gain Kp (1/s).
+   * @param int_gain The integral gain Ki (1/s^2), 0 to not learn the gyro
+   * offset.
+   */
+  /**************************************************************************/
+  Adafruit_Mahony(float prop_gain, float int_gain);
+
+  /**************************************************************************/
+  /*!
+   * @brief Initializes the filter. The first update with an accelerometer
+   * reading seeds the orientation from the measured tilt, with zero yaw.
+   *
+   * @param sampleFrequency The sensor sample rate in herz(samples per second).
+   */
+  /**************************************************************************/
+  void begin(float sampleFrequency = 100.0f);
+
+  /**************************************************************************/
+  /*!
+   * @brief Updates the filter with new gyroscope and accelerometer data. The
+   * magnetometer readings are ignored.
+   *
+   * @param gx The gyroscope x axis. In DPS.
+   * @param gy The gyroscope y axis. In DPS.
+   * @param gz The gyroscope z axis. In DPS.
+   * @param ax The accelerometer x axis. In g.
+   * @param ay The accelerometer y axis. In g.
+   * @param az The accelerometer z axis. In g.
+   * @param mx The magnetometer x axis, unused.
+   * @param my The magnetometer y axis, unused.
+   * @param mz The magnetometer z axis, unused.
+   */
+  /**************************************************************************/
+  void update(float gx, float gy, float gz, float ax, float ay, float az,
+              float mx, float my, float mz) {
+    (void)mx;
+    (void)my;
+    (void)mz;
+    updateIMU(gx, gy, gz, ax, ay, az);
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Updates the filter with new gyroscope and accelerometer data.
+   *
+   * @param gx The gyroscope x axis. In DPS.
+   * @param gy The gyroscope y axis. In DPS.
+   * @param gz The gyroscope z axis. In DPS.
+   * @param ax The accelerometer x axis. In g.
+   * @param ay The accelerometer y axis. In g.
+   * @param az The accelerometer z axis. In g.
+   */
+  /**************************************************************************/
+  void updateIMU(float gx, float gy, float gz, float ax, float ay, float az);
+
+  float getKp() const { return twoKp * 0.5f; }
+  void setKp(float Kp) { twoKp = 2.0f * Kp; }
+  float getKi() const { return twoKi * 0.5f; }
+  void setKi(float Ki) { twoKi = 2.0f * Ki; }
+
+  float getRoll() {
+    if (!anglesComputed) {
+      computeAngles();
+    }
+    return roll;
+  }
+  float getPitch() {
+    if (!anglesComputed) {
+      computeAngles();
+    }
+    return pitch;
+  }
+  float getYaw() {
+    if (!anglesComputed) {
+      computeAngles();
+    }
+    return yaw;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the tilt of the sensor z axis from vertical.
+   *
+   * @return The tilt angle, 0 to 180 deg.
+   */
+  /**************************************************************************/
+  float getTilt() {
+    if (!anglesComputed) {
+      computeAngles();
+    }
+    return tilt;
+  }
+
+  void getQuaternion(float *w, float *x, float *y, float *z) {
+    *w = q0;
+    *x = q1;
+    *y = q2;
+    *z = q3;
+  }
+
+  void setQuaternion(float w, float x, float y, float z) {
+    q0 = w;
+    q1 = x;
+    q2 = y;
+    q3 = z;
+    anglesComputed = false;
+    firstTiltLock = true;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the gravity vector from the orientation.
+   *
+   * @param x A float pointer to write the gravity vector x component to. In g.
+   * @param y A float pointer to write the gravity vector y component to. In g.
+   * @param z A float pointer to write the gravity vector z component to. In g.
+   */
+  /**************************************************************************/
+  void getGravityVector(float *x, float *y, float *z) {
+    *x = 2.0f * (q1 * q3 - q0 * q2);
+    *y = 2.0f * (q2 * q3 + q0 * q1);
+    *z = 2.0f * (q0 * q0 + q3 * q3) - 1.0f;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the linear acceleration (gravity removed) in the global frame
+   * from the last accelerometer reading. The z axis is vertical and positive
+   * down, so upward acceleration during boost reads negative z.
+   *
+   * @param x The pointer to write the linear acceleration x axis to. In g.
+   * @param y The pointer to write the linear acceleration y axis to. In g.
+   * @param z The pointer to write the linear acceleration z axis to. In g.
+   */
+  /**************************************************************************/
+  void getGlobalLinearAcceleration(float *x, float *y, float *z);
+
+private:
+  static float invSqrt(float x);
+  void computeAngles();
+
+  float twoKp;         // 2 * proportional gain (Kp)
+  float twoKi;         // 2 * integral gain (Ki)
+  float q0, q1, q2, q3; // orientation quaternion
+  float integralFBx, integralFBy, integralFBz; // integral error terms (rad/s)
+  float invSampleFreq; // sample interval (s)
+  float accel[3];      // accelerometer reading of the last update (g)
+  float roll, pitch, yaw, tilt; // NED angles (deg)
+  bool anglesComputed;
+  bool firstTiltLock; // orientation was seeded from the accelerometer tilt
+};
+
+#endif
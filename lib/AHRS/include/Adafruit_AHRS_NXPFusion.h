@@ -37,12 +37,68 @@
 #define __Adafruit_Nxp_Fusion_h_
 
 #include "Adafruit_AHRS_FusionInterface.h"
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#endif
+
+// number of stored elements of a symmetric 12x12 matrix kept as its packed
+// upper triangle
+#define SYM12_PACKED_SIZE 78
+// and of a symmetric 9x9 matrix in the 6DOF build
+#define SYM9_PACKED_SIZE 45
+
+// SRAM budget (bytes) of one filter object, checked by a static_assert in
+// Adafruit_AHRS_NXPFusion.cpp so a change that grows the state fails the
+// build. The 9DOF object is 1496 bytes on a 64-bit host, 4 less on the STM32
+// with its smaller vtable pointer, and the 6DOF one 928. AHRS_NXP_PROFILE
+// adds its timing tables on top. Override from the build_flags if a change
+// really needs more
+#ifndef AHRS_NXP_RAM_BUDGET
+#ifdef AHRS_NXP_6DOF
+#define AHRS_NXP_RAM_BUDGET 960
+#else
+#define AHRS_NXP_RAM_BUDGET 1536
+#endif
+#endif
+#define AHRS_NXP_PROFILE_RAM 192 // AHRS_NXP_PROFILE timing tables (176 bytes)
+
+// derived outputs that the getters compute on demand after an update
+#define NXP_DERIVED_RPL 0x01    // a posteriori orientation matrix RPl
+#define NXP_DERIVED_RVEC 0x02   // rotation vector RVecPl
+#define NXP_DERIVED_AGL 0x04    // global frame linear acceleration aGlPl
+#define NXP_DERIVED_ANGLES 0x08 // roll, pitch, yaw, compass and tilt
+#define NXP_DERIVED_ALL 0x0F
+
+// stages of the filter timed with AHRS_NXP_PROFILE
+#define NXP_STAGE_PREDICT 0    // gyro integration in predict(), predictBlock()
+#define NXP_STAGE_C 1          // variable elements of the measurement matrix C
+#define NXP_STAGE_GAIN 2       // Qw * C^T, C * Qw * C^T + Qv and K
+#define NXP_STAGE_INVERSE 3    // inverse of C * Qw * C^T + Qv
+#define NXP_STAGE_CORRECTION 4 // rest of update(): errors, xe+ and the state
+#define NXP_STAGE_COVARIANCE 5 // P+ and the Qw of the next gain
+#define NXP_STAGE_DERIVED 6    // derived outputs computed for the getters
+#define NXP_STAGE_COUNT 7
 
 /*!
  * @brief Kalman/NXP Fusion algorithm.
+ *
+ * AHRS_NXP_6DOF in the build flags compiles the gyroscope and accelerometer
+ * only variant of the filter for flights without a magnetometer: a 9 element
+ * error vector (orientation, gyro offset, linear acceleration) and the 3
+ * accelerometer measurement rows, so the gain needs a 3x3 instead of a 6x6
+ * inverse and the covariance matrices shrink from 12x12 to 9x9. update()
+ * ignores the magnetometer arguments, the orientation is seeded from the
+ * accelerometer tilt and yaw is the integrated gyro.
+ *
+ * AHRS_NXP_PROFILE in the build flags times each NXP_STAGE_* of the filter,
+ * in core cycles from the DWT cycle counter on the board and in ns from a
+ * steady clock on a host, see getStageProfile(). Without it the filter
+ * carries no timing code.
  */
-class Adafruit_NXPSensorFusion : public Adafruit_AHRS_FusionInterface {
+class Adafruit_NXPSensorFusion final : public Adafruit_AHRS_FusionInterface {
 public:
   /**************************************************************************/
   /*!
@@ -51,7 +107,52 @@ public:
    * @param sampleFrequency The sensor sample rate in herz(samples per second).
    */
   /**************************************************************************/
-  void begin(float sampleFrequency = 100.0f);
+  void begin(float sampleFrequency = 100.0f) { begin(sampleFrequency, 1); }
+
+  /**************************************************************************/
+  /*!
+   * @brief Initializes the 9DOF Kalman filter for multi-rate operation. The
+   * gyroscope is integrated at the sensor rate and the Kalman measurement
+   * update runs once every oversampleRatio gyroscope readings: call predict()
+   * for oversampleRatio - 1 readings, then update() with the next one.
+   *
+   * @param sampleFrequency The gyroscope sample rate in herz(samples per
+   * second).
+   * @param oversampleRatio Gyroscope readings per Kalman update.
+   */
+  /**************************************************************************/
+  void begin(float sampleFrequency, uint8_t oversampleRatio);
+
+  /**************************************************************************/
+  /*!
+   * @brief Integrates a gyroscope reading between Kalman updates. Only rotates
+   * the a priori orientation, so it is cheap enough to run at the sensor rate.
+   * The next update() applies the measurement correction.
+   *
+   * @param gx The gyroscope x axis. In DPS.
+   * @param gy The gyroscope y axis. In DPS.
+   * @param gz The gyroscope z axis. In DPS.
+   */
+  /**************************************************************************/
+  void predict(float gx, float gy, float gz);
+
+  /**************************************************************************/
+  /*!
+   * @brief Integrates a block of gyroscope readings (a FIFO read) between
+   * Kalman updates. Consecutive readings are paired with a two-sample coning
+   * correction, phi = a1 + a2 + 2/3 a1 x a2, the pairs are combined into one
+   * rotation vector and the a priori orientation is rotated once. This is
+   * more accurate than predict() on each reading when the rocket spins and
+   * needs one quaternion rotation per block instead of one per reading.
+   *
+   * @param gx The gyroscope x axis readings. In DPS.
+   * @param gy The gyroscope y axis readings. In DPS.
+   * @param gz The gyroscope z axis readings. In DPS.
+   * @param n The number of readings.
+   */
+  /**************************************************************************/
+  void predictBlock(const float gx[], const float gy[], const float gz[],
+                    uint8_t n);
 
   /**************************************************************************/
   /*!
@@ -79,11 +180,133 @@ public:
   void update(float gx, float gy, float gz, float ax, float ay, float az,
               float mx, float my, float mz);
 
+  /**************************************************************************/
+  /*!
+   * @brief Updates the filter with a block of samples at the gyroscope rate.
+   * All but the last gyroscope reading go through the coning-corrected
+   * predictBlock(), then one Kalman update runs on the last sample, so the
+   * accelerometer and magnetometer readings before it are not used. Set the
+   * oversample ratio in begin() to the usual block size so the Kalman
+   * interval matches.
+   *
+   * @param block The samples, oldest first.
+   */
+  /**************************************************************************/
+  void updateBatch(const Adafruit_AHRS_SampleBlock &block);
+
+  /**************************************************************************/
+  /*!
+   * @brief Seeds the gyro offset estimate b+, e.g. with the bias measured
+   * while the rocket sat still on the pad, and sets its variance in the
+   * covariance matrix Qw so the filter trusts the seed instead of spending
+   * the first seconds of flight converging on it.
+   *
+   * @param bx The gyroscope x axis offset. In DPS.
+   * @param by The gyroscope y axis offset. In DPS.
+   * @param bz The gyroscope z axis offset. In DPS.
+   * @param variance The variance of the offset estimate. In DPS^2.
+   */
+  /**************************************************************************/
+  void setGyroOffset(float bx, float by, float bz, float variance);
+
+  /**************************************************************************/
+  /*!
+   * @brief Sets the magnetometer calibration state. Until a calibration is
+   * set valid the filter ignores the magnetometer and only locks tilt; after
+   * it, the readings passed to update() must be calibrated.
+   *
+   * @param valid True once the readings are calibrated.
+   * @param B The geomagnetic field strength of the calibration, which scales
+   * the geomagnetic vector and the magnetic jamming threshold 4 * B^2. In uT.
+   */
+  /**************************************************************************/
+  void setMagCalibration(bool valid, float B);
+
+  /**************************************************************************/
+  /*!
+   * @brief Enables steady-state gain mode. Once the filter has run for the
+   * settle time the Kalman gain and the covariance matrices are only
+   * recomputed every refreshInterval updates; in between update() applies the
+   * last gain to the new measurement errors. The stale gain was computed for
+   * an older orientation so keep the interval short while the attitude moves
+   * quickly.
+   *
+   * @param settleTime_s Filter time (s) to run with the full update first.
+   * @param refreshInterval Updates per gain refresh. 0 or 1 refreshes on
+   * every update, which is the default.
+   */
+  /**************************************************************************/
+  void setGainRefresh(float settleTime_s, uint16_t refreshInterval) {
+    gainSettleTime_s = settleTime_s;
+    gainRefreshInterval = refreshInterval;
+    gainRefreshCount = 0;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the number of updates per Kalman gain refresh.
+   *
+   * @return The refresh interval set by setGainRefresh.
+   */
+  /**************************************************************************/
+  uint16_t getGainRefreshInterval() const { return gainRefreshInterval; }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the time the last Kalman gain refresh took, from micros() on
+   * the board and a steady clock on a host.
+   *
+   * @return The duration of the last gain refresh in us.
+   */
+  /**************************************************************************/
+  uint32_t getGainRefreshMicros() const { return gainRefreshMicros; }
+
+#ifdef AHRS_NXP_PROFILE
+  /**************************************************************************/
+  /*!
+   * @brief Get the timing of a stage of the filter since begin() or the last
+   * resetProfile(). A sample is the time a stage took over one filter cycle,
+   * from one update() to the next: the update, the derived outputs the
+   * getters computed after it and the gyroscope readings integrated before
+   * the next one. Cycles a stage did not run in, e.g. the gain stages between
+   * steady-state gain refreshes, are not counted. Ticks are core cycles on
+   * the board and ns on a host.
+   *
+   * @param stage One of NXP_STAGE_*.
+   * @param min The pointer to write the shortest sample to. In ticks.
+   * @param mean The pointer to write the mean sample to. In ticks.
+   * @param max The pointer to write the longest sample to. In ticks.
+   * @return The number of samples, 0 if the stage has not run (min, mean and
+   * max are then 0).
+   */
+  /**************************************************************************/
+  uint32_t getStageProfile(uint8_t stage, uint32_t *min, uint32_t *mean,
+                           uint32_t *max) const;
+
+  /**************************************************************************/
+  /*!
+   * @brief Clears the stage timings, e.g. to measure each logging interval
+   * on its own. The cycle in progress is kept and counted in the next
+   * interval, so back to back intervals together count every cycle once.
+   */
+  /**************************************************************************/
+  void resetProfile();
+#endif
+
   //float rvec[3];  //fix for making a public rvec array
 
-  float getRoll() { return PhiPl; }
-  float getPitch() { return ThePl; }
-  float getYaw() { return PsiPl; }
+  float getRoll() {
+    computeDerived(NXP_DERIVED_ANGLES);
+    return PhiPl;
+  }
+  float getPitch() {
+    computeDerived(NXP_DERIVED_ANGLES);
+    return ThePl;
+  }
+  float getYaw() {
+    computeDerived(NXP_DERIVED_ANGLES);
+    return PsiPl;
+  }
 
   void getQuaternion(float *w, float *x, float *y, float *z) {
     *w = qPl.q0;
@@ -92,11 +315,27 @@ public:
     *z = qPl.q3;
   }
 
+  /**************************************************************************/
+  /*!
+   * @brief Get the orientation including the gyroscope readings integrated by
+   * predict() since the last update. Equals getQuaternion() right after
+   * update().
+   */
+  /**************************************************************************/
+  void getPredictedQuaternion(float *w, float *x, float *y, float *z) {
+    const Quaternion_t *pq = PredictCount ? &qMi : &qPl;
+    *w = pq->q0;
+    *x = pq->q1;
+    *y = pq->q2;
+    *z = pq->q3;
+  }
+
   void setQuaternion(float w, float x, float y, float z) {
     qPl.q0 = w;
     qPl.q1 = x;
     qPl.q2 = y;
     qPl.q3 = z;
+    derivedDirty = NXP_DERIVED_ALL;
   }
   /**************************************************************************/
   /*!
@@ -144,6 +383,100 @@ public:
     *z = mGl[2];
   }
 
+  /**************************************************************************/
+  /*!
+   * @brief Get the linear acceleration (gravity removed) in the global frame.
+   * The z axis is vertical and positive down, so upward acceleration during
+   * boost reads negative z.
+   *
+   * @param x The pointer to write the linear acceleration x axis to. In g.
+   * @param y The pointer to write the linear acceleration y axis to. In g.
+   * @param z The pointer to write the linear acceleration z axis to. In g.
+   */
+  /**************************************************************************/
+  void getGlobalLinearAcceleration(float *x, float *y, float *z) {
+    computeDerived(NXP_DERIVED_AGL);
+    *x = aGlPl[0];
+    *y = aGlPl[1];
+    *z = aGlPl[2];
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the tilt of the sensor z axis from vertical.
+   *
+   * @return The tilt angle, 0 to 180 deg.
+   */
+  /**************************************************************************/
+  float getTilt() {
+    computeDerived(NXP_DERIVED_ANGLES);
+    return ChiPl;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get an element of the a posteriori error covariance matrix P+.
+   *
+   * @param i The row, 0 to 11 (0 to 8 in the 6DOF build).
+   * @param j The column, 0 to 11 (0 to 8 in the 6DOF build).
+   * @return P+[i][j], which equals P+[j][i].
+   */
+  /**************************************************************************/
+  float getPPlus(uint8_t i, uint8_t j) const {
+#ifdef AHRS_NXP_6DOF
+    return PPlusUT9x9[symIndex9(i, j)];
+#else
+    return PPlusUT12x12[symIndex12(i, j)];
+#endif
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get an element of the a priori error covariance matrix Qw.
+   *
+   * @param i The row, 0 to 11 (0 to 8 in the 6DOF build).
+   * @param j The column, 0 to 11 (0 to 8 in the 6DOF build).
+   * @return Qw[i][j], which equals Qw[j][i].
+   */
+  /**************************************************************************/
+  float getQw(uint8_t i, uint8_t j) const {
+#ifdef AHRS_NXP_6DOF
+    return QwUT9x9[symIndex9(i, j)];
+#else
+    return QwUT12x12[symIndex12(i, j)];
+#endif
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Index of element [i][j] of a symmetric 12x12 matrix stored as its
+   * upper triangle packed row by row.
+   */
+  /**************************************************************************/
+  static uint8_t symIndex12(uint8_t i, uint8_t j) {
+    if (i > j) {
+      uint8_t t = i;
+      i = j;
+      j = t;
+    }
+    return i * 12 - ((i * (i + 1)) >> 1) + j;
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Index of element [i][j] of a symmetric 9x9 matrix stored as its
+   * upper triangle packed row by row.
+   */
+  /**************************************************************************/
+  static uint8_t symIndex9(uint8_t i, uint8_t j) {
+    if (i > j) {
+      uint8_t t = i;
+      i = j;
+      j = t;
+    }
+    return i * 9 - ((i * (i + 1)) >> 1) + j;
+  }
+
   typedef struct {
     float q0; // w
     float q1; // x
@@ -160,6 +493,7 @@ public:
 
   void getRotationVector(float *x, float *y, float *z)
     {
+        computeDerived(NXP_DERIVED_RVEC);
         *x = RVecPl[0];
         *y = RVecPl[1];
         *z = RVecPl[2];
@@ -170,22 +504,13 @@ public:
         RVecPl[0] = x;
         RVecPl[1] = y;
         RVecPl[2] = z;
+        derivedDirty &= ~NXP_DERIVED_RVEC;
     }
 
-  float RVecPl[3];  // rotation vector //used to be private is now public
-
-  float PhiPl; // roll (deg)
-  float ThePl; // pitch (deg)
-  float PsiPl; // yaw (deg)
-  float RhoPl; // compass (deg)
-  float ChiPl; // tilt from vertical (deg)
-  // orientation matrix, quaternion and rotation vector
-  float RPl[3][3];  // a posteriori orientation matrix
+  // orientation quaternion
   Quaternion_t qPl; // a posteriori orientation quaternion
   // angular velocity
   float Omega[3]; // angular velocity (deg/s)
-  // systick timer for benchmarking
-  int32_t systick; // systick timer;
   // end: elements common to all motion state vectors
 
   // elements transmitted over bluetooth in kalman packet
@@ -194,32 +519,49 @@ public:
   float bErrPl[3];  // gyro offset error (deg/s)
   // end elements transmitted in kalman packet
 
+#ifndef AHRS_NXP_6DOF
   float dErrGlPl[3]; // magnetic disturbance error (uT, global frame)
   float dErrSePl[3]; // magnetic disturbance error (uT, sensor frame)
+#endif
   float aErrSePl[3]; // linear acceleration error (g, sensor frame)
   float aSeMi[3];    // linear acceleration (g, sensor frame)
   float DeltaPl;     // inclination angle (deg)
   float aSePl[3];    // linear acceleration (g, sensor frame)
-  float aGlPl[3];    // linear acceleration (g, global frame)
+  float aSeLast[3];  // accelerometer reading of the last update (g)
   float gErrSeMi[3]; // difference (g, sensor frame) of gravity vector (accel)
                      // and gravity vector (gyro)
+  float gSeGyMi[3];  // gravity vector (g, sensor frame) measurement from gyro
+  float mGl[3];      // geomagnetic vector (uT, global frame)
+  float MagB;        // geomagnetic field strength of the calibration (uT)
+  float MagFourBsq;  // magnetic jamming threshold 4 * B^2 (uT^2)
+  int8_t MagCalValid; // magnetometer readings are calibrated
+  float QvAA;        // accelerometer terms of Qv
+#ifdef AHRS_NXP_6DOF
+  float PPlusUT9x9[SYM9_PACKED_SIZE]; // covariance matrix P+ (packed)
+  float K9x3[9][3];                   // kalman filter gain matrix K
+  float QwUT9x9[SYM9_PACKED_SIZE];    // covariance matrix Qw (packed)
+  float C3x6[3][6]; // variable columns 0-5 of the 3x9 measurement matrix C
+#else
   float mErrSeMi[3]; // difference (uT, sensor frame) of geomagnetic vector
                      // (magnetometer) and geomagnetic vector (gyro)
-  float gSeGyMi[3];  // gravity vector (g, sensor frame) measurement from gyro
   float
       mSeGyMi[3]; // geomagnetic vector (uT, sensor frame) measurement from gyro
-  float mGl[3];   // geomagnetic vector (uT, global frame)
-  float QvAA;     // accelerometer terms of Qv
   float QvMM;     // magnetometer terms of Qv
-  float PPlus12x12[12][12]; // covariance matrix P+
-  float K12x6[12][6];       // kalman filter gain matrix K
-  float Qw12x12[12][12];    // covariance matrix Qw
-  float C6x12[6][12];       // measurement matrix C
+  float PPlusUT12x12[SYM12_PACKED_SIZE]; // covariance matrix P+ (packed)
+  float K12x6[12][6];                    // kalman filter gain matrix K
+  float QwUT12x12[SYM12_PACKED_SIZE];    // covariance matrix Qw (packed)
+  float C6x6[6][6]; // variable columns 0-5 of the 6x12 measurement matrix C
+#endif
   float RMi[3][3];          // a priori orientation matrix
   Quaternion_t Deltaq;      // delta quaternion
   Quaternion_t qMi;         // a priori orientation quaternion
   float casq;               // FCA * FCA;
+#ifndef AHRS_NXP_6DOF
   float cdsq;               // FCD * FCD;
+#endif
+  float OmegaSum[3];        // sum of the gyro readings since the last update
+  uint16_t PredictCount;    // gyro readings in OmegaSum (saturates)
+  uint8_t OversampleRatio;  // gyro readings per kalman update
   float Fastdeltat;         // sensor sampling interval (s) = 1 / SENSORFS
   float deltat;     // kalman filter sampling interval (s) = OVERSAMPLE_RATIO /
                     // SENSORFS
@@ -227,7 +569,52 @@ public:
   float QwbplusQvG; // FQWB + FQVG
   int8_t
       FirstOrientationLock; // denotes that 9DOF orientation has locked to 6DOF
+  int8_t FirstTiltLock;     // denotes that orientation was seeded from accel tilt
   int8_t resetflag;         // flag to request re-initialization on next pass
+  // steady-state gain mode
+  float gainSettleTime_s = 0.0f;    // filter time before the gain may freeze
+  uint16_t gainRefreshInterval = 1; // updates per gain refresh (0, 1: each)
+  uint16_t gainRefreshCount;        // updates since the last gain refresh
+  uint32_t updateCount;             // updates since begin (saturates)
+  uint32_t gainRefreshMicros;       // duration of the last gain refresh (us)
+
+private:
+  void refreshGain();
+
+  // derived outputs, only current after the matching getter ran, see
+  // derivedDirty
+  float RVecPl[3];  // rotation vector
+  float PhiPl;      // roll (deg)
+  float ThePl;      // pitch (deg)
+  float PsiPl;      // yaw (deg)
+  float RhoPl;      // compass (deg)
+  float ChiPl;      // tilt from vertical (deg)
+  float RPl[3][3];  // a posteriori orientation matrix
+  float aGlPl[3];   // linear acceleration (g, global frame)
+  uint8_t derivedDirty; // NXP_DERIVED_* outputs stale since the last update
+
+#ifdef AHRS_NXP_PROFILE
+  // timings of each NXP_STAGE_* (ticks)
+  uint32_t stageMin[NXP_STAGE_COUNT];
+  uint32_t stageMax[NXP_STAGE_COUNT];
+  uint64_t stageSum[NXP_STAGE_COUNT];
+  uint32_t stageCount[NXP_STAGE_COUNT];
+  uint32_t stagePending[NXP_STAGE_COUNT]; // ticks of the current cycle so far
+  uint8_t stagePendingMask;               // stages run in the current cycle
+
+  // adds the ticks since start to stage and returns the current tick
+  uint32_t profileLap(uint8_t stage, uint32_t start);
+  // folds the current cycle into the stage timings
+  void closeProfileCycle();
+#endif
+
+  // computes the derived outputs in mask that are stale
+  void computeDerived(uint8_t mask) {
+    if (derivedDirty & mask) {
+      refreshDerived(derivedDirty & mask);
+    }
+  }
+  void refreshDerived(uint8_t mask);
 };
 
 #endif
@@ -0,0 +1,277 @@
+/*!
+ * @file Adafruit_AHRS_NXPFusionQ.h
+ *
+ * @section license License
+ *
+ * Fixed-point build of the NXP 9DOF Kalman filter in
+ * Adafruit_AHRS_NXPFusion.h, derived from
+ * https://github.com/memsindustrygroup/Open-Source-Sensor-Fusion/blob/master/Sources/tasks.h
+ *
+ * Copyright (c) 2014, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Freescale Semiconductor, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL FREESCALE SEMICONDUCTOR, INC. BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __Adafruit_Nxp_Fusion_Q_h_
+#define __Adafruit_Nxp_Fusion_Q_h_
+
+#include "Adafruit_AHRS_FusionInterface.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+// number of fractional bits of the fixed-point quantities
+#define NXPQ_UNIT_FRAC 30  // quaternions, rotation matrices, gravity (+-2)
+#define NXPQ_GYRO_FRAC 20  // angular velocity and gyro offset in deg/s (+-2048)
+#define NXPQ_ACCEL_FRAC 26 // acceleration in g (+-32)
+#define NXPQ_MAG_FRAC 22   // magnetic field in uT (+-512)
+#define NXPQ_ANGLE_FRAC 16 // angles in deg (+-32768)
+
+/*!
+ * @brief Kalman/NXP Fusion algorithm in fixed point.
+ *
+ * Same filter as Adafruit_NXPSensorFusion for targets without an FPU. The
+ * orientation, gyro offset, measurement predictions, error corrections and
+ * angle outputs are held in two's complement Q-format (see the NXPQ_*_FRAC
+ * fractional bit counts) so the per-sample work is integer multiplies.
+ *
+ * The error covariance only ever holds 15 independent terms (the diagonal
+ * and the orientation/gyro offset cross terms) and the Kalman gain reduces to
+ * products with a 3x3 inverse. Those few terms stay in float: the variances
+ * span too many decades for a single Q-format.
+ *
+ * Not a flight option. The gain and covariance path is still soft float on
+ * the STM32 and the whole update is no faster than the float filter on the
+ * host, so it is kept as a reference for tools/ahrs_fixed_compare.cpp only.
+ */
+class Adafruit_NXPSensorFusionQ final : public Adafruit_AHRS_FusionInterface {
+public:
+  /**************************************************************************/
+  /*!
+   * @brief Initializes the 9DOF Kalman filter.
+   *
+   * @param sampleFrequency The sensor sample rate in herz(samples per second).
+   */
+  /**************************************************************************/
+  void begin(float sampleFrequency = 100.0f);
+
+  /**************************************************************************/
+  /*!
+   * @brief Updates the filter with new gyroscope, accelerometer, and
+   * magnetometer data. The readings are converted to fixed point on entry and
+   * saturate outside the ranges of their Q-formats.
+   *
+   * @param gx The gyroscope x axis. In DPS.
+   * @param gy The gyroscope y axis. In DPS.
+   * @param gz The gyroscope z axis. In DPS.
+   * @param ax The accelerometer x axis. In g.
+   * @param ay The accelerometer y axis. In g.
+   * @param az The accelerometer z axis. In g.
+   * @param mx The magnetometer x axis. In uT.
+   * @param my The magnetometer y axis. In uT.
+   * @param mz The magnetometer z axis. In uT.
+   */
+  /**************************************************************************/
+  void update(float gx, float gy, float gz, float ax, float ay, float az,
+              float mx, float my, float mz);
+
+  /**************************************************************************/
+  /*!
+   * @brief Seeds the gyro offset estimate b+, e.g. with the bias measured
+   * while the rocket sat still on the pad, and sets its variance in the
+   * covariance matrix Qw so the filter trusts the seed instead of spending
+   * the first seconds of flight converging on it.
+   *
+   * @param bx The gyroscope x axis offset. In DPS.
+   * @param by The gyroscope y axis offset. In DPS.
+   * @param bz The gyroscope z axis offset. In DPS.
+   * @param variance The variance of the offset estimate. In DPS^2.
+   */
+  /**************************************************************************/
+  void setGyroOffset(float bx, float by, float bz, float variance);
+
+  /**************************************************************************/
+  /*!
+   * @brief Sets the magnetometer calibration state. Until a calibration is
+   * set valid the filter ignores the magnetometer and only locks tilt; after
+   * it, the readings passed to update() must be calibrated.
+   *
+   * @param valid True once the readings are calibrated.
+   * @param B The geomagnetic field strength of the calibration, which scales
+   * the geomagnetic vector and the magnetic jamming threshold 4 * B^2. In uT.
+   */
+  /**************************************************************************/
+  void setMagCalibration(bool valid, float B);
+
+  float getRoll() { return (float)PhiPl * (1.0f / (1L << NXPQ_ANGLE_FRAC)); }
+  float getPitch() { return (float)ThePl * (1.0f / (1L << NXPQ_ANGLE_FRAC)); }
+  float getYaw() { return (float)PsiPl * (1.0f / (1L << NXPQ_ANGLE_FRAC)); }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the tilt of the sensor z axis from vertical.
+   *
+   * @return The tilt angle, 0 to 180 deg.
+   */
+  /**************************************************************************/
+  float getTilt() { return (float)ChiPl * (1.0f / (1L << NXPQ_ANGLE_FRAC)); }
+
+  void getQuaternion(float *w, float *x, float *y, float *z) {
+    *w = (float)qPl.q0 * (1.0f / (1L << NXPQ_UNIT_FRAC));
+    *x = (float)qPl.q1 * (1.0f / (1L << NXPQ_UNIT_FRAC));
+    *y = (float)qPl.q2 * (1.0f / (1L << NXPQ_UNIT_FRAC));
+    *z = (float)qPl.q3 * (1.0f / (1L << NXPQ_UNIT_FRAC));
+  }
+
+  void setQuaternion(float w, float x, float y, float z) {
+    qPl.q0 = (int32_t)(w * (1L << NXPQ_UNIT_FRAC));
+    qPl.q1 = (int32_t)(x * (1L << NXPQ_UNIT_FRAC));
+    qPl.q2 = (int32_t)(y * (1L << NXPQ_UNIT_FRAC));
+    qPl.q3 = (int32_t)(z * (1L << NXPQ_UNIT_FRAC));
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the linear acceleration part of the acceleration value given to
+   * update.
+   *
+   * @param x The pointer to write the linear acceleration x axis to. In g.
+   * @param y The pointer to write the linear acceleration y axis to. In g.
+   * @param z The pointer to write the linear acceleration z axis to. In g.
+   */
+  /**************************************************************************/
+  void getLinearAcceleration(float *x, float *y, float *z) const {
+    *x = (float)aSePl[0] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+    *y = (float)aSePl[1] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+    *z = (float)aSePl[2] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the linear acceleration (gravity removed) in the global frame.
+   * The z axis is vertical and positive down, so upward acceleration during
+   * boost reads negative z.
+   *
+   * @param x The pointer to write the linear acceleration x axis to. In g.
+   * @param y The pointer to write the linear acceleration y axis to. In g.
+   * @param z The pointer to write the linear acceleration z axis to. In g.
+   */
+  /**************************************************************************/
+  void getGlobalLinearAcceleration(float *x, float *y, float *z) const {
+    *x = (float)aGlPl[0] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+    *y = (float)aGlPl[1] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+    *z = (float)aGlPl[2] * (1.0f / (1L << NXPQ_ACCEL_FRAC));
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the gravity vector from the gyroscope values.
+   *
+   * @param x A float pointer to write the gravity vector x component to. In g.
+   * @param y A float pointer to write the gravity vector y component to. In g.
+   * @param z A float pointer to write the gravity vector z component to. In g.
+   */
+  /**************************************************************************/
+  void getGravityVector(float *x, float *y, float *z) {
+    *x = (float)gSeGyMi[0] * (1.0f / (1L << NXPQ_UNIT_FRAC));
+    *y = (float)gSeGyMi[1] * (1.0f / (1L << NXPQ_UNIT_FRAC));
+    *z = (float)gSeGyMi[2] * (1.0f / (1L << NXPQ_UNIT_FRAC));
+  }
+
+  /**************************************************************************/
+  /*!
+   * @brief Get the geomagnetic vector in global frame.
+   *
+   * @param x The pointer to write the geomagnetic vector x axis to. In uT.
+   * @param y The pointer to write the geomagnetic vector y axis to. In uT.
+   * @param z The pointer to write the geomagnetic vector z axis to. In uT.
+   */
+  /**************************************************************************/
+  void getGeomagneticVector(float *x, float *y, float *z) const {
+    *x = (float)mGl[0] * (1.0f / (1L << NXPQ_MAG_FRAC));
+    *y = (float)mGl[1] * (1.0f / (1L << NXPQ_MAG_FRAC));
+    *z = (float)mGl[2] * (1.0f / (1L << NXPQ_MAG_FRAC));
+  }
+
+  typedef struct {
+    int32_t q0; // w
+    int32_t q1; // x
+    int32_t q2; // y
+    int32_t q3; // z
+  } Quaternion_t;
+
+  int32_t PhiPl; // roll (deg, Q16)
+  int32_t ThePl; // pitch (deg, Q16)
+  int32_t PsiPl; // yaw (deg, Q16)
+  int32_t RhoPl; // compass (deg, Q16)
+  int32_t ChiPl; // tilt from vertical (deg, Q16)
+  // orientation matrix and quaternion
+  int32_t RPl[3][3]; // a posteriori orientation matrix (Q30)
+  Quaternion_t qPl;  // a posteriori orientation quaternion (Q30)
+  // angular velocity
+  int32_t Omega[3]; // angular velocity (deg/s, Q20)
+
+  int32_t bPl[3];     // gyro offset (deg/s, Q20)
+  int32_t aSeMi[3];   // linear acceleration (g, sensor frame, Q26)
+  int32_t DeltaPl;    // inclination angle (deg, Q16)
+  int32_t aSePl[3];   // linear acceleration (g, sensor frame, Q26)
+  int32_t aGlPl[3];   // linear acceleration (g, global frame, Q26)
+  int32_t gErrSeMi[3]; // difference (g, sensor frame, Q26) of gravity vector
+                       // (accel) and gravity vector (gyro)
+  int32_t mErrSeMi[3]; // difference (uT, sensor frame, Q22) of geomagnetic
+                       // vector (magnetometer) and geomagnetic vector (gyro)
+  int32_t gSeGyMi[3];  // gravity vector (g, sensor frame, Q30) from gyro
+  int32_t mSeGyMi[3];  // geomagnetic vector (uT, sensor frame, Q22) from gyro
+  int32_t mGl[3];      // geomagnetic vector (uT, global frame, Q22)
+  float MagB;          // geomagnetic field strength of the calibration (uT)
+  float MagFourBsq;    // magnetic jamming threshold 4 * B^2 (uT^2)
+  int8_t MagCalValid;  // magnetometer readings are calibrated
+  int32_t RMi[3][3];   // a priori orientation matrix (Q30)
+  Quaternion_t Deltaq; // delta quaternion (Q30)
+  Quaternion_t qMi;    // a priori orientation quaternion (Q30)
+  int32_t FastdtRad;   // Fastdeltat * pi / 180 (Q36)
+  int32_t ca;          // linear acceleration decay factor (Q30)
+
+  // non-zero terms of the covariance matrix Qw, one per axis
+  float QwThTh[3]; // th_e * th_e terms
+  float QwThB[3];  // th_e * b_e terms
+  float QwBB[3];   // b_e * b_e terms
+  float QwAA[3];   // a_e * a_e terms
+  float QwDD[3];   // d_e * d_e terms
+  float QvAA;      // accelerometer terms of Qv
+  float QvMM;      // magnetometer terms of Qv
+  float casq;      // FCA * FCA;
+  float cdsq;      // FCD * FCD;
+  float deltat;    // kalman filter sampling interval (s)
+  float deltatsq;  // fdeltat * fdeltat
+  float QwbplusQvG; // FQWB + FQVG
+  int8_t
+      FirstOrientationLock; // denotes that 9DOF orientation has locked to 6DOF
+  int8_t FirstTiltLock;     // denotes that orientation was seeded from accel tilt
+  int8_t resetflag;         // flag to request re-initialization on next pass
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*!
+ * @file Adafruit_AHRS_Static.h
+ *
+ * Compile time selection of a fusion filter for firmware.
+ */
+
+#ifndef ADAFRUIT_AHRS_STATIC_H_
+#define ADAFRUIT_AHRS_STATIC_H_
+
+#include "Adafruit_AHRS_FusionInterface.h"
+
+/*!
+ * @brief Fusion filter front end with the filter picked at compile time.
+ *
+ * Holds a Filter by value and forwards the Adafruit_AHRS_FusionInterface
+ * calls to it with qualified, non-virtual calls, so the getters defined in
+ * the filter's header inline into the caller and no call goes through the
+ * vtable. Host tools that switch filters at run time keep using
+ * Adafruit_AHRS_FusionInterface pointers.
+ *
+ * The forwards beyond the interface (linear acceleration, tilt, geomagnetic
+ * vector) are only compiled when called, so a filter without them still
+ * works as long as the firmware does not use them. Anything else specific to
+ * one filter is reached through filter().
+ *
+ * The size and cycle effect on the STM32 is unmeasured. The firmware already
+ * called a concrete global filter before, so those calls were direct too;
+ * compare the fusion symbols in firmware.map (platformio.ini writes it) and a
+ * board run with AHRS_NXP_PROFILE before counting on a gain.
+ *
+ * @tparam Filter A class implementing Adafruit_AHRS_FusionInterface, best
+ * declared final.
+ */
+template <class Filter> class Adafruit_AHRS_Static {
+public:
+  Adafruit_AHRS_Static() {
+    // fails to compile unless Filter implements the interface
+    const Adafruit_AHRS_FusionInterface *check = &fusion;
+    (void)check;
+  }
+
+  /*!
+   * @brief The filter itself, for calls that are not forwarded.
+   *
+   * @return The filter.
+   */
+  Filter &filter() { return fusion; }
+
+  void begin(float sampleFrequency) { fusion.Filter::begin(sampleFrequency); }
+
+  void update(float gx, float gy, float gz, float ax, float ay, float az,
+              float mx, float my, float mz) {
+    fusion.Filter::update(gx, gy, gz, ax, ay, az, mx, my, mz);
+  }
+
+  void updateBatch(const Adafruit_AHRS_SampleBlock &block) {
+    fusion.Filter::updateBatch(block);
+  }
+
+  float getRoll() { return fusion.Filter::getRoll(); }
+  float getPitch() { return fusion.Filter::getPitch(); }
+  float getYaw() { return fusion.Filter::getYaw(); }
+  float getTilt() { return fusion.Filter::getTilt(); }
+
+  void getQuaternion(float *w, float *x, float *y, float *z) {
+    fusion.Filter::getQuaternion(w, x, y, z);
+  }
+
+  void setQuaternion(float w, float x, float y, float z) {
+    fusion.Filter::setQuaternion(w, x, y, z);
+  }
+
+  void getGravityVector(float *x, float *y, float *z) {
+    fusion.Filter::getGravityVector(x, y, z);
+  }
+
+  void getLinearAcceleration(float *x, float *y, float *z) {
+    fusion.Filter::getLinearAcceleration(x, y, z);
+  }
+
+  void getGlobalLinearAcceleration(float *x, float *y, float *z) {
+    fusion.Filter::getGlobalLinearAcceleration(x, y, z);
+  }
+
+  void getGeomagneticVector(float *x, float *y, float *z) {
+    fusion.Filter::getGeomagneticVector(x, y, z);
+  }
+
+private:
+  Filter fusion;
+};
+
+#endif /* ADAFRUIT_AHRS_STATIC_H_ */
@@ -0,0 +1,506 @@
+/*!
+ * @file Adafruit_AHRS_MagCalibration.cpp
+ *
+ * Incremental magnetometer calibration, see Adafruit_AHRS_MagCalibration.h.
+ */
+
+#include "Adafruit_AHRS_MagCalibration.h"
+#include <math.h>
+
+#define X 0 // vector components
+#define Y 1
+#define Z 2
+
+// slices of a running fit, see solveStep()
+#define MAGCAL_STEP_IDLE 0   // no fit running
+#define MAGCAL_STEP_START 1  // snapshot the sums, 4 element fit
+#define MAGCAL_STEP_ROTATE 2 // one Jacobi rotation of the 10 element fit
+#define MAGCAL_STEP_FINISH 3 // ellipsoid from the eigenvectors, accept
+
+extern "C" {
+void f3x3matrixAeqI(float A[][3]);
+void f3x3matrixAeqInvSymB(float A[][3], float B[][3]);
+float f3x3matrixDetA(float A[][3]);
+void eigencompute(float A[][10], float eigval[], float eigvec[][10], int8_t n);
+void eigeninit(float A[][10], float eigval[], float eigvec[][10], int8_t n);
+float eigenresidue(float A[][10], int8_t n);
+void eigenrotate(float A[][10], float eigval[], float eigvec[][10], int8_t n,
+                 int8_t ir, int8_t ic);
+void fmatrixAeqInvA(float *A[], int8_t iColInd[], int8_t iRowInd[],
+                    int8_t iPivot[], int8_t isize);
+}
+
+// index of element [i][j] of the symmetric 10x10 normal matrix stored as its
+// upper triangle packed row by row
+static inline uint8_t sym10(uint8_t i, uint8_t j) {
+  if (i > j) {
+    uint8_t t = i;
+    i = j;
+    j = t;
+  }
+  return i * 10 - ((i * (i + 1)) >> 1) + j;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Clears the sums and the calibration.
+ */
+/**************************************************************************/
+void Adafruit_AHRS_MagCalibration::begin() {
+  int8_t i;
+
+  for (i = 0; i < MAGCAL_SUMS; i++) {
+    Sums[i] = 0.0F;
+  }
+  for (i = X; i <= Z; i++) {
+    Ref[i] = Last[i] = V[i] = 0.0F;
+  }
+  f3x3matrixAeqI(invW);
+  B = 0.0F;
+  FourBsq = 0.0F;
+  FitErrorpc = 0.0F;
+  ValidMagCal = 0;
+  HaveRef = 0;
+  Solver = 0;
+  Step = MAGCAL_STEP_IDLE;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Adds a magnetometer reading to the sums of the fit.
+ */
+/**************************************************************************/
+void Adafruit_AHRS_MagCalibration::addSample(float mx, float my, float mz) {
+  float fm[3] = {mx, my, mz};
+  float fd[10]; // row of the 10 element fit for this reading
+  float ftmp;   // scratch
+  int8_t i, j, k;
+
+  if (!HaveRef) {
+    // sum the readings relative to the first one so the sums of fourth
+    // powers stay small
+    for (i = X; i <= Z; i++) {
+      Ref[i] = Last[i] = fm[i];
+    }
+    HaveRef = 1;
+  } else {
+    ftmp = 0.0F;
+    for (i = X; i <= Z; i++) {
+      ftmp += (fm[i] - Last[i]) * (fm[i] - Last[i]);
+    }
+    if (ftmp < MAGCAL_MIN_STEP_UT * MAGCAL_MIN_STEP_UT) {
+      return;
+    }
+    for (i = X; i <= Z; i++) {
+      Last[i] = fm[i];
+    }
+  }
+
+  // scaled reading u and the row (ux^2, uxuy, uxuz, uy^2, uyuz, uz^2, ux, uy,
+  // uz, 1) of the ellipsoid fit
+  for (i = X; i <= Z; i++) {
+    fd[6 + i] = (fm[i] - Ref[i]) * (1.0F / MAGCAL_SCALE_UT);
+  }
+  fd[0] = fd[6] * fd[6];
+  fd[1] = fd[6] * fd[7];
+  fd[2] = fd[6] * fd[8];
+  fd[3] = fd[7] * fd[7];
+  fd[4] = fd[7] * fd[8];
+  fd[5] = fd[8] * fd[8];
+  fd[9] = 1.0F;
+
+  // accumulate the upper triangle of the normal matrix
+  k = 0;
+  for (i = 0; i < 10; i++) {
+    for (j = i; j < 10; j++) {
+      Sums[k++] += fd[i] * fd[j];
+    }
+  }
+
+  // halve the weight of everything so far once the count reaches the limit
+  if (Sums[MAGCAL_SUMS - 1] >= MAGCAL_MAX_SAMPLES) {
+    for (k = 0; k < MAGCAL_SUMS; k++) {
+      Sums[k] *= 0.5F;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+ * @brief Fits the calibration to the readings added so far, all steps at
+ * once.
+ */
+/**************************************************************************/
+bool Adafruit_AHRS_MagCalibration::solve() {
+  bool replaced = false;
+
+  startSolve();
+  while (isSolving()) {
+    replaced = solveStep();
+  }
+  return replaced;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Starts a fit to the readings added so far.
+ */
+/**************************************************************************/
+void Adafruit_AHRS_MagCalibration::startSolve() {
+  // let a newer fit replace the calibration as it ages
+  FitErrorpc *= MAGCAL_FIT_ERROR_AGING;
+  Step = MAGCAL_STEP_START;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Runs the next slice of the fit. The first slice works on the sums
+ * directly and copies the normal matrix, so readings added while the fit runs
+ * do not disturb it.
+ */
+/**************************************************************************/
+bool Adafruit_AHRS_MagCalibration::solveStep() {
+  int8_t i, j;
+
+  switch (Step) {
+  case MAGCAL_STEP_START:
+    SolveN = Sums[MAGCAL_SUMS - 1];
+    if (SolveN < MAGCAL_MIN_SAMPLES_4) {
+      Step = MAGCAL_STEP_IDLE;
+      return false;
+    }
+    // the readings must surround the sensor or the fits are singular
+    SolveSpread = minSpread();
+    SolveValid4 = solve4(&SolveB4, &SolveFitError4pc, SolveV4);
+    if (SolveN < MAGCAL_MIN_SAMPLES_10) {
+      Step = MAGCAL_STEP_FINISH;
+      return false;
+    }
+    for (i = 0; i < 10; i++) {
+      for (j = i; j < 10; j++) {
+        EigA[i][j] = EigA[j][i] = Sums[sym10(i, j)];
+      }
+    }
+    eigeninit(EigA, EigVal, EigVec, 10);
+    SweepRow = 0;
+    SweepCol = 1;
+    Sweeps = 0;
+    Step = MAGCAL_STEP_ROTATE;
+    return false;
+
+  case MAGCAL_STEP_ROTATE:
+    // each sweep rotates every above diagonal element in row order, like
+    // eigencompute(), until they are all zero
+    if (SweepRow == 0 && SweepCol == 1) {
+      if (Sweeps >= MAGCAL_MAX_SWEEPS || !(eigenresidue(EigA, 10) > 0.0F)) {
+        Step = MAGCAL_STEP_FINISH;
+        return false;
+      }
+      Sweeps++;
+    }
+    eigenrotate(EigA, EigVal, EigVec, 10, SweepRow, SweepCol);
+    if (++SweepCol == 10) {
+      if (++SweepRow == 9) {
+        SweepRow = 0;
+      }
+      SweepCol = SweepRow + 1;
+    }
+    return false;
+
+  case MAGCAL_STEP_FINISH:
+    Step = MAGCAL_STEP_IDLE;
+    return finishSolve();
+
+  default:
+    return false;
+  }
+}
+
+/**************************************************************************/
+/*!
+ * @brief Picks the 10 element fit if it ran and is plausible, else the 4
+ * element fit, and keeps it if it beats the current calibration.
+ */
+/**************************************************************************/
+bool Adafruit_AHRS_MagCalibration::finishSolve() {
+  float fB;             // field strength of the new fit (uT)
+  float fFitErrorpc;    // fit error of the new fit (%)
+  float fV[3];          // hard iron offset of the new fit (uT)
+  float finvW[3][3];    // inverse soft iron matrix of the new fit
+  uint8_t iSolver = 0;  // fit that produced the new calibration
+  int8_t i, j;
+
+  if (SolveN >= MAGCAL_MIN_SAMPLES_10 &&
+      solve10(&fB, &fFitErrorpc, fV, finvW)) {
+    iSolver = 10;
+  }
+  if (iSolver && (fB < MAGCAL_MIN_B_UT || fB > MAGCAL_MAX_B_UT ||
+                  fFitErrorpc > MAGCAL_MAX_FIT_ERROR_PC ||
+                  SolveSpread < MAGCAL_MIN_SPREAD * fB)) {
+    iSolver = 0;
+  }
+  if (!iSolver && SolveValid4) {
+    fB = SolveB4;
+    fFitErrorpc = SolveFitError4pc;
+    for (i = X; i <= Z; i++) {
+      fV[i] = SolveV4[i];
+    }
+    f3x3matrixAeqI(finvW);
+    iSolver = 4;
+    if (fB < MAGCAL_MIN_B_UT || fB > MAGCAL_MAX_B_UT ||
+        fFitErrorpc > MAGCAL_MAX_FIT_ERROR_PC ||
+        SolveSpread < MAGCAL_MIN_SPREAD * fB) {
+      iSolver = 0;
+    }
+  }
+  // the first 10 element fit replaces a 4 element one, otherwise the fit
+  // error has to improve
+  if (!iSolver ||
+      (ValidMagCal && iSolver <= Solver && fFitErrorpc >= FitErrorpc)) {
+    return false;
+  }
+
+  for (i = X; i <= Z; i++) {
+    V[i] = fV[i];
+    for (j = X; j <= Z; j++) {
+      invW[i][j] = finvW[i][j];
+    }
+  }
+  B = fB;
+  FourBsq = 4.0F * fB * fB;
+  FitErrorpc = fFitErrorpc;
+  Solver = iSolver;
+  ValidMagCal = 1;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Applies the calibration to a reading.
+ */
+/**************************************************************************/
+void Adafruit_AHRS_MagCalibration::apply(float mx, float my, float mz,
+                                         float *cx, float *cy,
+                                         float *cz) const {
+  float fx = mx - V[X];
+  float fy = my - V[Y];
+  float fz = mz - V[Z];
+
+  *cx = invW[X][X] * fx + invW[X][Y] * fy + invW[X][Z] * fz;
+  *cy = invW[Y][X] * fx + invW[Y][Y] * fy + invW[Y][Z] * fz;
+  *cz = invW[Z][X] * fx + invW[Z][Y] * fy + invW[Z][Z] * fz;
+}
+
+/**************************************************************************/
+/*!
+ * @brief 4 element fit of the hard iron offset and the field strength,
+ * |m - V|^2 = B^2 solved by linear least squares for 2V and B^2 - |V|^2.
+ * All its sums are contained in the 10 element normal matrix.
+ */
+/**************************************************************************/
+bool Adafruit_AHRS_MagCalibration::solve4(float *pfB, float *pfFitErrorpc,
+                                          float fV[]) {
+  float fmatA[4][4]; // normal matrix and its inverse
+  float fvecB[4];    // sum of the readings times |u|^2
+  float fP[4];       // solution (2 V, B^2 - |V|^2) in scaled units
+  float fy2;         // sum of |u|^4
+  float fBsq;        // scaled field strength squared
+  float fresidue;    // sum of the squared residuals
+  float fN = Sums[sym10(9, 9)];
+  float *pfRows[4];
+  int8_t iColInd[4];
+  int8_t iRowInd[4];
+  int8_t iPivot[4];
+  int8_t i, j;
+
+  for (i = X; i <= Z; i++) {
+    for (j = X; j <= Z; j++) {
+      fmatA[i][j] = Sums[sym10(6 + i, 6 + j)];
+    }
+    fmatA[i][3] = fmatA[3][i] = Sums[sym10(6 + i, 9)];
+    fvecB[i] = Sums[sym10(0, 6 + i)] + Sums[sym10(3, 6 + i)] +
+               Sums[sym10(5, 6 + i)];
+  }
+  fmatA[3][3] = fN;
+  fvecB[3] = Sums[sym10(0, 9)] + Sums[sym10(3, 9)] + Sums[sym10(5, 9)];
+  fy2 = Sums[sym10(0, 0)] + Sums[sym10(3, 3)] + Sums[sym10(5, 5)] +
+        2.0F * (Sums[sym10(0, 3)] + Sums[sym10(0, 5)] + Sums[sym10(3, 5)]);
+
+  for (i = 0; i < 4; i++) {
+    pfRows[i] = fmatA[i];
+  }
+  fmatrixAeqInvA(pfRows, iColInd, iRowInd, iPivot, 4);
+
+  // solution and its residual sum of squares y^2 - p . (X^T y)
+  fresidue = fy2;
+  for (i = 0; i < 4; i++) {
+    fP[i] = 0.0F;
+    for (j = 0; j < 4; j++) {
+      fP[i] += fmatA[i][j] * fvecB[j];
+    }
+    fresidue -= fP[i] * fvecB[i];
+  }
+  if (fresidue < 0.0F) {
+    fresidue = 0.0F;
+  }
+
+  fBsq = fP[3];
+  for (i = X; i <= Z; i++) {
+    fV[i] = 0.5F * fP[i];
+    fBsq += fV[i] * fV[i];
+  }
+  if (fBsq <= 0.0F) {
+    return false;
+  }
+
+  // |u - V|^2 - B^2 is close to 2 B times the error of the field magnitude
+  *pfFitErrorpc = 100.0F * sqrtf(fresidue / fN) / (2.0F * fBsq);
+  *pfB = sqrtf(fBsq) * MAGCAL_SCALE_UT;
+  for (i = X; i <= Z; i++) {
+    fV[i] = Ref[i] + fV[i] * MAGCAL_SCALE_UT;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+ * @brief 10 element ellipsoid fit u^T A u + b^T u + c = 0. The coefficients
+ * are the eigenvector of the normal matrix with the smallest eigenvalue,
+ * from the decomposition the MAGCAL_STEP_ROTATE slices left in EigVal and
+ * EigVec. Once that eigenvector is copied out, the 3x3 decomposition of A
+ * runs in EigA, EigVec and EigVal instead of 10x10 arrays on the stack.
+ */
+/**************************************************************************/
+bool Adafruit_AHRS_MagCalibration::solve10(float *pfB, float *pfFitErrorpc,
+                                           float fV[], float finvW[][3]) {
+  float fA3x3[3][3];     // ellipsoid matrix A
+  float finvA3x3[3][3];  // its inverse
+  float fP[10];          // ellipsoid coefficients
+  float fk;              // (u - V)^T A (u - V) on the ellipsoid
+  float fdet;            // determinant
+  float fBu;             // scaled field strength
+  float ftmp;            // scratch
+  float fN = SolveN;
+  int8_t i, j, k, imin;
+
+  imin = 0;
+  for (i = 1; i < 10; i++) {
+    if (EigVal[i] < EigVal[imin]) {
+      imin = i;
+    }
+  }
+  for (i = 0; i < 10; i++) {
+    fP[i] = EigVec[i][imin];
+  }
+  ftmp = EigVal[imin];
+
+  // the eigenvector sign is arbitrary, pick the one with a positive definite A
+  fA3x3[0][0] = fP[0];
+  fA3x3[0][1] = fA3x3[1][0] = 0.5F * fP[1];
+  fA3x3[0][2] = fA3x3[2][0] = 0.5F * fP[2];
+  fA3x3[1][1] = fP[3];
+  fA3x3[1][2] = fA3x3[2][1] = 0.5F * fP[4];
+  fA3x3[2][2] = fP[5];
+  fdet = f3x3matrixDetA(fA3x3);
+  if (fdet < 0.0F) {
+    for (i = 0; i < 10; i++) {
+      fP[i] = -fP[i];
+    }
+    for (i = X; i <= Z; i++) {
+      for (j = X; j <= Z; j++) {
+        fA3x3[i][j] = -fA3x3[i][j];
+      }
+    }
+    fdet = -fdet;
+  }
+  if (fdet <= 0.0F) {
+    return false;
+  }
+
+  // centre V = -1/2 inv(A) b and k = V^T A V - c
+  f3x3matrixAeqInvSymB(finvA3x3, fA3x3);
+  for (i = X; i <= Z; i++) {
+    fV[i] = -0.5F * (finvA3x3[i][X] * fP[6] + finvA3x3[i][Y] * fP[7] +
+                     finvA3x3[i][Z] * fP[8]);
+  }
+  fk = -fP[9];
+  for (i = X; i <= Z; i++) {
+    for (j = X; j <= Z; j++) {
+      fk += fV[i] * fA3x3[i][j] * fV[j];
+    }
+  }
+  if (fk <= 0.0F) {
+    return false;
+  }
+
+  // invW is the square root of A / k scaled to unit determinant times B
+  for (i = X; i <= Z; i++) {
+    for (j = X; j <= Z; j++) {
+      EigA[i][j] = fA3x3[i][j] / fk;
+    }
+  }
+  eigencompute(EigA, EigVal, EigVec, 3);
+  if (EigVal[X] <= 0.0F || EigVal[Y] <= 0.0F || EigVal[Z] <= 0.0F) {
+    return false;
+  }
+  fBu = powf(EigVal[X] * EigVal[Y] * EigVal[Z], -1.0F / 6.0F);
+  for (i = X; i <= Z; i++) {
+    EigVal[i] = sqrtf(EigVal[i]) * fBu;
+  }
+  for (i = X; i <= Z; i++) {
+    for (j = X; j <= Z; j++) {
+      finvW[i][j] = 0.0F;
+      for (k = X; k <= Z; k++) {
+        finvW[i][j] += EigVec[i][k] * EigVal[k] * EigVec[j][k];
+      }
+    }
+  }
+
+  // the residual of a reading divided by k is close to twice the relative
+  // error of its calibrated magnitude
+  if (ftmp < 0.0F) {
+    ftmp = 0.0F;
+  }
+  *pfFitErrorpc = 100.0F * sqrtf(ftmp / fN) / (2.0F * fk);
+  *pfB = fBu * MAGCAL_SCALE_UT;
+  for (i = X; i <= Z; i++) {
+    fV[i] = Ref[i] + fV[i] * MAGCAL_SCALE_UT;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Smallest rms spread of the readings along any direction, from the
+ * covariance of the readings held in the sums. Runs before the 10 element
+ * fit fills EigA, so it decomposes the covariance there.
+ */
+/**************************************************************************/
+float Adafruit_AHRS_MagCalibration::minSpread() {
+  float fmean[3];      // mean scaled reading
+  float fN = Sums[sym10(9, 9)];
+  float fmin;
+  int8_t i, j;
+
+  for (i = X; i <= Z; i++) {
+    fmean[i] = Sums[sym10(6 + i, 9)] / fN;
+  }
+  for (i = X; i <= Z; i++) {
+    for (j = X; j <= Z; j++) {
+      EigA[i][j] = Sums[sym10(6 + i, 6 + j)] / fN - fmean[i] * fmean[j];
+    }
+  }
+  eigencompute(EigA, EigVal, EigVec, 3);
+
+  fmin = EigVal[X];
+  if (EigVal[Y] < fmin) {
+    fmin = EigVal[Y];
+  }
+  if (EigVal[Z] < fmin) {
+    fmin = EigVal[Z];
+  }
+  if (fmin < 0.0F) {
+    fmin = 0.0F;
+  }
+  return sqrtf(fmin) * MAGCAL_SCALE_UT;
+}
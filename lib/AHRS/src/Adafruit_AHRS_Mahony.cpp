@@ -0,0 +1,233 @@
+/*!
+ * @file Adafruit_AHRS_Mahony.cpp
+ *
+ * 6DOF Mahony complementary filter, see Adafruit_AHRS_Mahony.h.
+ */
+
+#include "Adafruit_AHRS_Mahony.h"
+#include "Adafruit_AHRS_NXPTrig.h"
+#include <string.h>
+
+#define FDEGTORAD 0.01745329251994F // degrees to radians conversion = pi / 180
+
+/**************************************************************************/
+/*!
+ * @brief Constructs the filter.
+ */
+/**************************************************************************/
+Adafruit_Mahony::Adafruit_Mahony(float prop_gain, float int_gain) {
+  twoKp = 2.0f * prop_gain;
+  twoKi = 2.0f * int_gain;
+  begin();
+}
+
+/**************************************************************************/
+/*!
+ * @brief Initializes the filter.
+ */
+/**************************************************************************/
+void Adafruit_Mahony::begin(float sampleFrequency) {
+  invSampleFreq = 1.0f / sampleFrequency;
+  q0 = 1.0f;
+  q1 = q2 = q3 = 0.0f;
+  integralFBx = integralFBy = integralFBz = 0.0f;
+  accel[0] = accel[1] = 0.0f;
+  accel[2] = 1.0f;
+  anglesComputed = false;
+  firstTiltLock = false;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Updates the filter with new gyroscope and accelerometer data.
+ */
+/**************************************************************************/
+void Adafruit_Mahony::updateIMU(float gx, float gy, float gz, float ax,
+                                float ay, float az) {
+  float recipNorm, normSq;
+  float halfvx, halfvy, halfvz;
+  float halfex, halfey, halfez;
+  float qa, qb, qc;
+
+  accel[0] = ax;
+  accel[1] = ay;
+  accel[2] = az;
+
+  // convert gyroscope degrees/sec to radians/sec
+  gx *= FDEGTORAD;
+  gy *= FDEGTORAD;
+  gz *= FDEGTORAD;
+
+  // compute feedback only if accelerometer measurement valid
+  // (avoids NaN in accelerometer normalisation)
+  if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+    // normalise accelerometer measurement
+    recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    // start from the accelerometer tilt instead of the identity so the
+    // feedback does not spend seconds converging on the pad. this is the
+    // conjugate of the shortest rotation taking the down axis onto the
+    // measured gravity direction, with zero yaw
+    if (!firstTiltLock) {
+      if (az > -0.9999f) {
+        q0 = 1.0f + az;
+        q1 = ay;
+        q2 = -ax;
+        q3 = 0.0f;
+        recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2);
+        q0 *= recipNorm;
+        q1 *= recipNorm;
+        q2 *= recipNorm;
+      } else {
+        // upside down, roll by 180 deg
+        q0 = q2 = q3 = 0.0f;
+        q1 = 1.0f;
+      }
+      firstTiltLock = true;
+    }
+
+    // estimated direction of gravity in the sensor frame, half of the z
+    // column of the NXP orientation matrix
+    halfvx = q1 * q3 - q0 * q2;
+    halfvy = q0 * q1 + q2 * q3;
+    halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+    // error is the cross product between the measured and the estimated
+    // direction of gravity. the order is swapped from the original Mahony
+    // filter because the NXP orientation maps global to sensor frame
+    halfex = (ay * halfvz - az * halfvy);
+    halfey = (az * halfvx - ax * halfvz);
+    halfez = (ax * halfvy - ay * halfvx);
+
+    // compute and apply integral feedback if enabled
+    if (twoKi > 0.0f) {
+      // integral error scaled by Ki
+      integralFBx += twoKi * halfex * invSampleFreq;
+      integralFBy += twoKi * halfey * invSampleFreq;
+      integralFBz += twoKi * halfez * invSampleFreq;
+      gx += integralFBx; // apply integral feedback
+      gy += integralFBy;
+      gz += integralFBz;
+    } else {
+      integralFBx = 0.0f; // prevent integral windup
+      integralFBy = 0.0f;
+      integralFBz = 0.0f;
+    }
+
+    // apply proportional feedback
+    gx += twoKp * halfex;
+    gy += twoKp * halfey;
+    gz += twoKp * halfez;
+  }
+
+  // integrate rate of change of quaternion q = q * (0, omega) / 2
+  gx *= (0.5f * invSampleFreq); // pre-multiply common factors
+  gy *= (0.5f * invSampleFreq);
+  gz *= (0.5f * invSampleFreq);
+  qa = q0;
+  qb = q1;
+  qc = q2;
+  q0 += (-qb * gx - qc * gy - q3 * gz);
+  q1 += (qa * gx + qc * gz - q3 * gy);
+  q2 += (qa * gy - qb * gz + q3 * gx);
+  q3 += (qa * gz + qb * gy - qc * gx);
+
+  // normalise quaternion. a third Newton step takes the norm from 1E-5 to
+  // float precision, otherwise the tilt near vertical reads about 0.3 deg
+  normSq = q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3;
+  recipNorm = invSqrt(normSq);
+  recipNorm *= 1.5f - 0.5f * normSq * recipNorm * recipNorm;
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+  anglesComputed = false;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Get the linear acceleration (gravity removed) in the global frame.
+ */
+/**************************************************************************/
+void Adafruit_Mahony::getGlobalLinearAcceleration(float *x, float *y,
+                                                  float *z) {
+  // de-rotate the accelerometer reading with the transpose of the NXP
+  // orientation matrix, then remove gravity and flip the sign as the NXP
+  // filter does
+  float R[3][3];
+  R[0][0] = 2.0f * (q0 * q0 + q1 * q1) - 1.0f;
+  R[0][1] = 2.0f * (q1 * q2 + q0 * q3);
+  R[0][2] = 2.0f * (q1 * q3 - q0 * q2);
+  R[1][0] = 2.0f * (q1 * q2 - q0 * q3);
+  R[1][1] = 2.0f * (q0 * q0 + q2 * q2) - 1.0f;
+  R[1][2] = 2.0f * (q2 * q3 + q0 * q1);
+  R[2][0] = 2.0f * (q1 * q3 + q0 * q2);
+  R[2][1] = 2.0f * (q2 * q3 - q0 * q1);
+  R[2][2] = 2.0f * (q0 * q0 + q3 * q3) - 1.0f;
+
+  *x = -(R[0][0] * accel[0] + R[1][0] * accel[1] + R[2][0] * accel[2]);
+  *y = -(R[0][1] * accel[0] + R[1][1] * accel[1] + R[2][1] * accel[2]);
+  *z = -(R[0][2] * accel[0] + R[1][2] * accel[1] + R[2][2] * accel[2] - 1.0f);
+}
+
+/**************************************************************************/
+/*!
+ * @brief Fast inverse square root.
+ * See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
+ */
+/**************************************************************************/
+float Adafruit_Mahony::invSqrt(float x) {
+  float halfx = 0.5f * x;
+  float y = x;
+  int32_t i;
+  memcpy(&i, &y, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  memcpy(&y, &i, sizeof(y));
+  y = y * (1.5f - (halfx * y * y));
+  y = y * (1.5f - (halfx * y * y));
+  return y;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Computes the NXP NED angles from the quaternion.
+ */
+/**************************************************************************/
+void Adafruit_Mahony::computeAngles() {
+  float Rxx = 2.0f * (q0 * q0 + q1 * q1) - 1.0f;
+  float Rxy = 2.0f * (q1 * q2 + q0 * q3);
+  float Rxz = 2.0f * (q1 * q3 - q0 * q2);
+  float Ryy = 2.0f * (q0 * q0 + q2 * q2) - 1.0f;
+  float Ryz = 2.0f * (q2 * q3 + q0 * q1);
+  float Rzy = 2.0f * (q2 * q3 - q0 * q1);
+  float Rzz = 2.0f * (q0 * q0 + q3 * q3) - 1.0f;
+
+  // pitch -90 to 90 deg, roll -180 to 180 deg
+  pitch = fasin_deg(-Rxz);
+  roll = fatan2_deg(Ryz, Rzz);
+  if (roll == 180.0f) {
+    roll = -180.0f;
+  }
+
+  // yaw 0 to 360 deg, with the gimbal lock cases of the NXP filter
+  if (pitch == 90.0f) {
+    yaw = fatan2_deg(Rzy, Ryy) + roll;
+  } else if (pitch == -90.0f) {
+    yaw = fatan2_deg(-Rzy, Ryy) - roll;
+  } else {
+    yaw = fatan2_deg(Rxy, Rxx);
+  }
+  if (yaw < 0.0f) {
+    yaw += 360.0f;
+  }
+  if (yaw >= 360.0f) {
+    yaw = 0.0f;
+  }
+
+  // tilt from vertical 0 to 180 deg
+  tilt = facos_deg(Rzz);
+  anglesComputed = true;
+}
@@ -36,38 +36,12 @@
  */
 
 #include "Adafruit_AHRS_NXPFusion.h"
+#include "Adafruit_AHRS_NXPFusionTuning.h"
+#include "Adafruit_AHRS_NXPTrig.h"
+#ifndef ARDUINO
+#include <chrono>
+#endif
 
-// kalman filter noise variances
-#define FQVA_9DOF_GBY_KALMAN 1E-15F // accelerometer noise g^2 so 1.4mg RMS
-#define FQVM_9DOF_GBY_KALMAN 1E-15F  // magnetometer noise uT^2
-#define FQVG_9DOF_GBY_KALMAN 1E-15F  // gyro noise (deg/s)^2
-#define FQWB_9DOF_GBY_KALMAN                                                   \
-  1E-25F // gyro offset drift (deg/s)^2: 1E-9 implies 0.09deg/s max at 50Hz
-#define FQWA_9DOF_GBY_KALMAN                                                   \
-  1E-25F // linear acceleration drift g^2 (increase slows convergence to g but
-        // reduces sensitivity to shake)
-#define FQWD_9DOF_GBY_KALMAN                                                   \
-  10E-37F // magnetic disturbance drift uT^2 (increase slows convergence to B but
-       // reduces sensitivity to magnet)
-// initialization of Qw covariance matrix
-#define FQWINITTHTH_9DOF_GBY_KALMAN 2E-2F // th_e * th_e terms
-#define FQWINITBB_9DOF_GBY_KALMAN 2E-2F    // b_e * b_e terms
-#define FQWINITTHB_9DOF_GBY_KALMAN 0.0F      // th_e * b_e terms
-#define FQWINITAA_9DOF_GBY_KALMAN                                              \
-  10E-1F // a_e * a_e terms (increase slows convergence to g but reduces
-         // sensitivity to shake) //10E-5F
-#define FQWINITDD_9DOF_GBY_KALMAN                                              \
-  10E-1F // d_e * d_e terms (increase slows convergence to B but reduces
-          // sensitivity to magnet)
-// linear acceleration and magnetic disturbance time constants
-#define FCA_9DOF_GBY_KALMAN 10E-37F // linear acceleration decay factor
-#define FCD_9DOF_GBY_KALMAN 10E-37F // magnetic disturbance decay factor
-// maximum geomagnetic inclination angle tracked by Kalman filter
-#define SINDELTAMAX                                                            \
-  0.9063078F // sin of max +ve geomagnetic inclination angle: here 65.0 deg
-#define COSDELTAMAX                                                            \
-  0.4226183F // cos of max +ve geomagnetic inclination angle: here 65.0 deg
-#define DEFAULTB 50.0F // default geomagnetic field (uT)
 #define X 0            // vector components
 #define Y 1
 #define Z 2
@@ -75,16 +49,67 @@
 #define FRADTODEG 57.2957795130823F  // radians to degrees conversion = 180 / pi
 #define ONEOVER48 0.02083333333F     // 1 / 48
 #define ONEOVER3840 0.0002604166667F // 1 / 3840
+#define TWOOVER3 0.6666666667F       // 2 / 3
 
 #define Quaternion_t Adafruit_NXPSensorFusion::Quaternion_t
 
+static_assert(SYM12_PACKED_SIZE == 12 * 13 / 2 && SYM9_PACKED_SIZE == 9 * 10 / 2,
+              "Packed covariance sizes must match their upper triangles");
+#ifdef AHRS_NXP_PROFILE
+static_assert(sizeof(Adafruit_NXPSensorFusion) <=
+                  AHRS_NXP_RAM_BUDGET + AHRS_NXP_PROFILE_RAM,
+              "Adafruit_NXPSensorFusion exceeds AHRS_NXP_RAM_BUDGET");
+#else
+static_assert(sizeof(Adafruit_NXPSensorFusion) <= AHRS_NXP_RAM_BUDGET,
+              "Adafruit_NXPSensorFusion exceeds AHRS_NXP_RAM_BUDGET");
+#endif
+
+// microsecond timestamp for timing the gain refresh
+static inline uint32_t fusionMicros() {
+#ifdef ARDUINO
+  return micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+#ifdef AHRS_NXP_PROFILE
+// timestamp for the stage profile: core cycles from the DWT cycle counter on
+// the board, ns from a steady clock on a host
+static inline uint32_t fusionTicks() {
+#if defined(ARDUINO) && defined(DWT)
+  return DWT->CYCCNT;
+#elif defined(ARDUINO)
+  return micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// start timing into t, add the time since t to a stage and carry on from
+// now, or carry on from now without adding the time since t (it was timed
+// somewhere else)
+#define NXP_PROFILE_START(t) uint32_t t = fusionTicks()
+#define NXP_PROFILE_LAP(stage, t) t = profileLap(stage, t)
+#define NXP_PROFILE_RESTART(t) t = fusionTicks()
+#else
+#define NXP_PROFILE_START(t)
+#define NXP_PROFILE_LAP(stage, t)
+#define NXP_PROFILE_RESTART(t)
+#endif
+
 static void fqAeq1(Quaternion_t *pqA);
-static void feCompassNED(float fR[][3], float *pfDelta, const float fBc[],
-                         const float fGp[]);
+void f3DOFTiltNED(float fR[][3], float fGp[]);
+void feCompassNED(float fR[][3], float *pfDelta, const float fBc[],
+                  const float fGp[]);
 static void fNEDAnglesDegFromRotationMatrix(float R[][3], float *pfPhiDeg,
                                             float *pfTheDeg, float *pfPsiDeg,
                                             float *pfRhoDeg, float *pfChiDeg);
-static void fQuaternionFromRotationMatrix(float R[][3], Quaternion_t *pq);
+void fQuaternionFromRotationMatrix(float R[][3], Quaternion_t *pq);
 static void fQuaternionFromRotationVectorDeg(Quaternion_t *pq,
                                              const float rvecdeg[],
                                              float fscaling);
@@ -96,11 +121,6 @@ static void qAeqBxC(Quaternion_t *pqA, const Quaternion_t *pqB,
 // static Quaternion_t qconjgAxB(const Quaternion_t *pqA, const Quaternion_t
 // *pqB);
 static void fqAeqNormqA(Quaternion_t *pqA);
-static float fasin_deg(float x);
-static float facos_deg(float x);
-static float fatan_deg(float x);
-static float fatan2_deg(float y, float x);
-static float fatan_15deg(float x);
 
 extern "C" {
 void f3x3matrixAeqI(float A[][3]);
@@ -123,38 +143,60 @@ void fmatrixAeqRenormRotA(float A[][3]);
  * @brief Initializes the 9DOF Kalman filter.
  */
 /**************************************************************************/
-void Adafruit_NXPSensorFusion::begin(float sampleFrequency) {
+void Adafruit_NXPSensorFusion::begin(float sampleFrequency,
+                                     uint8_t oversampleRatio) {
+#ifdef ARDUINO
   Serial.println("AHRS begin called");
+#endif
   int8_t i, j;
 
   // reset the flag denoting that a first 9DOF orientation lock has been
   // achieved
   FirstOrientationLock = 0;
+  FirstTiltLock = 0;
 
   // compute and store useful product terms to save floating point calculations
   // later
+  if (oversampleRatio < 1) {
+    oversampleRatio = 1;
+  }
+  OversampleRatio = oversampleRatio;
   Fastdeltat = 1.0f / sampleFrequency;
-  deltat = Fastdeltat;
+  deltat = OversampleRatio * Fastdeltat;
   deltatsq = deltat * deltat;
   casq = FCA_9DOF_GBY_KALMAN * FCA_9DOF_GBY_KALMAN;
+#ifndef AHRS_NXP_6DOF
   cdsq = FCD_9DOF_GBY_KALMAN * FCD_9DOF_GBY_KALMAN;
+#endif
   QwbplusQvG = FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN;
 
-  // initialize the fixed entries in the measurement matrix C
+#ifdef AHRS_NXP_6DOF
+  // zero the variable part of the measurement matrix C. the fixed +I block in
+  // columns 6-8 is not stored
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 6; j++) {
+      C3x6[i][j] = 0.0F;
+    }
+  }
+#else
+  // zero the variable part of the measurement matrix C. the fixed +I and -I
+  // blocks in columns 6-11 are not stored
   for (i = 0; i < 6; i++) {
-    for (j = 0; j < 12; j++) {
-      C6x12[i][j] = 0.0F;
+    for (j = 0; j < 6; j++) {
+      C6x6[i][j] = 0.0F;
     }
   }
-  C6x12[0][6] = C6x12[1][7] = C6x12[2][8] = 1.0F;
-  C6x12[3][9] = C6x12[4][10] = C6x12[5][11] = -1.0F;
+#endif
 
   // zero a posteriori orientation, error vector xe+ (thetae+, be+, de+, ae+)
   // and b+ and inertial
   f3x3matrixAeqI(RPl);
   fqAeq1(&qPl);
   for (i = X; i <= Z; i++) {
-    ThErrPl[i] = bErrPl[i] = aErrSePl[i] = dErrSePl[i] = bPl[i] = 0.0F;
+    ThErrPl[i] = bErrPl[i] = aErrSePl[i] = bPl[i] = 0.0F;
+#ifndef AHRS_NXP_6DOF
+    dErrSePl[i] = 0.0F;
+#endif
   }
 
   // initialize the reference geomagnetic vector (uT, global frame)
@@ -164,10 +206,28 @@ void Adafruit_NXPSensorFusion::begin(float sampleFrequency) {
   mGl[Y] = 0.0F;
   mGl[Z] = 0.0F;
 
+  // the magnetometer is ignored until setMagCalibration()
+  MagCalValid = 0;
+  MagB = DEFAULTB;
+  MagFourBsq = 4.0F * DEFAULTB * DEFAULTB;
+
   // initialize noise variances for Qv and Qw matrix updates
   QvAA = FQVA_9DOF_GBY_KALMAN + FQWA_9DOF_GBY_KALMAN +
          FDEGTORAD * FDEGTORAD * deltatsq *
              (FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN);
+#ifdef AHRS_NXP_6DOF
+  // initialize the 9x9 noise covariance matrix Qw of the a priori error
+  // vector xe- (thetae-, be-, ae-) the same way as the 12x12 matrix below
+  for (i = 0; i < SYM9_PACKED_SIZE; i++) {
+    QwUT9x9[i] = 0.0F;
+  }
+  for (i = 0; i < 3; i++) {
+    QwUT9x9[symIndex9(i, i)] = FQWINITTHTH_9DOF_GBY_KALMAN;
+    QwUT9x9[symIndex9(i + 3, i + 3)] = FQWINITBB_9DOF_GBY_KALMAN;
+    QwUT9x9[symIndex9(i, i + 3)] = FQWINITTHB_9DOF_GBY_KALMAN;
+    QwUT9x9[symIndex9(i + 6, i + 6)] = FQWINITAA_9DOF_GBY_KALMAN;
+  }
+#else
   QvMM = FQVM_9DOF_GBY_KALMAN + FQWD_9DOF_GBY_KALMAN +
          FDEGTORAD * FDEGTORAD * deltatsq * DEFAULTB * DEFAULTB *
              (FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN);
@@ -175,24 +235,51 @@ void Adafruit_NXPSensorFusion::begin(float sampleFrequency) {
   // initialize the 12x12 noise covariance matrix Qw of the a priori error
   // vector xe- Qw is then recursively updated as P+ = (1 - K * C) * P- = (1 - K
   // * C) * Qw  and Qw updated from P+ zero the matrix Qw
-  for (i = 0; i < 12; i++) {
-    for (j = 0; j < 12; j++) {
-      Qw12x12[i][j] = 0.0F;
-    }
+  for (i = 0; i < SYM12_PACKED_SIZE; i++) {
+    QwUT12x12[i] = 0.0F;
   }
   // loop over non-zero values
   for (i = 0; i < 3; i++) {
     // theta_e * theta_e terms
-    Qw12x12[i][i] = FQWINITTHTH_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i, i)] = FQWINITTHTH_9DOF_GBY_KALMAN;
     // b_e * b_e terms
-    Qw12x12[i + 3][i + 3] = FQWINITBB_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 3, i + 3)] = FQWINITBB_9DOF_GBY_KALMAN;
     // th_e * b_e terms
-    Qw12x12[i][i + 3] = Qw12x12[i + 3][i] = FQWINITTHB_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i, i + 3)] = FQWINITTHB_9DOF_GBY_KALMAN;
     // a_e * a_e terms
-    Qw12x12[i + 6][i + 6] = FQWINITAA_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 6, i + 6)] = FQWINITAA_9DOF_GBY_KALMAN;
     // d_e * d_e terms
-    Qw12x12[i + 9][i + 9] = FQWINITDD_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 9, i + 9)] = FQWINITDD_9DOF_GBY_KALMAN;
   }
+#endif
+
+  // drop any gyro readings integrated for the next update
+  PredictCount = 0;
+
+  // the rotation vector and angles follow from the identity orientation on
+  // demand, the linear acceleration is zero until the next update
+  for (i = X; i <= Z; i++) {
+    aGlPl[i] = aSeLast[i] = 0.0F;
+  }
+  derivedDirty = NXP_DERIVED_RVEC | NXP_DERIVED_ANGLES;
+
+  // restart the settle time of the steady-state gain mode
+  updateCount = 0;
+  gainRefreshCount = 0;
+  gainRefreshMicros = 0;
+
+#ifdef AHRS_NXP_PROFILE
+#if defined(ARDUINO) && defined(DWT)
+  // start the cycle counter, it does not run until trace is enabled
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  resetProfile();
+  for (i = 0; i < NXP_STAGE_COUNT; i++) {
+    stagePending[i] = 0;
+  }
+  stagePendingMask = 0;
+#endif
 
   // clear the reset flag
   resetflag = 0;
@@ -210,55 +297,58 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
   //Serial.println("update function entered");
   //Serial.printf("update entered with values\n\t %f %f %f \n\t %f %f %f \n\t %f %f %f\n", gx, gy, gz, ax, ay, az, mx, my, mz);
   float Accel[3] = {ax, ay, az}; // Accel
-  float Yp[3] = {gx, gy, gz};    // Gyro //typo from original as "Gryo"
+#ifndef AHRS_NXP_6DOF
   float Mag[3] = {mx, my, mz};   // Mag
+#endif
 
   // local scalars and arrays
+#ifndef AHRS_NXP_6DOF
   float fopp, fadj, fhyp;     // opposite, adjacent and hypoteneuse
   float fsindelta, fcosdelta; // sin and cos of inclination angle delta
-  float rvec[3];              // rotation vector
-  //Serial.printf("rvec is currently (1) %f %f %f\n",rvec[0],rvec[1],rvec[2]);
+#endif
   float ftmp;                 // scratch variable
-  float ftmpA12x6[12][6];     // scratch array
-  int8_t i, j, k;             // loop counters
+  uint32_t gainStart_us;      // start time of the gain refresh (us)
+  int8_t i;                   // loop counter
+#ifndef AHRS_NXP_6DOF
   int8_t iMagJamming;         // magnetic jamming flag
+#endif
+  int8_t iRefreshGain;        // recompute the Kalman gain on this update
+#ifndef AHRS_NXP_6DOF
   int8_t ValidMagCal;
-
-  // assorted array pointers
-  float *pfPPlus12x12ij;
-  float *pfPPlus12x12kj;
-  float *pfQw12x12ij;
-  float *pfQw12x12ik;
-  float *pfQw12x12kj;
-  float *pfK12x6ij;
-  float *pfK12x6ik;
-  float *pftmpA12x6ik;
-  float *pftmpA12x6kj;
-  float *pftmpA12x6ij;
-  float *pfC6x12ik;
-  float *pfC6x12jk;
-
-  // working arrays for 6x6 matrix inversion
-  float *pfRows[6];
-  int8_t iColInd[6];
-  int8_t iRowInd[6];
-  int8_t iPivot[6];
+#endif
 
   // do a reset and return if requested
   if (resetflag) {
-    begin(1.0f / deltat);
+    begin(1.0f / Fastdeltat, OversampleRatio);
     return;
   }
 
+#ifdef AHRS_NXP_PROFILE
+  // the previous filter cycle ends with this update
+  closeProfileCycle();
+#endif
+  NXP_PROFILE_START(tProfile);
+
+#ifdef AHRS_NXP_6DOF
+  // *********************************************************************************
+  // initial orientation lock to the accelerometer tilt, the magnetometer
+  // readings are not used
+  // *********************************************************************************
+  (void)mx;
+  (void)my;
+  (void)mz;
+  if (!FirstTiltLock) {
+    f3DOFTiltNED(RPl, Accel);
+    fQuaternionFromRotationMatrix(RPl, &qPl);
+    FirstTiltLock = 1;
+    PredictCount = 0;
+  }
+#else
   // *********************************************************************************
   // initial orientation lock to accelerometer and magnetometer eCompass
   // orientation
   // *********************************************************************************
-  if (fabsf(mx) <= 50.0f && fabsf(my) <= 50.0f && fabsf(mz) <= 50.0f) {
-    ValidMagCal = 1;
-  } else {
-    ValidMagCal = 0;
-  }
+  ValidMagCal = MagCalValid;
 
   // do a once-only orientation lock after the first valid magnetic calibration
   if (ValidMagCal && !FirstOrientationLock) {
@@ -271,37 +361,37 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
     // set the orientation lock flag so this initial alignment is only performed
     // once
     FirstOrientationLock = 1;
+
+    // gyro readings integrated by predict() started from the old orientation
+    PredictCount = 0;
+  } else if (!ValidMagCal && !FirstOrientationLock && !FirstTiltLock) {
+    // without a magnetometer start from the accelerometer tilt instead of the
+    // identity so the filter does not spend seconds converging on the pad.
+    // the 9DOF lock above still runs once the magnetometer becomes valid
+    f3DOFTiltNED(RPl, Accel);
+    fQuaternionFromRotationMatrix(RPl, &qPl);
+    FirstTiltLock = 1;
+    PredictCount = 0;
   }
+#endif
 
   // *********************************************************************************
   // calculate a priori rotation matrix
   // *********************************************************************************
 
+  // integrate the gyro reading of this update after the high rate readings
+  // already integrated into the a priori orientation quaternion by predict()
+  NXP_PROFILE_LAP(NXP_STAGE_CORRECTION, tProfile);
+  predict(gx, gy, gz);
+  NXP_PROFILE_RESTART(tProfile);
+
   // compute the angular velocity from the averaged high frequency gyro reading.
   // omega[k] = yG[k] - b-[k] = yG[k] - b+[k-1] (deg/s)
-  Omega[X] = Yp[X] - bPl[X];
-  Omega[Y] = Yp[Y] - bPl[Y];
-  Omega[Z] = Yp[Z] - bPl[Z];
-
-  // initialize the a priori orientation quaternion to the previous a posteriori
-  // estimate
-  qMi = qPl;
-
-  // integrate the buffered high frequency (typically 200Hz) gyro readings
-  // for (j = 0; j < OVERSAMPLE_RATIO; j++) {
-  // compute the incremental fast (typically 200Hz) rotation vector rvec (deg)
-  for (i = X; i <= Z; i++) {
-    rvec[i] = (Yp[i] - bPl[i]) * Fastdeltat; //originally = instead of +=
-  }
-//Serial.printf("rvec is currently (2) %f %f %f\n",rvec[0],rvec[1],rvec[2]);  
-  // compute the incremental quaternion fDeltaq from the rotation vector
-  fQuaternionFromRotationVectorDeg(&Deltaq, rvec, 1.0F);
-//Serial.printf("rvec is currently (3) %f %f %f\n",rvec[0],rvec[1],rvec[2]);
-  // incrementally rotate the a priori orientation quaternion fqMi
-  // the a posteriori quaternion fqPl is re-normalized later so this update is
-  // stable
-  qAeqAxB(&qMi, &Deltaq);
-  //}
+  ftmp = 1.0F / PredictCount;
+  Omega[X] = OmegaSum[X] * ftmp;
+  Omega[Y] = OmegaSum[Y] * ftmp;
+  Omega[Z] = OmegaSum[Z] * ftmp;
+  PredictCount = 0;
 
   // get the a priori rotation matrix from the a priori quaternion
   fRotationMatrixFromQuaternion(RMi, &qMi);
@@ -327,6 +417,7 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
     // gravity: y = g - a and g = y + a
     gErrSeMi[i] = Accel[i] + aSeMi[i] - gSeGyMi[i];
 
+#ifndef AHRS_NXP_6DOF
     // compute the a priori gyro estimate of the geomagnetic vector (uT, sensor
     // frame) using an absolute rotation of the global frame geomagnetic vector
     // (with magnitude B uT) NED y component of geomagnetic vector in global
@@ -336,181 +427,50 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
     // compute the a priori geomagnetic error vector (magnetometer minus gyro
     // estimates) (g, sensor frame)
     mErrSeMi[i] = Mag[i] - mSeGyMi[i];
+#endif
   }
 
   // *********************************************************************************
-  // update variable elements of measurement matrix C
-  // *********************************************************************************
-
-  // update measurement matrix C with -alpha(g-)x and -alpha(m-)x from gyro (g,
-  // uT, sensor frame)
-  C6x12[0][1] = FDEGTORAD * gSeGyMi[Z];
-  C6x12[0][2] = -FDEGTORAD * gSeGyMi[Y];
-  C6x12[1][2] = FDEGTORAD * gSeGyMi[X];
-  C6x12[1][0] = -C6x12[0][1];
-  C6x12[2][0] = -C6x12[0][2];
-  C6x12[2][1] = -C6x12[1][2];
-  C6x12[3][1] = FDEGTORAD * mSeGyMi[Z];
-  C6x12[3][2] = -FDEGTORAD * mSeGyMi[Y];
-  C6x12[4][2] = FDEGTORAD * mSeGyMi[X];
-  C6x12[4][0] = -C6x12[3][1];
-  C6x12[5][0] = -C6x12[3][2];
-  C6x12[5][1] = -C6x12[4][2];
-  C6x12[0][4] = -deltat * C6x12[0][1];
-  C6x12[0][5] = -deltat * C6x12[0][2];
-  C6x12[1][5] = -deltat * C6x12[1][2];
-  C6x12[1][3] = -C6x12[0][4];
-  C6x12[2][3] = -C6x12[0][5];
-  C6x12[2][4] = -C6x12[1][5];
-  C6x12[3][4] = -deltat * C6x12[3][1];
-  C6x12[3][5] = -deltat * C6x12[3][2];
-  C6x12[4][5] = -deltat * C6x12[4][2];
-  C6x12[4][3] = -C6x12[3][4];
-  C6x12[5][3] = -C6x12[3][5];
-  C6x12[5][4] = -C6x12[4][5];
-
-  // *********************************************************************************
-  // calculate the Kalman gain matrix K
-  // K = P- * C^T * inv(C * P- * C^T + Qv) = Qw * C^T * inv(C * Qw * C^T + Qv)
-  // Qw is used as a proxy for P- throughout the code
-  // P+ is used here as a working array to reduce RAM usage and is re-computed
-  // later
+  // recompute the Kalman gain K and the covariance matrices. in steady-state
+  // gain mode this only runs every gainRefreshInterval updates once the
+  // settle time has passed and the errors below use the last gain
   // *********************************************************************************
-
-  // set ftmpA12x6 = P- * C^T = Qw * C^T where Qw and C are both sparse
-  // C also has a significant number of +1 and -1 entries
-  // ftmpA12x6 is also sparse but not symmetric
-  for (i = 0; i < 12; i++) { // loop over rows of ftmpA12x6
-    // initialize pftmpA12x6ij for current i, j=0
-    pftmpA12x6ij = ftmpA12x6[i];
-
-    for (j = 0; j < 6; j++) { // loop over columns of ftmpA12x6
-      // zero ftmpA12x6[i][j]
-      *pftmpA12x6ij = 0.0F;
-
-      // initialize pfC6x12jk for current j, k=0
-      pfC6x12jk = C6x12[j];
-
-      // initialize pfQw12x12ik for current i, k=0
-      pfQw12x12ik = Qw12x12[i];
-
-      // sum matrix products over inner loop over k
-      for (k = 0; k < 12; k++) {
-        if ((*pfQw12x12ik != 0.0F) && (*pfC6x12jk != 0.0F)) {
-          if (*pfC6x12jk == 1.0F)
-            *pftmpA12x6ij += *pfQw12x12ik;
-          else if (*pfC6x12jk == -1.0F)
-            *pftmpA12x6ij -= *pfQw12x12ik;
-          else
-            *pftmpA12x6ij += *pfQw12x12ik * *pfC6x12jk;
-        }
-
-        // increment pfC6x12jk and pfQw12x12ik for next iteration of k
-        pfC6x12jk++;
-        pfQw12x12ik++;
-      }
-
-      // increment pftmpA12x6ij for next iteration of j
-      pftmpA12x6ij++;
+  iRefreshGain = 1;
+  if ((gainRefreshInterval > 1) &&
+      ((float)updateCount * deltat >= gainSettleTime_s)) {
+    if (++gainRefreshCount < gainRefreshInterval) {
+      iRefreshGain = 0;
+    } else {
+      gainRefreshCount = 0;
     }
   }
-
-  // set symmetric P+ (6x6 scratch sub-matrix) to C * P- * C^T + Qv
-  // = C * (Qw * C^T) + Qv = C * ftmpA12x6 + Qv
-  // both C and ftmpA12x6 are sparse but not symmetric
-  for (i = 0; i < 6; i++) { // loop over rows of P+
-    // initialize pfPPlus12x12ij for current i, j=i
-    pfPPlus12x12ij = PPlus12x12[i] + i;
-
-    for (j = i; j < 6; j++) { // loop over above diagonal columns of P+
-      // zero P+[i][j]
-      *pfPPlus12x12ij = 0.0F;
-
-      // initialize pfC6x12ik for current i, k=0
-      pfC6x12ik = C6x12[i];
-
-      // initialize pftmpA12x6kj for current j, k=0
-      pftmpA12x6kj = *ftmpA12x6 + j;
-
-      // sum matrix products over inner loop over k
-      for (k = 0; k < 12; k++) {
-        if ((*pfC6x12ik != 0.0F) && (*pftmpA12x6kj != 0.0F)) {
-          if (*pfC6x12ik == 1.0F)
-            *pfPPlus12x12ij += *pftmpA12x6kj;
-          else if (*pfC6x12ik == -1.0F)
-            *pfPPlus12x12ij -= *pftmpA12x6kj;
-          else
-            *pfPPlus12x12ij += *pfC6x12ik * *pftmpA12x6kj;
-        }
-
-        // update pfC6x12ik and pftmpA12x6kj for next iteration of k
-        pfC6x12ik++;
-        pftmpA12x6kj += 6;
-      }
-
-      // increment pfPPlus12x12ij for next iteration of j
-      pfPPlus12x12ij++;
-    }
+  if (updateCount < UINT32_MAX) {
+    updateCount++;
   }
 
-  // add in noise covariance terms to the diagonal
-  PPlus12x12[0][0] += QvAA;
-  PPlus12x12[1][1] += QvAA;
-  PPlus12x12[2][2] += QvAA;
-  PPlus12x12[3][3] += QvMM;
-  PPlus12x12[4][4] += QvMM;
-  PPlus12x12[5][5] += QvMM;
-
-  // copy above diagonal elements of P+ (6x6 scratch sub-matrix) to below
-  // diagonal
-  for (i = 1; i < 6; i++)
-    for (j = 0; j < i; j++)
-      PPlus12x12[i][j] = PPlus12x12[j][i];
-
-  // calculate inverse of P+ (6x6 scratch sub-matrix) = inv(C * P- * C^T + Qv) =
-  // inv(C * Qw * C^T + Qv)
-  for (i = 0; i < 6; i++) {
-    pfRows[i] = PPlus12x12[i];
-  }
-  fmatrixAeqInvA(pfRows, iColInd, iRowInd, iPivot, 3);
-
-  // set K = P- * C^T * inv(C * P- * C^T + Qv) = Qw * C^T * inv(C * Qw * C^T +
-  // Qv) = ftmpA12x6 * P+ (6x6 sub-matrix) ftmpA12x6 = Qw * C^T is sparse but P+
-  // (6x6 sub-matrix) is not K is not symmetric because C is not symmetric
-  for (i = 0; i < 12; i++) { // loop over rows of K12x6
-    // initialize pfK12x6ij for current i, j=0
-    pfK12x6ij = K12x6[i];
-
-    for (j = 0; j < 6; j++) { // loop over columns of K12x6
-      // zero the matrix element fK12x6[i][j]
-      *pfK12x6ij = 0.0F;
-
-      // initialize pftmpA12x6ik for current i, k=0
-      pftmpA12x6ik = ftmpA12x6[i];
-
-      // initialize pfPPlus12x12kj for current j, k=0
-      pfPPlus12x12kj = *PPlus12x12 + j;
-
-      // sum matrix products over inner loop over k
-      for (k = 0; k < 6; k++) {
-        if (*pftmpA12x6ik != 0.0F) {
-          *pfK12x6ij += *pftmpA12x6ik * *pfPPlus12x12kj;
-        }
-
-        // increment pftmpA12x6ik and pfPPlus12x12kj for next iteration of k
-        pftmpA12x6ik++;
-        pfPPlus12x12kj += 12;
-      }
-
-      // increment pfK12x6ij for the next iteration of j
-      pfK12x6ij++;
-    }
+  if (iRefreshGain) {
+    NXP_PROFILE_LAP(NXP_STAGE_CORRECTION, tProfile);
+    gainStart_us = fusionMicros();
+    refreshGain();
+    gainRefreshMicros = fusionMicros() - gainStart_us;
+    NXP_PROFILE_RESTART(tProfile);
   }
 
   // *********************************************************************************
   // calculate a posteriori error estimate: xe+ = K * ze-
   // *********************************************************************************
 
+#ifdef AHRS_NXP_6DOF
+  // all three error vector components follow from the accelerometer error
+  for (i = X; i <= Z; i++) {
+    ThErrPl[i] = K9x3[i][0] * gErrSeMi[X] + K9x3[i][1] * gErrSeMi[Y] +
+                 K9x3[i][2] * gErrSeMi[Z];
+    bErrPl[i] = K9x3[i + 3][0] * gErrSeMi[X] + K9x3[i + 3][1] * gErrSeMi[Y] +
+                K9x3[i + 3][2] * gErrSeMi[Z];
+    aErrSePl[i] = K9x3[i + 6][0] * gErrSeMi[X] + K9x3[i + 6][1] * gErrSeMi[Y] +
+                  K9x3[i + 6][2] * gErrSeMi[Z];
+  }
+#else
   // first calculate all four error vector components using accelerometer error
   // component only for fThErrPl, fbErrPl, faErrSePl but also magnetometer for
   // fdErrSePl
@@ -531,9 +491,7 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
   // power after calibration
   ftmp = dErrSePl[X] * dErrSePl[X] + dErrSePl[Y] * dErrSePl[Y] +
          dErrSePl[Z] * dErrSePl[Z];
-  // iMagJamming = (ValidMagCal) && (ftmp > MagCal->FourBsq);
-  iMagJamming = (ValidMagCal) &&
-                (ftmp > (DEFAULTB * DEFAULTB * 4.0f)); // TODO: FourBsq....
+  iMagJamming = (ValidMagCal) && (ftmp > MagFourBsq);
 
   // add the remaining magnetic error terms if there is calibration and no
   // magnetic jamming
@@ -549,6 +507,7 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
                      K12x6[i + 6][5] * mErrSeMi[Z];
     }
   }
+#endif
 
   // *********************************************************************************
   // apply the a posteriori error corrections to the a posteriori state vector
@@ -567,11 +526,13 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
   // non-negative
   fqAeqNormqA(&qPl);
 
-  // compute the a posteriori rotation matrix from the a posteriori quaternion
-  fRotationMatrixFromQuaternion(RPl, &qPl);
-
-  // compute the rotation vector from the a posteriori quaternion
-  fRotationVectorDegFromQuaternion(&qPl, RVecPl);
+  // the rotation matrix, rotation vector, global frame linear acceleration
+  // and angles follow from the a posteriori quaternion and this accelerometer
+  // reading. they are computed when a getter asks for them
+  for (i = X; i <= Z; i++) {
+    aSeLast[i] = Accel[i];
+  }
+  derivedDirty = NXP_DERIVED_ALL;
 
   // update the a posteriori gyro offset vector b+ and
   // assign the entire linear acceleration error vector to update the linear
@@ -583,22 +544,14 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
     aSePl[i] = aSeMi[i] - aErrSePl[i];
   }
 
-  // compute the linear acceleration in the global frame from the accelerometer
-  // measurement (sensor frame). de-rotate the accelerometer measurement from
-  // the sensor to global frame using the inverse (transpose) of the a
-  // posteriori rotation matrix
-  aGlPl[X] = RPl[X][X] * Accel[X] + RPl[Y][X] * Accel[Y] + RPl[Z][X] * Accel[Z];
-  aGlPl[Y] = RPl[X][Y] * Accel[X] + RPl[Y][Y] * Accel[Y] + RPl[Z][Y] * Accel[Z];
-  aGlPl[Z] = RPl[X][Z] * Accel[X] + RPl[Y][Z] * Accel[Y] + RPl[Z][Z] * Accel[Z];
-  // remove gravity and correct the sign if the coordinate system is gravity
-  // positive / acceleration negative gravity positive NED
-  aGlPl[X] = -aGlPl[X];
-  aGlPl[Y] = -aGlPl[Y];
-  aGlPl[Z] = -(aGlPl[Z] - 1.0F);
-
+#ifndef AHRS_NXP_6DOF
   // update the reference geomagnetic vector using magnetic disturbance error if
   // valid calibration and no jamming
   if (ValidMagCal && !iMagJamming) {
+    NXP_PROFILE_LAP(NXP_STAGE_CORRECTION, tProfile);
+    computeDerived(NXP_DERIVED_RPL);
+    NXP_PROFILE_RESTART(tProfile);
+
     // de-rotate the NED magnetic disturbance error de+ from the sensor to the
     // global reference frame using the inverse (transpose) of the a posteriori
     // rotation matrix
@@ -634,152 +587,720 @@ void Adafruit_NXPSensorFusion::update(float gx, float gy, float gz, float ax,
 
       // compute the new geomagnetic vector (always north pointing)
       DeltaPl = fasin_deg(fsindelta);
-      // mGl[X] = MagCal->B * fcosdelta;  // TODO: MagCal->B
-      // mGl[Z] = MagCal->B * fsindelta;
-      mGl[X] = DEFAULTB * fcosdelta; // TODO: MagCal->B
-      mGl[Z] = DEFAULTB * fsindelta;
+      mGl[X] = MagB * fcosdelta;
+      mGl[Z] = MagB * fsindelta;
     } // end hyp == 0.0F
   }   // end ValidMagCal
+#endif
+
+  NXP_PROFILE_LAP(NXP_STAGE_CORRECTION, tProfile);
+}
+
+/**************************************************************************/
+/*!
+ * @brief Updates the filter with a block of samples at the gyroscope rate.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::updateBatch(
+    const Adafruit_AHRS_SampleBlock &block) {
+  uint16_t k;    // sample counter
+  uint16_t n;    // samples in the next predictBlock() call
+  uint16_t last; // index of the sample used for the Kalman update
+
+  if (block.count == 0) {
+    return;
+  }
+  last = block.count - 1;
+
+  // integrate the gyro readings before the last one. predictBlock() takes up
+  // to 255 readings, an even chunk keeps the coning pairs intact
+  for (k = 0; k < last; k += n) {
+    n = last - k;
+    if (n > 254) {
+      n = 254;
+    }
+    predictBlock(&block.gx[k], &block.gy[k], &block.gz[k], (uint8_t)n);
+  }
+
+  // one measurement update with the newest sample
+  update(block.gx[last], block.gy[last], block.gz[last], block.ax[last],
+         block.ay[last], block.az[last], block.mx[last], block.my[last],
+         block.mz[last]);
+}
+
+/**************************************************************************/
+/*!
+ * @brief Seeds the gyro offset estimate and its variance.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::setGyroOffset(float bx, float by, float bz,
+                                             float variance) {
+  int8_t i; // loop counter
+
+  bPl[X] = bx;
+  bPl[Y] = by;
+  bPl[Z] = bz;
+
+  // Qw[b-b-] = variance and Qw[th-b-] = -deltat * Qw[b-b-], the same
+  // structure refreshGain() gives these terms
+  for (i = 0; i < 3; i++) {
+#ifdef AHRS_NXP_6DOF
+    QwUT9x9[symIndex9(i + 3, i + 3)] = variance;
+    QwUT9x9[symIndex9(i, i + 3)] = -deltat * variance;
+#else
+    QwUT12x12[symIndex12(i + 3, i + 3)] = variance;
+    QwUT12x12[symIndex12(i, i + 3)] = -deltat * variance;
+#endif
+  }
+}
+
+/**************************************************************************/
+/*!
+ * @brief Sets the magnetometer calibration state.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::setMagCalibration(bool valid, float B) {
+  MagCalValid = valid && B > 0.0F;
+  if (B <= 0.0F) {
+    return;
+  }
+
+  // keep the inclination of the geomagnetic vector, rescaled to the new field
+  // strength
+  mGl[X] *= B / MagB;
+  mGl[Z] *= B / MagB;
+  MagB = B;
+  MagFourBsq = 4.0F * B * B;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Integrates a high rate gyroscope reading into the a priori
+ * orientation.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::predict(float gx, float gy, float gz) {
+  float Yp[3] = {gx, gy, gz}; // Gyro
+  float rvec[3];              // rotation vector
+  float ftmp;                 // scratch variable
+  int8_t i;                   // loop counter
+  NXP_PROFILE_START(tProfile);
+
+  // initialize the a priori orientation quaternion to the previous a posteriori
+  // estimate on the first reading since the last update
+  if (PredictCount == 0) {
+    qMi = qPl;
+    OmegaSum[X] = OmegaSum[Y] = OmegaSum[Z] = 0.0F;
+  }
+
+  // compute the incremental fast (sensor rate) rotation vector rvec (deg) and
+  // sum the angular velocity for its average over the update. the sum stops
+  // with PredictCount so the average stays the mean of the readings counted
+  for (i = X; i <= Z; i++) {
+    ftmp = Yp[i] - bPl[i];
+    if (PredictCount < UINT16_MAX) {
+      OmegaSum[i] += ftmp;
+    }
+    rvec[i] = ftmp * Fastdeltat;
+  }
+
+  // compute the incremental quaternion fDeltaq from the rotation vector
+  fQuaternionFromRotationVectorDeg(&Deltaq, rvec, 1.0F);
+
+  // incrementally rotate the a priori orientation quaternion fqMi
+  // the a posteriori quaternion fqPl is re-normalized in update() so this is
+  // stable
+  qAeqAxB(&qMi, &Deltaq);
+
+  if (PredictCount < UINT16_MAX) {
+    PredictCount++;
+  }
+
+  NXP_PROFILE_LAP(NXP_STAGE_PREDICT, tProfile);
+}
+
+/**************************************************************************/
+/*!
+ * @brief Integrates a block of high rate gyroscope readings into the a priori
+ * orientation with a single quaternion rotation.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::predictBlock(const float gx[], const float gy[],
+                                            const float gz[], uint8_t n) {
+  float alpha1[3]; // rotation increment of the first reading of a pair (deg)
+  float alpha2[3]; // rotation increment of the second reading of a pair (deg)
+  float phi[3];    // rotation vector of a pair of readings (deg)
+  float Phi[3];    // rotation vector of the block so far (deg)
+  float Sum[3];    // sum of the readings of the block (deg/s)
+  float ftmp;      // scratch variable
+  uint8_t k;       // reading counter
+  int8_t i;        // loop counter
+
+  if (n == 0) {
+    return;
+  }
+  NXP_PROFILE_START(tProfile);
+
+  // initialize the a priori orientation quaternion to the previous a posteriori
+  // estimate on the first reading since the last update
+  if (PredictCount == 0) {
+    qMi = qPl;
+    OmegaSum[X] = OmegaSum[Y] = OmegaSum[Z] = 0.0F;
+  }
+
+  Phi[X] = Phi[Y] = Phi[Z] = 0.0F;
+  Sum[X] = Sum[Y] = Sum[Z] = 0.0F;
+  for (k = 0; k < n; k += 2) {
+    // rotation increments (deg) of the next pair of readings
+    alpha1[X] = gx[k] - bPl[X];
+    alpha1[Y] = gy[k] - bPl[Y];
+    alpha1[Z] = gz[k] - bPl[Z];
+    if (k + 1 < n) {
+      alpha2[X] = gx[k + 1] - bPl[X];
+      alpha2[Y] = gy[k + 1] - bPl[Y];
+      alpha2[Z] = gz[k + 1] - bPl[Z];
+    } else {
+      alpha2[X] = alpha2[Y] = alpha2[Z] = 0.0F;
+    }
+    for (i = X; i <= Z; i++) {
+      Sum[i] += alpha1[i] + alpha2[i];
+      alpha1[i] *= Fastdeltat;
+      alpha2[i] *= Fastdeltat;
+    }
+
+    // two-sample coning correction: phi = alpha1 + alpha2 + 2/3 alpha1 x
+    // alpha2, with the cross product scaled from deg^2 to deg
+    ftmp = TWOOVER3 * FDEGTORAD;
+    phi[X] = alpha1[X] + alpha2[X] +
+             ftmp * (alpha1[Y] * alpha2[Z] - alpha1[Z] * alpha2[Y]);
+    phi[Y] = alpha1[Y] + alpha2[Y] +
+             ftmp * (alpha1[Z] * alpha2[X] - alpha1[X] * alpha2[Z]);
+    phi[Z] = alpha1[Z] + alpha2[Z] +
+             ftmp * (alpha1[X] * alpha2[Y] - alpha1[Y] * alpha2[X]);
+
+    // append the pair to the block: Phi = Phi + phi + 1/2 Phi x phi is the
+    // second order composition of the two rotations
+    ftmp = 0.5F * FDEGTORAD;
+    alpha1[X] = Phi[Y] * phi[Z] - Phi[Z] * phi[Y];
+    alpha1[Y] = Phi[Z] * phi[X] - Phi[X] * phi[Z];
+    alpha1[Z] = Phi[X] * phi[Y] - Phi[Y] * phi[X];
+    for (i = X; i <= Z; i++) {
+      Phi[i] += phi[i] + ftmp * alpha1[i];
+    }
+  }
+
+  // rotate the a priori orientation quaternion once for the whole block
+  fQuaternionFromRotationVectorDeg(&Deltaq, Phi, 1.0F);
+  qAeqAxB(&qMi, &Deltaq);
+
+  // the sum stops with PredictCount so the average stays the mean of the
+  // readings counted
+  if (PredictCount + n <= UINT16_MAX) {
+    PredictCount += n;
+    for (i = X; i <= Z; i++) {
+      OmegaSum[i] += Sum[i];
+    }
+  }
+
+  NXP_PROFILE_LAP(NXP_STAGE_PREDICT, tProfile);
+}
+
+#ifdef AHRS_NXP_6DOF
+/**************************************************************************/
+/*!
+ * @brief Recomputes the Kalman gain from the a priori estimates of the
+ * current update, then the a posteriori covariance P+ and the covariance Qw
+ * for the next gain. 6DOF build with the 9 element error vector.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::refreshGain() {
+  float ftmp;                 // scratch variable
+  float ftmpA6x3[6][3];       // rows 0-5 of Qw * C^T
+  float ftmpB3x3[3][3];       // C * Qw * C^T + Qv
+  float ftmpBinv3x3[3][3];    // inverse of ftmpB3x3
+  float fQwthth, fQwthb;      // orientation terms of Qw
+  float fQwbb;                // gyro offset term of Qw
+  float fQwaa[3];             // linear acceleration terms of Qw
+  int8_t i, j, k;             // loop counters
+
+  // assorted array pointers
+  float *pfPPlusUT9x9ij;
+  float *pfQwUT9x9ij;
+  NXP_PROFILE_START(tProfile);
 
   // *********************************************************************************
-  // compute the a posteriori Euler angles from the orientation matrix
+  // update variable elements of measurement matrix C
   // *********************************************************************************
 
-  // calculate the NED Euler angles
-  fNEDAnglesDegFromRotationMatrix(RPl, &PhiPl, &ThePl, &PsiPl, &RhoPl, &ChiPl);
+  // update measurement matrix C with -alpha(g-)x from gyro (g, sensor frame)
+  C3x6[0][1] = FDEGTORAD * gSeGyMi[Z];
+  C3x6[0][2] = -FDEGTORAD * gSeGyMi[Y];
+  C3x6[1][2] = FDEGTORAD * gSeGyMi[X];
+  C3x6[1][0] = -C3x6[0][1];
+  C3x6[2][0] = -C3x6[0][2];
+  C3x6[2][1] = -C3x6[1][2];
+  C3x6[0][4] = -deltat * C3x6[0][1];
+  C3x6[0][5] = -deltat * C3x6[0][2];
+  C3x6[1][5] = -deltat * C3x6[1][2];
+  C3x6[1][3] = -C3x6[0][4];
+  C3x6[2][3] = -C3x6[0][5];
+  C3x6[2][4] = -C3x6[1][5];
+  NXP_PROFILE_LAP(NXP_STAGE_C, tProfile);
+
+  // *********************************************************************************
+  // calculate the Kalman gain matrix K
+  // K = P- * C^T * inv(C * P- * C^T + Qv) = Qw * C^T * inv(C * Qw * C^T + Qv)
+  // *********************************************************************************
+
+  // set ftmpA = Qw * C^T. as in the 9DOF filter Qw only holds its diagonal
+  // and the theta-b cross terms and the +I block of C in columns 6-8 makes
+  // rows 6-8 of Qw * C^T diagonal, Qw[6+i][6+i] at [6+i][i]
+  for (i = 0; i < 3; i++) {
+    fQwthth = QwUT9x9[symIndex9(i, i)];
+    fQwthb = QwUT9x9[symIndex9(i, i + 3)];
+    fQwbb = QwUT9x9[symIndex9(i + 3, i + 3)];
+    fQwaa[i] = QwUT9x9[symIndex9(i + 6, i + 6)];
+
+    for (j = 0; j < 3; j++) {
+      ftmpA6x3[i][j] = fQwthth * C3x6[j][i] + fQwthb * C3x6[j][i + 3];
+      ftmpA6x3[i + 3][j] = fQwthb * C3x6[j][i] + fQwbb * C3x6[j][i + 3];
+    }
+  }
+
+  // set the upper triangle of symmetric ftmpB3x3 to C * (Qw * C^T) + Qv, the
+  // +I block only adds Qw[6+i][6+i] to the diagonal
+  for (i = 0; i < 3; i++) {
+    for (j = i; j < 3; j++) {
+      ftmp = 0.0F;
+      for (k = 0; k < 6; k++) {
+        ftmp += C3x6[i][k] * ftmpA6x3[k][j];
+      }
+      ftmpB3x3[i][j] = ftmp;
+    }
+    ftmpB3x3[i][i] += fQwaa[i] + QvAA;
+  }
+  NXP_PROFILE_LAP(NXP_STAGE_GAIN, tProfile);
+
+  // invert with the closed form for symmetric 3x3 matrices, which only reads
+  // the upper triangle. the noise variances are small enough for the
+  // determinant to underflow, so invert ftmpB3x3 scaled to unit trace and
+  // apply the same scale to the inverse
+  ftmp = 1.0F / (ftmpB3x3[0][0] + ftmpB3x3[1][1] + ftmpB3x3[2][2]);
+  for (i = 0; i < 3; i++) {
+    for (j = i; j < 3; j++) {
+      ftmpB3x3[i][j] *= ftmp;
+    }
+  }
+  f3x3matrixAeqInvSymB(ftmpBinv3x3, ftmpB3x3);
+  f3x3matrixAeqAxScalar(ftmpBinv3x3, ftmp);
+  NXP_PROFILE_LAP(NXP_STAGE_INVERSE, tProfile);
+
+  // set K = Qw * C^T * inv(C * Qw * C^T + Qv)
+  for (i = 0; i < 6; i++) {
+    for (j = 0; j < 3; j++) {
+      ftmp = 0.0F;
+      for (k = 0; k < 3; k++) {
+        ftmp += ftmpA6x3[i][k] * ftmpBinv3x3[k][j];
+      }
+      K9x3[i][j] = ftmp;
+    }
+  }
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 3; j++) {
+      K9x3[i + 6][j] = fQwaa[i] * ftmpBinv3x3[i][j];
+    }
+  }
+  NXP_PROFILE_LAP(NXP_STAGE_GAIN, tProfile);
 
   // ***********************************************************************************
   // calculate (symmetric) a posteriori error covariance matrix P+
-  // P+ = (I12 - K * C) * P- = (I12 - K * C) * Qw = Qw - K * (C * Qw)
-  // both Qw and P+ are used as working arrays in this section
-  // at the end of this section, P+ is valid but Qw is over-written
+  // P+ = (I9 - K * C) * Qw = Qw - K * (C * Qw), upper triangle only
   // ***********************************************************************************
 
-  // set P+ (6x12 scratch sub-matrix) to the product C (6x12) * Qw (12x12)
-  // where both C and Qw are sparse and C has a significant number of +1 and -1
-  // entries the resulting matrix is sparse but not symmetric
-  for (i = 0; i < 6; i++) {
-    // initialize pfPPlus12x12ij for current i, j=0
-    pfPPlus12x12ij = PPlus12x12[i];
-
-    for (j = 0; j < 12; j++) {
-      // zero P+[i][j]
-      *pfPPlus12x12ij = 0.0F;
-
-      // initialize pfC6x12ik for current i, k=0
-      pfC6x12ik = C6x12[i];
-
-      // initialize pfQw12x12kj for current j, k=0
-      pfQw12x12kj = &Qw12x12[0][j];
-
-      // sum matrix products over inner loop over k
-      for (k = 0; k < 12; k++) {
-        if ((*pfC6x12ik != 0.0F) && (*pfQw12x12kj != 0.0F)) {
-          if (*pfC6x12ik == 1.0F)
-            *pfPPlus12x12ij += *pfQw12x12kj;
-          else if (*pfC6x12ik == -1.0F)
-            *pfPPlus12x12ij -= *pfQw12x12kj;
-          else
-            *pfPPlus12x12ij += *pfC6x12ik * *pfQw12x12kj;
+  // columns 0-5 of C * Qw are rows 0-5 of ftmpA, column 6+j only holds
+  // Qw[6+j][6+j] in row j
+  pfPPlusUT9x9ij = PPlusUT9x9;
+  pfQwUT9x9ij = QwUT9x9;
+  for (i = 0; i < 9; i++) {
+    for (j = i; j < 9; j++) {
+      ftmp = *(pfQwUT9x9ij++);
+      if (j < 6) {
+        for (k = 0; k < 3; k++) {
+          ftmp -= K9x3[i][k] * ftmpA6x3[j][k];
         }
-
-        // update pfC6x12ik and pfQw12x12kj for next iteration of k
-        pfC6x12ik++;
-        pfQw12x12kj += 12;
+      } else {
+        ftmp -= K9x3[i][j - 6] * fQwaa[j - 6];
       }
-
-      // increment pfPPlus12x12ij for next iteration of j
-      pfPPlus12x12ij++;
+      *(pfPPlusUT9x9ij++) = ftmp;
     }
   }
 
-  // compute P+ = (I12 - K * C) * Qw = Qw - K * (C * Qw) = Qw - K * P+ (6x12
-  // sub-matrix) storing result P+ in Qw and over-writing Qw which is OK since
-  // Qw is later computed from P+ where working array P+ (6x12 sub-matrix) is
-  // sparse but K is not sparse only on and above diagonal terms of P+ are
-  // computed since P+ is symmetric
-  for (i = 0; i < 12; i++) {
-    // initialize pfQw12x12ij for current i, j=i
-    pfQw12x12ij = Qw12x12[i] + i;
+  // *********************************************************************************
+  // re-create the noise covariance matrix Qw=fn(P+) for the next iteration
+  // using the diagonal of P+, as in the 9DOF filter without the magnetic terms
+  // *********************************************************************************
 
-    for (j = i; j < 12; j++) {
-      // initialize pfK12x6ik for current i, k=0
-      pfK12x6ik = K12x6[i];
+  for (i = 0; i < SYM9_PACKED_SIZE; i++) {
+    QwUT9x9[i] = 0.0F;
+  }
+
+  for (i = 0; i < 3; i++) {
+    QwUT9x9[symIndex9(i, i)] =
+        PPlusUT9x9[symIndex9(i, i)] +
+        deltatsq * (PPlusUT9x9[symIndex9(i + 3, i + 3)] + QwbplusQvG);
+    QwUT9x9[symIndex9(i + 3, i + 3)] =
+        PPlusUT9x9[symIndex9(i + 3, i + 3)] + FQWB_9DOF_GBY_KALMAN;
+    QwUT9x9[symIndex9(i, i + 3)] = -deltat * QwUT9x9[symIndex9(i + 3, i + 3)];
+    QwUT9x9[symIndex9(i + 6, i + 6)] =
+        casq * PPlusUT9x9[symIndex9(i + 6, i + 6)] + FQWA_9DOF_GBY_KALMAN;
+  }
+  NXP_PROFILE_LAP(NXP_STAGE_COVARIANCE, tProfile);
+}
+#else
+/**************************************************************************/
+/*!
+ * @brief Recomputes the Kalman gain from the a priori estimates of the
+ * current update, then the a posteriori covariance P+ and the covariance Qw
+ * for the next gain.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::refreshGain() {
+  float ftmp;               // scratch variable
+  float ftmpA6x6[6][6];     // rows 0-5 of Qw * C^T
+  float ftmpB6x6[6][6];     // C * Qw * C^T + Qv and its inverse
+  float fQwthth, fQwthb;    // orientation terms of Qw
+  float fQwbb;              // gyro offset term of Qw
+  float fQwaa[3], fQwdd[3]; // linear acceleration and magnetic terms of Qw
+  int8_t i, j, k;           // loop counters
+
+  // assorted array pointers
+  float *pfPPlusUT12x12ij;
+  float *pfQwUT12x12ij;
+
+  // working arrays for 6x6 matrix inversion
+  float *pfRows[6];
+  int8_t iColInd[6];
+  int8_t iRowInd[6];
+  int8_t iPivot[6];
+  NXP_PROFILE_START(tProfile);
+
+  // *********************************************************************************
+  // update variable elements of measurement matrix C
+  // *********************************************************************************
 
-      // initialize pfPPlus12x12kj for current j, k=0
-      pfPPlus12x12kj = *PPlus12x12 + j;
+  // update measurement matrix C with -alpha(g-)x and -alpha(m-)x from gyro (g,
+  // uT, sensor frame)
+  C6x6[0][1] = FDEGTORAD * gSeGyMi[Z];
+  C6x6[0][2] = -FDEGTORAD * gSeGyMi[Y];
+  C6x6[1][2] = FDEGTORAD * gSeGyMi[X];
+  C6x6[1][0] = -C6x6[0][1];
+  C6x6[2][0] = -C6x6[0][2];
+  C6x6[2][1] = -C6x6[1][2];
+  C6x6[3][1] = FDEGTORAD * mSeGyMi[Z];
+  C6x6[3][2] = -FDEGTORAD * mSeGyMi[Y];
+  C6x6[4][2] = FDEGTORAD * mSeGyMi[X];
+  C6x6[4][0] = -C6x6[3][1];
+  C6x6[5][0] = -C6x6[3][2];
+  C6x6[5][1] = -C6x6[4][2];
+  C6x6[0][4] = -deltat * C6x6[0][1];
+  C6x6[0][5] = -deltat * C6x6[0][2];
+  C6x6[1][5] = -deltat * C6x6[1][2];
+  C6x6[1][3] = -C6x6[0][4];
+  C6x6[2][3] = -C6x6[0][5];
+  C6x6[2][4] = -C6x6[1][5];
+  C6x6[3][4] = -deltat * C6x6[3][1];
+  C6x6[3][5] = -deltat * C6x6[3][2];
+  C6x6[4][5] = -deltat * C6x6[4][2];
+  C6x6[4][3] = -C6x6[3][4];
+  C6x6[5][3] = -C6x6[3][5];
+  C6x6[5][4] = -C6x6[4][5];
+  NXP_PROFILE_LAP(NXP_STAGE_C, tProfile);
+
+  // *********************************************************************************
+  // calculate the Kalman gain matrix K
+  // K = P- * C^T * inv(C * P- * C^T + Qv) = Qw * C^T * inv(C * Qw * C^T + Qv)
+  // Qw is used as a proxy for P- throughout the code
+  // P+ is used here as a working array to reduce RAM usage and is re-computed
+  // later
+  // *********************************************************************************
 
-      // compute on and above diagonal matrix entry
+  // set ftmpA = P- * C^T = Qw * C^T using the fixed structure of both.
+  // Qw only ever holds its diagonal and the theta-b cross terms Qw[i][i+3] =
+  // Qw[i+3][i] (see begin() and the end of this function). C holds two
+  // skew-symmetric 3x3 blocks in each of its accelerometer and magnetometer
+  // rows plus +I (rows 0-2, columns 6-8) and -I (rows 3-5, columns 9-11).
+  // rows 6-11 of Qw * C^T are therefore Qw[6+i][6+i] at [6+i][i] and
+  // -Qw[9+i][9+i] at [9+i][3+i] and zero elsewhere, so only rows 0-5 are
+  // stored. every sum below is accumulated from 0.0F in the same order as the
+  // general matrix product so the results are bit-identical to it
+  for (i = 0; i < 3; i++) {
+    fQwthth = QwUT12x12[symIndex12(i, i)];
+    fQwthb = QwUT12x12[symIndex12(i, i + 3)];
+    fQwbb = QwUT12x12[symIndex12(i + 3, i + 3)];
+    fQwaa[i] = QwUT12x12[symIndex12(i + 6, i + 6)];
+    fQwdd[i] = QwUT12x12[symIndex12(i + 9, i + 9)];
+
+    for (j = 0; j < 6; j++) {
+      ftmpA6x6[i][j] = 0.0F + fQwthth * C6x6[j][i] + fQwthb * C6x6[j][i + 3];
+      ftmpA6x6[i + 3][j] =
+          0.0F + fQwthb * C6x6[j][i] + fQwbb * C6x6[j][i + 3];
+    }
+  }
+
+  // set symmetric ftmpB6x6 to C * P- * C^T + Qv
+  // = C * (Qw * C^T) + Qv. the skew blocks of C multiply rows 0-5 of ftmpA
+  // and the +I and -I blocks only add Qw[6+i][6+i] and Qw[9+i][9+i] to the
+  // diagonal
+  for (i = 0; i < 6; i++) {
+    for (j = i; j < 6; j++) {
+      ftmp = 0.0F;
       for (k = 0; k < 6; k++) {
-        // check for non-zero values since P+ (6x12 scratch sub-matrix) is
-        // sparse
-        if (*pfPPlus12x12kj != 0.0F) {
-          *pfQw12x12ij -= *pfK12x6ik * *pfPPlus12x12kj;
-        }
-        // increment pfK12x6ik and pfPPlus12x12kj for next iteration of k
-        pfK12x6ik++;
-        pfPPlus12x12kj += 12;
+        ftmp += C6x6[i][k] * ftmpA6x6[k][j];
       }
-
-      // increment pfQw12x12ij for next iteration of j
-      pfQw12x12ij++;
+      ftmpB6x6[i][j] = ftmp;
     }
+    ftmpB6x6[i][i] += (i < 3) ? fQwaa[i] : fQwdd[i - 3];
   }
 
-  // Qw now holds the on and above diagonal elements of P+
-  // so perform a simple copy to the all elements of P+
-  // after execution of this code P+ is valid but Qw remains invalid
-  for (i = 0; i < 12; i++) {
-    // initialize pfPPlus12x12ij and pfQw12x12ij for current i, j=i
-    pfPPlus12x12ij = PPlus12x12[i] + i;
-    pfQw12x12ij = Qw12x12[i] + i;
+  // add in noise covariance terms to the diagonal
+  ftmpB6x6[0][0] += QvAA;
+  ftmpB6x6[1][1] += QvAA;
+  ftmpB6x6[2][2] += QvAA;
+  ftmpB6x6[3][3] += QvMM;
+  ftmpB6x6[4][4] += QvMM;
+  ftmpB6x6[5][5] += QvMM;
+  NXP_PROFILE_LAP(NXP_STAGE_GAIN, tProfile);
+
+  // copy above diagonal elements of ftmpB6x6 to below diagonal
+  for (i = 1; i < 6; i++)
+    for (j = 0; j < i; j++)
+      ftmpB6x6[i][j] = ftmpB6x6[j][i];
 
-    // copy the on-diagonal elements and increment pointers to enter loop at
-    // j=i+1
-    *(pfPPlus12x12ij++) = *(pfQw12x12ij++);
+  // calculate inverse of ftmpB6x6 = inv(C * P- * C^T + Qv) =
+  // inv(C * Qw * C^T + Qv)
+  for (i = 0; i < 6; i++) {
+    pfRows[i] = ftmpB6x6[i];
+  }
+  fmatrixAeqInvA(pfRows, iColInd, iRowInd, iPivot, 3);
+  NXP_PROFILE_LAP(NXP_STAGE_INVERSE, tProfile);
 
-    // loop over above diagonal columns j copying to below-diagonal elements
-    for (j = i + 1; j < 12; j++) {
-      *(pfPPlus12x12ij++) = PPlus12x12[j][i] = *(pfQw12x12ij++);
+  // set K = P- * C^T * inv(C * P- * C^T + Qv) = ftmpA * ftmpB6x6.
+  // rows 0-5 of ftmpA are dense, rows 6-11 have the single entries above
+  for (i = 0; i < 6; i++) {
+    for (j = 0; j < 6; j++) {
+      ftmp = 0.0F;
+      for (k = 0; k < 6; k++) {
+        ftmp += ftmpA6x6[i][k] * ftmpB6x6[k][j];
+      }
+      K12x6[i][j] = ftmp;
+    }
+  }
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 6; j++) {
+      K12x6[i + 6][j] = 0.0F + fQwaa[i] * ftmpB6x6[i][j];
+      K12x6[i + 9][j] = 0.0F - fQwdd[i] * ftmpB6x6[i + 3][j];
+    }
+  }
+  NXP_PROFILE_LAP(NXP_STAGE_GAIN, tProfile);
+
+  // ***********************************************************************************
+  // calculate (symmetric) a posteriori error covariance matrix P+
+  // P+ = (I12 - K * C) * P- = (I12 - K * C) * Qw = Qw - K * (C * Qw)
+  // only the on and above diagonal terms are stored (packed row by row) so
+  // no copy to the lower triangle is needed
+  // ***********************************************************************************
+
+  // Qw is symmetric so C * Qw = (Qw * C^T)^T: columns 0-5 of C * Qw are rows
+  // 0-5 of ftmpA, column 6+j only holds Qw[6+j][6+j] in row j and column 9+j
+  // only holds -Qw[9+j][9+j] in row 3+j
+  pfPPlusUT12x12ij = PPlusUT12x12;
+  pfQwUT12x12ij = QwUT12x12;
+  for (i = 0; i < 12; i++) {
+    // packed rows run from the diagonal j=i to j=11
+    for (j = i; j < 12; j++) {
+      ftmp = *(pfQwUT12x12ij++);
+      if (j < 6) {
+        for (k = 0; k < 6; k++) {
+          ftmp -= K12x6[i][k] * ftmpA6x6[j][k];
+        }
+      } else if (j < 9) {
+        ftmp -= K12x6[i][j - 6] * fQwaa[j - 6];
+      } else {
+        ftmp += K12x6[i][j - 6] * fQwdd[j - 9];
+      }
+      *(pfPPlusUT12x12ij++) = ftmp;
     }
   }
 
   // *********************************************************************************
   // re-create the noise covariance matrix Qw=fn(P+) for the next iteration
-  // using the elements of P+ which are now valid
-  // Qw was over-written earlier but is here recomputed (all elements)
+  // using the diagonal of P+
   // *********************************************************************************
 
   // zero the matrix Qw
-  for (i = 0; i < 12; i++) {
-    for (j = 0; j < 12; j++) {
-      Qw12x12[i][j] = 0.0F;
-    }
+  for (i = 0; i < SYM12_PACKED_SIZE; i++) {
+    QwUT12x12[i] = 0.0F;
   }
 
   // update the covariance matrix components
   for (i = 0; i < 3; i++) {
     // Qw[th-th-] = Qw[0-2][0-2] = E[th-(th-)^T] = Q[th+th+] + deltat^2 *
     // (Q[b+b+] + (Qwb + QvG) * I)
-    Qw12x12[i][i] =
-        PPlus12x12[i][i] + deltatsq * (PPlus12x12[i + 3][i + 3] + QwbplusQvG);
+    QwUT12x12[symIndex12(i, i)] =
+        PPlusUT12x12[symIndex12(i, i)] +
+        deltatsq * (PPlusUT12x12[symIndex12(i + 3, i + 3)] + QwbplusQvG);
 
     // Qw[b-b-] = Qw[3-5][3-5] = E[b-(b-)^T] = Q[b+b+] + Qwb * I
-    Qw12x12[i + 3][i + 3] = PPlus12x12[i + 3][i + 3] + FQWB_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 3, i + 3)] =
+        PPlusUT12x12[symIndex12(i + 3, i + 3)] + FQWB_9DOF_GBY_KALMAN;
 
     // Qw[th-b-] = Qw[0-2][3-5] = E[th-(b-)^T] = -deltat * (Q[b+b+] + Qwb * I) =
     // -deltat * Qw[b-b-]
-    Qw12x12[i][i + 3] = Qw12x12[i + 3][i] = -deltat * Qw12x12[i + 3][i + 3];
+    QwUT12x12[symIndex12(i, i + 3)] =
+        -deltat * QwUT12x12[symIndex12(i + 3, i + 3)];
 
     // Qw[a-a-] = Qw[6-8][6-8] = E[a-(a-)^T] = ca^2 * Q[a+a+] + Qwa * I
-    Qw12x12[i + 6][i + 6] =
-        casq * PPlus12x12[i + 6][i + 6] + FQWA_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 6, i + 6)] =
+        casq * PPlusUT12x12[symIndex12(i + 6, i + 6)] + FQWA_9DOF_GBY_KALMAN;
 
     // Qw[d-d-] = Qw[9-11][9-11] = E[d-(d-)^T] = cd^2 * Q[d+d+] + Qwd * I
-    Qw12x12[i + 9][i + 9] =
-        cdsq * PPlus12x12[i + 9][i + 9] + FQWD_9DOF_GBY_KALMAN;
+    QwUT12x12[symIndex12(i + 9, i + 9)] =
+        cdsq * PPlusUT12x12[symIndex12(i + 9, i + 9)] + FQWD_9DOF_GBY_KALMAN;
+  }
+  NXP_PROFILE_LAP(NXP_STAGE_COVARIANCE, tProfile);
+}
+#endif
+
+/**************************************************************************/
+/*!
+ * @brief Computes derived outputs of the last update from the a posteriori
+ * quaternion.
+ *
+ * @param mask The NXP_DERIVED_* outputs to compute.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::refreshDerived(uint8_t mask) {
+  NXP_PROFILE_START(tProfile);
+
+  // the linear acceleration and the angles are taken from the rotation matrix
+  if (mask & (NXP_DERIVED_AGL | NXP_DERIVED_ANGLES)) {
+    mask |= derivedDirty & NXP_DERIVED_RPL;
+  }
+
+  // compute the a posteriori rotation matrix from the a posteriori quaternion
+  if (mask & NXP_DERIVED_RPL) {
+    fRotationMatrixFromQuaternion(RPl, &qPl);
+  }
+
+  // compute the rotation vector from the a posteriori quaternion
+  if (mask & NXP_DERIVED_RVEC) {
+    fRotationVectorDegFromQuaternion(&qPl, RVecPl);
+  }
+
+  if (mask & NXP_DERIVED_AGL) {
+    // compute the linear acceleration in the global frame from the
+    // accelerometer measurement (sensor frame). de-rotate the accelerometer
+    // measurement from the sensor to global frame using the inverse
+    // (transpose) of the a posteriori rotation matrix
+    aGlPl[X] = RPl[X][X] * aSeLast[X] + RPl[Y][X] * aSeLast[Y] +
+               RPl[Z][X] * aSeLast[Z];
+    aGlPl[Y] = RPl[X][Y] * aSeLast[X] + RPl[Y][Y] * aSeLast[Y] +
+               RPl[Z][Y] * aSeLast[Z];
+    aGlPl[Z] = RPl[X][Z] * aSeLast[X] + RPl[Y][Z] * aSeLast[Y] +
+               RPl[Z][Z] * aSeLast[Z];
+    // remove gravity and correct the sign if the coordinate system is gravity
+    // positive / acceleration negative gravity positive NED
+    aGlPl[X] = -aGlPl[X];
+    aGlPl[Y] = -aGlPl[Y];
+    aGlPl[Z] = -(aGlPl[Z] - 1.0F);
+  }
+
+  // calculate the NED Euler angles
+  if (mask & NXP_DERIVED_ANGLES) {
+    fNEDAnglesDegFromRotationMatrix(RPl, &PhiPl, &ThePl, &PsiPl, &RhoPl,
+                                    &ChiPl);
+  }
+
+  derivedDirty &= ~mask;
+  NXP_PROFILE_LAP(NXP_STAGE_DERIVED, tProfile);
+}
+
+#ifdef AHRS_NXP_PROFILE
+/**************************************************************************/
+/*!
+ * @brief Get the timing of a stage of the filter.
+ */
+/**************************************************************************/
+uint32_t Adafruit_NXPSensorFusion::getStageProfile(uint8_t stage,
+                                                   uint32_t *min,
+                                                   uint32_t *mean,
+                                                   uint32_t *max) const {
+  if (stage >= NXP_STAGE_COUNT || stageCount[stage] == 0) {
+    *min = *mean = *max = 0;
+    return 0;
+  }
+  *min = stageMin[stage];
+  *mean = (uint32_t)(stageSum[stage] / stageCount[stage]);
+  *max = stageMax[stage];
+  return stageCount[stage];
+}
+
+/**************************************************************************/
+/*!
+ * @brief Clears the timings of the completed cycles. The current cycle is
+ * kept and counted once it closes.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::resetProfile() {
+  uint8_t i; // stage counter
+
+  for (i = 0; i < NXP_STAGE_COUNT; i++) {
+    stageMin[i] = UINT32_MAX;
+    stageMax[i] = 0;
+    stageSum[i] = 0;
+    stageCount[i] = 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+ * @brief Adds the ticks since start to the current cycle of a stage.
+ */
+/**************************************************************************/
+uint32_t Adafruit_NXPSensorFusion::profileLap(uint8_t stage, uint32_t start) {
+  uint32_t now = fusionTicks();
+
+  stagePending[stage] += now - start;
+  stagePendingMask |= 1 << stage;
+  return now;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Folds the stages that ran in the current cycle into their min, sum
+ * and max.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusion::closeProfileCycle() {
+  uint8_t i; // stage counter
+
+  for (i = 0; i < NXP_STAGE_COUNT; i++) {
+    if (!(stagePendingMask & (1 << i))) {
+      continue;
+    }
+    if (stagePending[i] < stageMin[i]) {
+      stageMin[i] = stagePending[i];
+    }
+    if (stagePending[i] > stageMax[i]) {
+      stageMax[i] = stagePending[i];
+    }
+    stageSum[i] += stagePending[i];
+    stageCount[i]++;
+    stagePending[i] = 0;
   }
+  stagePendingMask = 0;
 }
+#endif
 
 // compile time constants that are private to this file
 #define SMALLQ0                                                                \
@@ -871,8 +1392,8 @@ void f3DOFMagnetometerMatrixNED(float fR[][3], float fBc[]) {
 }
 
 // NED: 6DOF e-Compass function computing rotation matrix fR
-static void feCompassNED(float fR[][3], float *pfDelta, const float fBc[],
-                         const float fGp[]) {
+void feCompassNED(float fR[][3], float *pfDelta, const float fBc[],
+                  const float fGp[]) {
   // local variables
   float fmod[3]; // column moduli
   float fmodBc;  // modulus of Bc
@@ -1041,7 +1562,7 @@ static void fQuaternionFromRotationVectorDeg(Quaternion_t *pq,
 }
 
 // compute the orientation quaternion from a 3x3 rotation matrix
-static void fQuaternionFromRotationMatrix(float R[][3], Quaternion_t *pq) {
+void fQuaternionFromRotationMatrix(float R[][3], Quaternion_t *pq) {
   float fq0sq;    // q0^2
   float recip4q0; // 1/4q0
 
@@ -1373,131 +1894,3 @@ static void fqAeq1(Quaternion_t *pqA) {
   pqA->q0 = 1.0F;
   pqA->q1 = pqA->q2 = pqA->q3 = 0.0F;
 }
-
-// function returns an approximation to angle(deg)=asin(x) for x in the range -1
-// <= x <= 1 and returns -90 <= angle <= 90 deg maximum error is 10.29E-6 deg
-static float fasin_deg(float x) {
-  // for robustness, check for invalid argument
-  if (x >= 1.0F)
-    return 90.0F;
-  if (x <= -1.0F)
-    return -90.0F;
-
-  // call the atan which will return an angle in the correct range -90 to 90 deg
-  // this line cannot fail from division by zero or negative square root since
-  // |x| < 1
-  return (fatan_deg(x / sqrtf(1.0F - x * x)));
-}
-
-// function returns an approximation to angle(deg)=acos(x) for x in the range -1
-// <= x <= 1 and returns 0 <= angle <= 180 deg maximum error is 14.67E-6 deg
-static float facos_deg(float x) {
-  // for robustness, check for invalid arguments
-  if (x >= 1.0F)
-    return 0.0F;
-  if (x <= -1.0F)
-    return 180.0F;
-
-  // call the atan which will return an angle in the incorrect range -90 to 90
-  // deg these lines cannot fail from division by zero or negative square root
-  if (x == 0.0F)
-    return 90.0F;
-  if (x > 0.0F)
-    return fatan_deg((sqrtf(1.0F - x * x) / x));
-  return 180.0F + fatan_deg((sqrtf(1.0F - x * x) / x));
-}
-
-// function returns angle in range -90 to 90 deg
-// maximum error is 9.84E-6 deg
-static float fatan_deg(float x) {
-  float fangledeg;     // compute computed (deg)
-  int8_t ixisnegative; // argument x is negative
-  int8_t ixexceeds1;   // argument x is greater than 1.0
-  int8_t ixmapped;     // argument in range tan(15 deg) to tan(45 deg)=1.0
-
-#define TAN15DEG 0.26794919243F // tan(15 deg) = 2 - sqrt(3)
-#define TAN30DEG 0.57735026919F // tan(30 deg) = 1/sqrt(3)
-
-  // reset all flags
-  ixisnegative = ixexceeds1 = ixmapped = 0;
-
-  // test for negative argument to allow use of tan(-x)=-tan(x)
-  if (x < 0.0F) {
-    x = -x;
-    ixisnegative = 1;
-  }
-
-  // test for argument above 1 to allow use of atan(x)=pi/2-atan(1/x)
-  if (x > 1.0F) {
-    x = 1.0F / x;
-    ixexceeds1 = 1;
-  }
-
-  // at this point, x is in the range 0 to 1 inclusive
-  // map argument onto range -tan(15 deg) to tan(15 deg)
-  // using tan(angle-30deg) = (tan(angle)-tan(30deg)) / (1 +
-  // tan(angle)tan(30deg)) tan(15deg) maps to tan(-15 deg) = -tan(15 deg)
-  // 1. maps to (sqrt(3) - 1) / (sqrt(3) + 1) = 2 - sqrt(3) = tan(15 deg)
-  if (x > TAN15DEG) {
-    x = (x - TAN30DEG) / (1.0F + TAN30DEG * x);
-    ixmapped = 1;
-  }
-
-  // call the atan estimator to obtain -15 deg <= angle <= 15 deg
-  fangledeg = fatan_15deg(x);
-
-  // undo the distortions applied earlier to obtain -90 deg <= angle <= 90 deg
-  if (ixmapped)
-    fangledeg += 30.0F;
-  if (ixexceeds1)
-    fangledeg = 90.0F - fangledeg;
-  if (ixisnegative)
-    fangledeg = -fangledeg;
-
-  return (fangledeg);
-}
-
-// function returns approximate atan2 angle in range -180 to 180 deg
-// maximum error is 14.58E-6 deg
-static float fatan2_deg(float y, float x) {
-  // check for zero x to avoid division by zero
-  if (x == 0.0F) {
-    // return 90 deg for positive y
-    if (y > 0.0F)
-      return 90.0F;
-    // return -90 deg for negative y
-    if (y < 0.0F)
-      return -90.0F;
-    // otherwise y= 0.0 and return 0 deg (invalid arguments)
-    return 0.0F;
-  }
-
-  // from here onwards, x is guaranteed to be non-zero
-  // compute atan2 for quadrant 1 (0 to 90 deg) and quadrant 4 (-90 to 0 deg)
-  if (x > 0.0F)
-    return (fatan_deg(y / x));
-  // compute atan2 for quadrant 2 (90 to 180 deg)
-  if ((x < 0.0F) && (y > 0.0F))
-    return (180.0F + fatan_deg(y / x));
-  // compute atan2 for quadrant 3 (-180 to -90 deg)
-  return (-180.0F + fatan_deg(y / x));
-}
-
-// approximation to inverse tan function (deg) for x in range
-// -tan(15 deg) to tan(15 deg) giving an output -15 deg <= angle <= 15 deg
-// using modified Pade[3/2] approximation
-static float fatan_15deg(float x) {
-  float x2; // x^2
-
-#define PADE_A                                                                 \
-  96.644395816F // theoretical Pade[3/2] value is 5/3*180/PI=95.49296
-#define PADE_B                                                                 \
-  25.086941612F // theoretical Pade[3/2] value is 4/9*180/PI=25.46479
-#define PADE_C 1.6867633134F // theoretical Pade[3/2] value is 5/3=1.66667
-
-  // compute the approximation to the inverse tangent
-  // the function is anti-symmetric as required for positive and negative
-  // arguments
-  x2 = x * x;
-  return (x * (PADE_A + x2 * PADE_B) / (PADE_C + x2));
-}
@@ -0,0 +1,796 @@
+/*!
+ * @file Adafruit_AHRS_NXPFusionQ.cpp
+ *
+ * @section license License
+ *
+ * Copyright (c) 2014, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Freescale Semiconductor, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL FREESCALE SEMICONDUCTOR, INC. BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This is the fixed-point build of the fusion routines in
+ * Adafruit_AHRS_NXPFusion.cpp. The filter equations are the same; the
+ * comments here only cover what changes in fixed point.
+ */
+
+#include "Adafruit_AHRS_NXPFusionQ.h"
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "Adafruit_AHRS_NXPFusionTuning.h"
+
+#define X 0 // vector components
+#define Y 1
+#define Z 2
+#define FDEGTORAD 0.01745329251994F // degrees to radians conversion = pi / 180
+
+// fixed-point constants
+#define ONE_Q30 (1L << 30)                   // 1.0 in Q30
+#define ONE_G_Q26 (1L << NXPQ_ACCEL_FRAC)    // 1 g in the accelerometer format
+#define DEG90_Q16 (90L << NXPQ_ANGLE_FRAC)   // 90 deg in the angle format
+#define DEG180_Q16 (180L << NXPQ_ANGLE_FRAC) // 180 deg in the angle format
+#define DEG360_Q16 (360L << NXPQ_ANGLE_FRAC) // 360 deg in the angle format
+#define RADTODEG_Q24 961263669L // radians to degrees conversion = 180 / pi
+#define MAXETA2_Q30 0x7FFFFFFFL // largest rotation angle^2 per step, 2 rad^2
+
+typedef Adafruit_NXPSensorFusionQ::Quaternion_t iQuaternion_t;
+typedef Adafruit_NXPSensorFusion::Quaternion_t fQuaternion_t;
+
+// float helpers shared with Adafruit_AHRS_NXPFusion.cpp for the once-only
+// orientation lock
+void f3DOFTiltNED(float fR[][3], float fGp[]);
+void feCompassNED(float fR[][3], float *pfDelta, const float fBc[],
+                  const float fGp[]);
+void fQuaternionFromRotationMatrix(float R[][3], fQuaternion_t *pq);
+
+static int32_t iQFromFloat(float x, float fscale);
+static uint32_t iSqrt64(uint64_t x);
+static int32_t iatan_01_deg(int32_t t);
+static int32_t iatan2_deg(int32_t y, int32_t x);
+static int32_t iasin_deg(int32_t x);
+static int32_t iacos_deg(int32_t x);
+static void iqAeq1(iQuaternion_t *pqA);
+static void iqAeqBxC(iQuaternion_t *pqA, const iQuaternion_t *pqB,
+                     const iQuaternion_t *pqC);
+static void iqAeqNormqA(iQuaternion_t *pqA);
+static void iQuaternionFromRotationVectorRad(iQuaternion_t *pq,
+                                             const int32_t rvec[]);
+static void iRotationMatrixFromQuaternion(int32_t R[][3],
+                                          const iQuaternion_t *pq);
+static void iNEDAnglesDegFromRotationMatrix(int32_t R[][3], int32_t *piPhiDeg,
+                                            int32_t *piTheDeg,
+                                            int32_t *piPsiDeg,
+                                            int32_t *piRhoDeg,
+                                            int32_t *piChiDeg);
+
+extern "C" {
+void fmatrixAeqInvA(float *A[], int8_t iColInd[], int8_t iRowInd[],
+                    int8_t iPivot[], int8_t isize);
+}
+
+/**************************************************************************/
+/*!
+ * @brief Initializes the 9DOF Kalman filter.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusionQ::begin(float sampleFrequency) {
+  int8_t i;
+
+  // reset the flag denoting that a first 9DOF orientation lock has been
+  // achieved
+  FirstOrientationLock = 0;
+  FirstTiltLock = 0;
+
+  // compute and store useful product terms
+  deltat = 1.0f / sampleFrequency;
+  deltatsq = deltat * deltat;
+  FastdtRad = iQFromFloat(deltat * FDEGTORAD, 68719476736.0F); // Q36
+  casq = FCA_9DOF_GBY_KALMAN * FCA_9DOF_GBY_KALMAN;
+  cdsq = FCD_9DOF_GBY_KALMAN * FCD_9DOF_GBY_KALMAN;
+  ca = iQFromFloat(FCA_9DOF_GBY_KALMAN, (float)ONE_Q30);
+  QwbplusQvG = FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN;
+
+  // zero a posteriori orientation, b+ and the linear acceleration
+  iqAeq1(&qPl);
+  iRotationMatrixFromQuaternion(RPl, &qPl);
+  for (i = X; i <= Z; i++) {
+    bPl[i] = aSePl[i] = aGlPl[i] = 0;
+  }
+
+  // initialize the reference geomagnetic vector (uT, global frame) to zero
+  // degrees inclination
+  DeltaPl = 0;
+  mGl[X] = iQFromFloat(DEFAULTB, (float)(1L << NXPQ_MAG_FRAC));
+  mGl[Y] = 0;
+  mGl[Z] = 0;
+
+  // the magnetometer is ignored until setMagCalibration()
+  MagCalValid = 0;
+  MagB = DEFAULTB;
+  MagFourBsq = 4.0F * DEFAULTB * DEFAULTB;
+
+  // initialize noise variances for Qv and Qw matrix updates
+  QvAA = FQVA_9DOF_GBY_KALMAN + FQWA_9DOF_GBY_KALMAN +
+         FDEGTORAD * FDEGTORAD * deltatsq *
+             (FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN);
+  QvMM = FQVM_9DOF_GBY_KALMAN + FQWD_9DOF_GBY_KALMAN +
+         FDEGTORAD * FDEGTORAD * deltatsq * DEFAULTB * DEFAULTB *
+             (FQWB_9DOF_GBY_KALMAN + FQVG_9DOF_GBY_KALMAN);
+
+  // initialize the non-zero terms of the covariance matrix Qw
+  for (i = 0; i < 3; i++) {
+    QwThTh[i] = FQWINITTHTH_9DOF_GBY_KALMAN;
+    QwBB[i] = FQWINITBB_9DOF_GBY_KALMAN;
+    QwThB[i] = FQWINITTHB_9DOF_GBY_KALMAN;
+    QwAA[i] = FQWINITAA_9DOF_GBY_KALMAN;
+    QwDD[i] = FQWINITDD_9DOF_GBY_KALMAN;
+  }
+
+  // clear the reset flag
+  resetflag = 0;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Seeds the gyro offset estimate and its variance.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusionQ::setGyroOffset(float bx, float by, float bz,
+                                              float variance) {
+  int8_t i;
+
+  bPl[X] = iQFromFloat(bx, (float)(1L << NXPQ_GYRO_FRAC));
+  bPl[Y] = iQFromFloat(by, (float)(1L << NXPQ_GYRO_FRAC));
+  bPl[Z] = iQFromFloat(bz, (float)(1L << NXPQ_GYRO_FRAC));
+
+  // the same structure the covariance update gives these terms
+  for (i = 0; i < 3; i++) {
+    QwBB[i] = variance;
+    QwThB[i] = -deltat * variance;
+  }
+}
+
+/**************************************************************************/
+/*!
+ * @brief Sets the magnetometer calibration state.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusionQ::setMagCalibration(bool valid, float B) {
+  MagCalValid = valid && B > 0.0F;
+  if (B <= 0.0F) {
+    return;
+  }
+
+  // keep the inclination of the geomagnetic vector, rescaled to the new field
+  // strength
+  mGl[X] = iQFromFloat((float)mGl[X] * (B / MagB), 1.0F);
+  mGl[Z] = iQFromFloat((float)mGl[Z] * (B / MagB), 1.0F);
+  MagB = B;
+  MagFourBsq = 4.0F * B * B;
+}
+
+/**************************************************************************/
+/*!
+ * @brief Updates the filter with new gyroscope, accelerometer, and magnetometer
+ * data.
+ */
+/**************************************************************************/
+void Adafruit_NXPSensorFusionQ::update(float gx, float gy, float gz, float ax,
+                                       float ay, float az, float mx, float my,
+                                       float mz) {
+  float fAccel[3] = {ax, ay, az};
+  float fMag[3] = {mx, my, mz};
+  int32_t Accel[3]; // accelerometer (g, Q26)
+  int32_t Yp[3];    // gyro (deg/s, Q20)
+  int32_t Mag[3];   // magnetometer (uT, Q22)
+
+  // local scalars and arrays
+  int32_t rvec[3];    // rotation vector (rad, Q30)
+  int32_t dErrSe[3];  // magnetic disturbance error (uT, sensor frame, Q22)
+  int32_t dErrGl[3];  // magnetic disturbance error (uT, global frame, Q22)
+  int32_t fopp, fadj; // opposite and adjacent (uT, Q22)
+  uint32_t fhyp;      // hypoteneuse (uT, Q22)
+  int32_t isindelta, icosdelta; // sin and cos of inclination angle (Q30)
+  float fRPl[3][3];   // float orientation matrix for the orientation lock
+  fQuaternion_t fqPl; // float orientation quaternion for the orientation lock
+  int8_t i, j;        // loop counters
+  int8_t iMagJamming; // magnetic jamming flag
+  int8_t ValidMagCal;
+
+  // float working terms of the Kalman gain
+  float fg[3], fm[3];   // gravity (g) and geomagnetic (uT) vectors from gyro
+  float fe[6];          // gravity (g) and geomagnetic (uT) errors
+  float fA[6][3];       // columns 0-2 of the measurement matrix C
+  float fS6x6[6][6];    // C * Qw * C^T + Qv, top left 3x3 inverted
+  float *pfRows[6];     // pointers to the rows of fS6x6
+  int8_t iColInd[6];    // workspace for the matrix inversion
+  int8_t iRowInd[6];
+  int8_t iPivot[6];
+  float fW3x6[3][6];    // fA^T * fS6x6
+  float falpha[3];      // Qw[th][th] - deltat * Qw[th][b]
+  float fbeta[3];       // Qw[th][b] - deltat * Qw[b][b]
+  float fgamma[3];      // falpha - deltat * fbeta
+  float fh[3];          // diagonal of fA^T * fS6x6 * fA
+  float fu[3], fv[3];   // accelerometer and magnetometer terms of fW3x6 * fe
+  float fThErr[3];      // orientation error (deg)
+  float fbErr[3];       // gyro offset error (deg/s)
+  float faErr[3];       // linear acceleration error (g, sensor frame)
+  float faErrM[3];      // magnetometer term of faErr
+  float fdErr[3];       // magnetic disturbance error (uT, sensor frame)
+  float fPPlus;         // diagonal term of P+
+  float ftmp;           // scratch variable
+
+  // do a reset and return if requested
+  if (resetflag) {
+    begin(1.0f / deltat);
+    return;
+  }
+
+  // convert the readings to fixed point
+  Yp[X] = iQFromFloat(gx, (float)(1L << NXPQ_GYRO_FRAC));
+  Yp[Y] = iQFromFloat(gy, (float)(1L << NXPQ_GYRO_FRAC));
+  Yp[Z] = iQFromFloat(gz, (float)(1L << NXPQ_GYRO_FRAC));
+  for (i = X; i <= Z; i++) {
+    Accel[i] = iQFromFloat(fAccel[i], (float)(1L << NXPQ_ACCEL_FRAC));
+    Mag[i] = iQFromFloat(fMag[i], (float)(1L << NXPQ_MAG_FRAC));
+  }
+
+  // *********************************************************************************
+  // initial orientation lock to accelerometer and magnetometer eCompass
+  // orientation. this runs once so stays in float
+  // *********************************************************************************
+  ValidMagCal = MagCalValid;
+
+  if ((ValidMagCal && !FirstOrientationLock) ||
+      (!ValidMagCal && !FirstOrientationLock && !FirstTiltLock)) {
+    if (ValidMagCal) {
+      feCompassNED(fRPl, &ftmp, fMag, fAccel);
+      DeltaPl = iQFromFloat(ftmp, (float)(1L << NXPQ_ANGLE_FRAC));
+      FirstOrientationLock = 1;
+    } else {
+      f3DOFTiltNED(fRPl, fAccel);
+      FirstTiltLock = 1;
+    }
+    fQuaternionFromRotationMatrix(fRPl, &fqPl);
+    qPl.q0 = iQFromFloat(fqPl.q0, (float)ONE_Q30);
+    qPl.q1 = iQFromFloat(fqPl.q1, (float)ONE_Q30);
+    qPl.q2 = iQFromFloat(fqPl.q2, (float)ONE_Q30);
+    qPl.q3 = iQFromFloat(fqPl.q3, (float)ONE_Q30);
+  }
+
+  // *********************************************************************************
+  // calculate a priori rotation matrix
+  // *********************************************************************************
+
+  // compute the angular velocity and the incremental rotation vector (rad,
+  // Q30) = omega (deg/s, Q20) * deltat * pi / 180 (Q36)
+  for (i = X; i <= Z; i++) {
+    Omega[i] = Yp[i] - bPl[i];
+    rvec[i] = (int32_t)(((int64_t)Omega[i] * FastdtRad) >>
+                        (NXPQ_GYRO_FRAC + 36 - NXPQ_UNIT_FRAC));
+  }
+
+  // rotate the a posteriori quaternion by the incremental quaternion
+  iQuaternionFromRotationVectorRad(&Deltaq, rvec);
+  iqAeqBxC(&qMi, &qPl, &Deltaq);
+  iRotationMatrixFromQuaternion(RMi, &qMi);
+
+  // *********************************************************************************
+  // calculate a priori gyro, accelerometer and magnetometer estimates
+  // of the gravity and geomagnetic vectors and errors
+  // *********************************************************************************
+
+  for (i = X; i <= Z; i++) {
+    gSeGyMi[i] = RMi[i][Z];
+    aSeMi[i] = (int32_t)(((int64_t)ca * aSePl[i]) >> 30);
+    gErrSeMi[i] = Accel[i] + aSeMi[i] -
+                  (gSeGyMi[i] >> (NXPQ_UNIT_FRAC - NXPQ_ACCEL_FRAC));
+    mSeGyMi[i] = (int32_t)(((int64_t)RMi[i][X] * mGl[X] +
+                            (int64_t)RMi[i][Z] * mGl[Z]) >>
+                           30);
+    mErrSeMi[i] = Mag[i] - mSeGyMi[i];
+  }
+
+  // *********************************************************************************
+  // calculate the Kalman gain and the a posteriori error estimate
+  //
+  // Qw only holds its diagonal and the th-b cross terms and C is
+  // [A, -deltat * A, I, 0; ...] with A the two skew blocks built from the
+  // gravity and geomagnetic vectors. with that structure
+  //   C * Qw * C^T + Qv = A * diag(gamma) * A^T + diag(Qw[a][a], Qw[d][d]) + Qv
+  //   K[th] = alpha * A^T * inv, K[b] = beta * A^T * inv
+  //   K[a] = Qw[a][a] * inv[0-2], K[d] = -Qw[d][d] * inv[3-5]
+  // where inv is C * Qw * C^T + Qv with only its top left 3x3 inverted, as in
+  // the float filter. only the diagonal of P+ is needed to rebuild Qw
+  // *********************************************************************************
+
+  for (i = X; i <= Z; i++) {
+    fg[i] = (float)gSeGyMi[i] * (FDEGTORAD / ONE_Q30);
+    fm[i] = (float)mSeGyMi[i] * (FDEGTORAD / (1L << NXPQ_MAG_FRAC));
+    fe[i] = (float)gErrSeMi[i] * (1.0F / ONE_G_Q26);
+    fe[i + 3] = (float)mErrSeMi[i] * (1.0F / (1L << NXPQ_MAG_FRAC));
+    falpha[i] = QwThTh[i] - deltat * QwThB[i];
+    fbeta[i] = QwThB[i] - deltat * QwBB[i];
+    fgamma[i] = falpha[i] - deltat * fbeta[i];
+  }
+
+  // A = -alpha(g-)x and -alpha(m-)x
+  fA[0][0] = fA[1][1] = fA[2][2] = 0.0F;
+  fA[0][1] = fg[Z];
+  fA[0][2] = -fg[Y];
+  fA[1][2] = fg[X];
+  fA[1][0] = -fA[0][1];
+  fA[2][0] = -fA[0][2];
+  fA[2][1] = -fA[1][2];
+  fA[3][0] = fA[4][1] = fA[5][2] = 0.0F;
+  fA[3][1] = fm[Z];
+  fA[3][2] = -fm[Y];
+  fA[4][2] = fm[X];
+  fA[4][0] = -fA[3][1];
+  fA[5][0] = -fA[3][2];
+  fA[5][1] = -fA[4][2];
+
+  // fS6x6 = A * diag(gamma) * A^T + diag(Qw[a][a], Qw[d][d]) + Qv
+  for (i = 0; i < 6; i++) {
+    for (j = i; j < 6; j++) {
+      fS6x6[i][j] = fS6x6[j][i] = fA[i][X] * fA[j][X] * fgamma[X] +
+                                  fA[i][Y] * fA[j][Y] * fgamma[Y] +
+                                  fA[i][Z] * fA[j][Z] * fgamma[Z];
+    }
+  }
+  for (i = X; i <= Z; i++) {
+    fS6x6[i][i] += QwAA[i] + QvAA;
+    fS6x6[i + 3][i + 3] += QwDD[i] + QvMM;
+  }
+
+  // invert the top left 3x3 in place with the same routine as the float
+  // filter. the accelerometer block is close to singular along gravity with
+  // the legacy tuning so a different inversion would not track it
+  for (i = 0; i < 6; i++) {
+    pfRows[i] = fS6x6[i];
+  }
+  fmatrixAeqInvA(pfRows, iColInd, iRowInd, iPivot, 3);
+
+  // fW3x6 = A^T * fS6x6 and its products with A and the errors
+  for (i = X; i <= Z; i++) {
+    for (j = 0; j < 6; j++) {
+      fW3x6[i][j] = fA[0][i] * fS6x6[0][j] + fA[1][i] * fS6x6[1][j] +
+                    fA[2][i] * fS6x6[2][j] + fA[3][i] * fS6x6[3][j] +
+                    fA[4][i] * fS6x6[4][j] + fA[5][i] * fS6x6[5][j];
+    }
+    fh[i] = fW3x6[i][0] * fA[0][i] + fW3x6[i][1] * fA[1][i] +
+            fW3x6[i][2] * fA[2][i] + fW3x6[i][3] * fA[3][i] +
+            fW3x6[i][4] * fA[4][i] + fW3x6[i][5] * fA[5][i];
+    fu[i] = fW3x6[i][0] * fe[0] + fW3x6[i][1] * fe[1] + fW3x6[i][2] * fe[2];
+    fv[i] = fW3x6[i][3] * fe[3] + fW3x6[i][4] * fe[4] + fW3x6[i][5] * fe[5];
+    faErr[i] = QwAA[i] * (fS6x6[i][0] * fe[0] + fS6x6[i][1] * fe[1] +
+                          fS6x6[i][2] * fe[2]);
+    faErrM[i] = QwAA[i] * (fS6x6[i][3] * fe[3] + fS6x6[i][4] * fe[4] +
+                           fS6x6[i][5] * fe[5]);
+    fdErr[i] =
+        -QwDD[i] * (fS6x6[i + 3][0] * fe[0] + fS6x6[i + 3][1] * fe[1] +
+                    fS6x6[i + 3][2] * fe[2] + fS6x6[i + 3][3] * fe[3] +
+                    fS6x6[i + 3][4] * fe[4] + fS6x6[i + 3][5] * fe[5]);
+  }
+
+  // set the magnetic jamming flag if there is a significant magnetic error
+  // power after calibration
+  ftmp = fdErr[X] * fdErr[X] + fdErr[Y] * fdErr[Y] + fdErr[Z] * fdErr[Z];
+  iMagJamming = (ValidMagCal) && (ftmp > MagFourBsq);
+
+  // add the remaining magnetic error terms if there is calibration and no
+  // magnetic jamming
+  for (i = X; i <= Z; i++) {
+    if (ValidMagCal && !iMagJamming) {
+      fu[i] += fv[i];
+      faErr[i] += faErrM[i];
+    }
+    fThErr[i] = falpha[i] * fu[i];
+    fbErr[i] = fbeta[i] * fu[i];
+  }
+
+  // *********************************************************************************
+  // re-create the noise covariance matrix Qw=fn(P+) for the next iteration
+  // from the diagonal of P+ = Qw - K * C * Qw
+  // *********************************************************************************
+  for (i = X; i <= Z; i++) {
+    // Qw[b-b-] = Q[b+b+] + Qwb and Qw[th-b-] = -deltat * Qw[b-b-]
+    fPPlus = QwBB[i] - fbeta[i] * fbeta[i] * fh[i];
+    QwBB[i] = fPPlus + FQWB_9DOF_GBY_KALMAN;
+    QwThB[i] = -deltat * QwBB[i];
+
+    // Qw[th-th-] = Q[th+th+] + deltat^2 * (Q[b+b+] + Qwb + QvG)
+    QwThTh[i] = QwThTh[i] - falpha[i] * falpha[i] * fh[i] +
+                deltatsq * (fPPlus + QwbplusQvG);
+
+    // Qw[a-a-] = ca^2 * Q[a+a+] + Qwa
+    fPPlus = QwAA[i] - QwAA[i] * QwAA[i] * fS6x6[i][i];
+    QwAA[i] = casq * fPPlus + FQWA_9DOF_GBY_KALMAN;
+
+    // Qw[d-d-] = cd^2 * Q[d+d+] + Qwd
+    fPPlus = QwDD[i] - QwDD[i] * QwDD[i] * fS6x6[i + 3][i + 3];
+    QwDD[i] = cdsq * fPPlus + FQWD_9DOF_GBY_KALMAN;
+  }
+
+  // *********************************************************************************
+  // apply the a posteriori error corrections to the a posteriori state vector
+  // *********************************************************************************
+
+  // rotate the a priori quaternion by -thetae+ and renormalize
+  for (i = X; i <= Z; i++) {
+    rvec[i] = iQFromFloat(fThErr[i], -FDEGTORAD * ONE_Q30);
+  }
+  iQuaternionFromRotationVectorRad(&Deltaq, rvec);
+  iqAeqBxC(&qPl, &qMi, &Deltaq);
+  iqAeqNormqA(&qPl);
+  iRotationMatrixFromQuaternion(RPl, &qPl);
+
+  // update the gyro offset and the linear acceleration
+  for (i = X; i <= Z; i++) {
+    bPl[i] -= iQFromFloat(fbErr[i], (float)(1L << NXPQ_GYRO_FRAC));
+    aSePl[i] =
+        aSeMi[i] - iQFromFloat(faErr[i], (float)(1L << NXPQ_ACCEL_FRAC));
+  }
+
+  // de-rotate the accelerometer measurement to the global frame and remove
+  // gravity
+  for (i = X; i <= Z; i++) {
+    aGlPl[i] = -(int32_t)(((int64_t)RPl[X][i] * Accel[X] +
+                           (int64_t)RPl[Y][i] * Accel[Y] +
+                           (int64_t)RPl[Z][i] * Accel[Z]) >>
+                          30);
+  }
+  aGlPl[Z] += ONE_G_Q26;
+
+  // update the reference geomagnetic vector using magnetic disturbance error if
+  // valid calibration and no jamming
+  if (ValidMagCal && !iMagJamming) {
+    for (i = X; i <= Z; i++) {
+      dErrSe[i] = iQFromFloat(fdErr[i], (float)(1L << NXPQ_MAG_FRAC));
+    }
+    for (i = X; i <= Z; i += 2) {
+      dErrGl[i] = (int32_t)(((int64_t)RPl[X][i] * dErrSe[X] +
+                             (int64_t)RPl[Y][i] * dErrSe[Y] +
+                             (int64_t)RPl[Z][i] * dErrSe[Z]) >>
+                            30);
+    }
+
+    // the north pointing component fadj must always be non-negative
+    fopp = mGl[Z] - dErrGl[Z];
+    fadj = mGl[X] - dErrGl[X];
+    if (fadj < 0) {
+      fadj = 0;
+    }
+    fhyp = iSqrt64((uint64_t)((int64_t)fopp * fopp + (int64_t)fadj * fadj));
+
+    // check for the pathological condition of zero geomagnetic field
+    if (fhyp != 0) {
+      isindelta = (int32_t)(((int64_t)fopp << 30) / (int64_t)fhyp);
+      icosdelta = (int32_t)(((int64_t)fadj << 30) / (int64_t)fhyp);
+
+      // limit the inclination angle between limits to prevent runaway
+      if (isindelta > (int32_t)(SINDELTAMAX * ONE_Q30)) {
+        isindelta = (int32_t)(SINDELTAMAX * ONE_Q30);
+        icosdelta = (int32_t)(COSDELTAMAX * ONE_Q30);
+      } else if (isindelta < -(int32_t)(SINDELTAMAX * ONE_Q30)) {
+        isindelta = -(int32_t)(SINDELTAMAX * ONE_Q30);
+        icosdelta = (int32_t)(COSDELTAMAX * ONE_Q30);
+      }
+
+      // compute the new geomagnetic vector (always north pointing)
+      DeltaPl = iasin_deg(isindelta);
+      mGl[X] = (int32_t)(((int64_t)(MagB * (1L << NXPQ_MAG_FRAC)) *
+                          icosdelta) >>
+                         30);
+      mGl[Z] = (int32_t)(((int64_t)(MagB * (1L << NXPQ_MAG_FRAC)) *
+                          isindelta) >>
+                         30);
+    }
+  }
+
+  // calculate the NED Euler angles
+  iNEDAnglesDegFromRotationMatrix(RPl, &PhiPl, &ThePl, &PsiPl, &RhoPl, &ChiPl);
+}
+
+// convert a float to fixed point with fscale = 2^(fractional bits),
+// saturating at the limits of int32_t
+static int32_t iQFromFloat(float x, float fscale) {
+  x *= fscale;
+  if (x >= 2147483520.0F) {
+    return 0x7FFFFFFFL;
+  }
+  if (x <= -2147483648.0F) {
+    return -0x7FFFFFFFL - 1;
+  }
+  return (int32_t)x;
+}
+
+// integer square root rounded down
+static uint32_t iSqrt64(uint64_t x) {
+  uint64_t res = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)res;
+}
+
+// atan(t) (deg, Q16) for 0 <= t <= 1 (Q30) using the Abramowitz and Stegun
+// 4.4.49 polynomial, maximum error 2E-8 rad plus rounding (about 1E-6 deg)
+static int32_t iatan_01_deg(int32_t t) {
+  static const int32_t ia[8] = {1073741108, -357876604, 214174299,
+                                -149341741, 103530234,  -60032783,
+                                23473316,   -4353012};
+  int32_t t2; // t^2 (Q30)
+  int64_t acc; // Horner accumulator (Q30)
+  int8_t i;
+
+  t2 = (int32_t)(((int64_t)t * t) >> 30);
+  acc = ia[7];
+  for (i = 6; i >= 0; i--) {
+    acc = ia[i] + ((t2 * acc) >> 30);
+  }
+  // radians (Q30) to degrees (Q16)
+  acc = (t * acc) >> 30;
+  return (int32_t)((acc * RADTODEG_Q24) >> (30 + 24 - NXPQ_ANGLE_FRAC));
+}
+
+// atan2 (deg, Q16) in range -180 to 180 deg for y and x in any common format
+static int32_t iatan2_deg(int32_t y, int32_t x) {
+  int64_t ax, ay; // absolute values
+  int32_t angle;  // angle (deg, Q16)
+
+  if ((x == 0) && (y == 0)) {
+    return 0;
+  }
+  ax = (x < 0) ? -(int64_t)x : x;
+  ay = (y < 0) ? -(int64_t)y : y;
+
+  // reduce to the first octant so the tangent is in the range 0 to 1
+  if (ay <= ax) {
+    angle = iatan_01_deg((int32_t)((ay << 30) / ax));
+  } else {
+    angle = DEG90_Q16 - iatan_01_deg((int32_t)((ax << 30) / ay));
+  }
+
+  // map onto the correct quadrant
+  if (x < 0) {
+    angle = DEG180_Q16 - angle;
+  }
+  if (y < 0) {
+    angle = -angle;
+  }
+  return angle;
+}
+
+// asin (deg, Q16) in range -90 to 90 deg for -1 <= x <= 1 (Q30)
+static int32_t iasin_deg(int32_t x) {
+  if (x >= ONE_Q30) {
+    return DEG90_Q16;
+  }
+  if (x <= -ONE_Q30) {
+    return -DEG90_Q16;
+  }
+  return iatan2_deg(
+      x, (int32_t)iSqrt64(((uint64_t)1 << 60) - (uint64_t)((int64_t)x * x)));
+}
+
+// acos (deg, Q16) in range 0 to 180 deg for -1 <= x <= 1 (Q30)
+static int32_t iacos_deg(int32_t x) {
+  if (x >= ONE_Q30) {
+    return 0;
+  }
+  if (x <= -ONE_Q30) {
+    return DEG180_Q16;
+  }
+  return iatan2_deg(
+      (int32_t)iSqrt64(((uint64_t)1 << 60) - (uint64_t)((int64_t)x * x)), x);
+}
+
+// extract the NED angles (deg, Q16) from the NED rotation matrix (Q30)
+static void iNEDAnglesDegFromRotationMatrix(int32_t R[][3], int32_t *piPhiDeg,
+                                            int32_t *piTheDeg,
+                                            int32_t *piPsiDeg,
+                                            int32_t *piRhoDeg,
+                                            int32_t *piChiDeg) {
+  // calculate the pitch angle -90.0 <= Theta <= 90.0 deg
+  *piTheDeg = iasin_deg(-R[X][Z]);
+
+  // calculate the roll angle range -180.0 <= Phi < 180.0 deg
+  *piPhiDeg = iatan2_deg(R[Y][Z], R[Z][Z]);
+  if (*piPhiDeg == DEG180_Q16) {
+    *piPhiDeg = -DEG180_Q16;
+  }
+
+  // calculate the yaw (compass) angle 0.0 <= Psi < 360.0 deg
+  if (*piTheDeg == DEG90_Q16) {
+    // vertical upwards gimbal lock case
+    *piPsiDeg = iatan2_deg(R[Z][Y], R[Y][Y]) + *piPhiDeg;
+  } else if (*piTheDeg == -DEG90_Q16) {
+    // vertical downwards gimbal lock case
+    *piPsiDeg = iatan2_deg(-R[Z][Y], R[Y][Y]) - *piPhiDeg;
+  } else {
+    // general case
+    *piPsiDeg = iatan2_deg(R[X][Y], R[X][X]);
+  }
+
+  // map yaw angle Psi onto range 0.0 <= Psi < 360.0 deg
+  if (*piPsiDeg < 0) {
+    *piPsiDeg += DEG360_Q16;
+  }
+  if (*piPsiDeg >= DEG360_Q16) {
+    *piPsiDeg = 0;
+  }
+
+  // for NED, the compass heading Rho equals the yaw angle Psi
+  *piRhoDeg = *piPsiDeg;
+
+  // calculate the tilt angle from vertical Chi (0 <= Chi <= 180 deg)
+  *piChiDeg = iacos_deg(R[Z][Z]);
+}
+
+// computes the rotation quaternion (Q30) from a rotation vector (rad, Q30)
+// using the series for sin(eta/2)/eta and cos(eta/2) to sixth order in eta,
+// accurate to 2E-6 up to the 2 rad^2 limit on eta^2
+static void iQuaternionFromRotationVectorRad(iQuaternion_t *pq,
+                                             const int32_t rvec[]) {
+  int64_t ieta2; // eta^2 (Q30)
+  int64_t isinc; // sin(eta/2)/eta (Q30)
+  int64_t icos;  // cos(eta/2) (Q30)
+
+  ieta2 = ((int64_t)rvec[X] * rvec[X] + (int64_t)rvec[Y] * rvec[Y] +
+           (int64_t)rvec[Z] * rvec[Z]) >>
+          30;
+  if (ieta2 > MAXETA2_Q30) {
+    ieta2 = MAXETA2_Q30;
+  }
+
+  // 1/2 - eta^2/48 + eta^4/3840 - eta^6/645120
+  isinc = 279620 - ((ieta2 * 1664) >> 30);
+  isinc = -22369621 + ((ieta2 * isinc) >> 30);
+  isinc = (ONE_Q30 >> 1) + ((ieta2 * isinc) >> 30);
+
+  // 1 - eta^2/8 + eta^4/384 - eta^6/46080
+  icos = 2796203 - ((ieta2 * 23302) >> 30);
+  icos = -134217728 + ((ieta2 * icos) >> 30);
+  icos = ONE_Q30 + ((ieta2 * icos) >> 30);
+
+  pq->q0 = (int32_t)icos;
+  pq->q1 = (int32_t)((rvec[X] * isinc) >> 30);
+  pq->q2 = (int32_t)((rvec[Y] * isinc) >> 30);
+  pq->q3 = (int32_t)((rvec[Z] * isinc) >> 30);
+}
+
+// compute the rotation matrix (Q30) from an orientation quaternion (Q30)
+static void iRotationMatrixFromQuaternion(int32_t R[][3],
+                                          const iQuaternion_t *pq) {
+  int64_t q0q0, q0q1, q0q2, q0q3;
+  int64_t q1q1, q1q2, q1q3;
+  int64_t q2q2, q2q3;
+  int64_t q3q3;
+
+  // calculate products (Q60)
+  q0q0 = (int64_t)pq->q0 * pq->q0;
+  q0q1 = (int64_t)pq->q0 * pq->q1;
+  q0q2 = (int64_t)pq->q0 * pq->q2;
+  q0q3 = (int64_t)pq->q0 * pq->q3;
+  q1q1 = (int64_t)pq->q1 * pq->q1;
+  q1q2 = (int64_t)pq->q1 * pq->q2;
+  q1q3 = (int64_t)pq->q1 * pq->q3;
+  q2q2 = (int64_t)pq->q2 * pq->q2;
+  q2q3 = (int64_t)pq->q2 * pq->q3;
+  q3q3 = (int64_t)pq->q3 * pq->q3;
+
+  // calculate the rotation matrix assuming the quaternion is normalized. the
+  // factor of two is folded into the shift
+  R[X][X] = (int32_t)((q0q0 + q1q1) >> 29) - ONE_Q30;
+  R[X][Y] = (int32_t)((q1q2 + q0q3) >> 29);
+  R[X][Z] = (int32_t)((q1q3 - q0q2) >> 29);
+  R[Y][X] = (int32_t)((q1q2 - q0q3) >> 29);
+  R[Y][Y] = (int32_t)((q0q0 + q2q2) >> 29) - ONE_Q30;
+  R[Y][Z] = (int32_t)((q2q3 + q0q1) >> 29);
+  R[Z][X] = (int32_t)((q1q3 + q0q2) >> 29);
+  R[Z][Y] = (int32_t)((q2q3 - q0q1) >> 29);
+  R[Z][Z] = (int32_t)((q0q0 + q3q3) >> 29) - ONE_Q30;
+}
+
+// set a quaternion to the unit quaternion
+static void iqAeq1(iQuaternion_t *pqA) {
+  pqA->q0 = ONE_Q30;
+  pqA->q1 = pqA->q2 = pqA->q3 = 0;
+}
+
+// function compute the quaternion product qB * qC (Q30)
+static void iqAeqBxC(iQuaternion_t *pqA, const iQuaternion_t *pqB,
+                     const iQuaternion_t *pqC) {
+  pqA->q0 = (int32_t)(((int64_t)pqB->q0 * pqC->q0 -
+                       (int64_t)pqB->q1 * pqC->q1 -
+                       (int64_t)pqB->q2 * pqC->q2 -
+                       (int64_t)pqB->q3 * pqC->q3) >>
+                      30);
+  pqA->q1 = (int32_t)(((int64_t)pqB->q0 * pqC->q1 +
+                       (int64_t)pqB->q1 * pqC->q0 +
+                       (int64_t)pqB->q2 * pqC->q3 -
+                       (int64_t)pqB->q3 * pqC->q2) >>
+                      30);
+  pqA->q2 = (int32_t)(((int64_t)pqB->q0 * pqC->q2 -
+                       (int64_t)pqB->q1 * pqC->q3 +
+                       (int64_t)pqB->q2 * pqC->q0 +
+                       (int64_t)pqB->q3 * pqC->q1) >>
+                      30);
+  pqA->q3 = (int32_t)(((int64_t)pqB->q0 * pqC->q3 +
+                       (int64_t)pqB->q1 * pqC->q2 -
+                       (int64_t)pqB->q2 * pqC->q1 +
+                       (int64_t)pqB->q3 * pqC->q0) >>
+                      30);
+}
+
+// function normalizes a rotation quaternion (Q30) and ensures q0 is
+// non-negative
+static void iqAeqNormqA(iQuaternion_t *pqA) {
+  int64_t inorm2; // squared norm (Q30)
+  int64_t irecip; // reciprocal of the norm (Q30)
+  int64_t itmp;   // scratch
+
+  inorm2 = ((int64_t)pqA->q0 * pqA->q0 + (int64_t)pqA->q1 * pqA->q1 +
+            (int64_t)pqA->q2 * pqA->q2 + (int64_t)pqA->q3 * pqA->q3) >>
+           30;
+
+  if ((inorm2 > (ONE_Q30 - (ONE_Q30 >> 3))) &&
+      (inorm2 < (ONE_Q30 + (ONE_Q30 >> 3)))) {
+    // normal case a few LSB from unit norm: two Newton steps for 1/sqrt from
+    // an initial guess of 1
+    irecip = (3L << 29) - (inorm2 >> 1);
+    itmp = (((irecip * irecip) >> 30) * inorm2) >> 30;
+    irecip = (irecip * ((3L << 29) - (itmp >> 1))) >> 30;
+  } else if (inorm2 > 0) {
+    // far from unit norm after a reset or setQuaternion
+    irecip = ((int64_t)1 << 60) / (int64_t)iSqrt64((uint64_t)inorm2 << 30);
+  } else {
+    // return with identity quaternion since the quaternion is corrupted
+    iqAeq1(pqA);
+    return;
+  }
+
+  pqA->q0 = (int32_t)((pqA->q0 * irecip) >> 30);
+  pqA->q1 = (int32_t)((pqA->q1 * irecip) >> 30);
+  pqA->q2 = (int32_t)((pqA->q2 * irecip) >> 30);
+  pqA->q3 = (int32_t)((pqA->q3 * irecip) >> 30);
+
+  // correct a negative scalar component if the function was called with
+  // negative q0
+  if (pqA->q0 < 0) {
+    pqA->q0 = -pqA->q0;
+    pqA->q1 = -pqA->q1;
+    pqA->q2 = -pqA->q2;
+    pqA->q3 = -pqA->q3;
+  }
+}
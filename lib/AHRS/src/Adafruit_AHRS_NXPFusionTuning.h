@@ -0,0 +1,71 @@
+// tuning shared by the float (Adafruit_AHRS_NXPFusion.cpp) and fixed-point
+// (Adafruit_AHRS_NXPFusionQ.cpp) builds of the NXP 9DOF Kalman filter
+
+#ifndef __Adafruit_Nxp_Fusion_Tuning_h_
+#define __Adafruit_Nxp_Fusion_Tuning_h_
+
+// The original NXP tuning flies. AHRS_NXP_LEGACY_TUNING in the build flags
+// selects the 1E-15 tuning MARTHA used before instead, for comparisons only:
+// its accelerometer gain block is close to singular and the attitude diverges
+// (see ahrs_fixed_compare in tools/README.md)
+#ifdef AHRS_NXP_LEGACY_TUNING
+// kalman filter noise variances
+#define FQVA_9DOF_GBY_KALMAN 1E-15F // accelerometer noise g^2 so 1.4mg RMS
+#define FQVM_9DOF_GBY_KALMAN 1E-15F  // magnetometer noise uT^2
+#define FQVG_9DOF_GBY_KALMAN 1E-15F  // gyro noise (deg/s)^2
+#define FQWB_9DOF_GBY_KALMAN                                                   \
+  1E-25F // gyro offset drift (deg/s)^2: 1E-9 implies 0.09deg/s max at 50Hz
+#define FQWA_9DOF_GBY_KALMAN                                                   \
+  1E-25F // linear acceleration drift g^2 (increase slows convergence to g but
+        // reduces sensitivity to shake)
+#define FQWD_9DOF_GBY_KALMAN                                                   \
+  10E-37F // magnetic disturbance drift uT^2 (increase slows convergence to B but
+       // reduces sensitivity to magnet)
+// initialization of Qw covariance matrix
+#define FQWINITTHTH_9DOF_GBY_KALMAN 2E-2F // th_e * th_e terms
+#define FQWINITBB_9DOF_GBY_KALMAN 2E-2F    // b_e * b_e terms
+#define FQWINITTHB_9DOF_GBY_KALMAN 0.0F      // th_e * b_e terms
+#define FQWINITAA_9DOF_GBY_KALMAN                                              \
+  10E-1F // a_e * a_e terms (increase slows convergence to g but reduces
+         // sensitivity to shake) //10E-5F
+#define FQWINITDD_9DOF_GBY_KALMAN                                              \
+  10E-1F // d_e * d_e terms (increase slows convergence to B but reduces
+          // sensitivity to magnet)
+// linear acceleration and magnetic disturbance time constants
+#define FCA_9DOF_GBY_KALMAN 10E-37F // linear acceleration decay factor
+#define FCD_9DOF_GBY_KALMAN 10E-37F // magnetic disturbance decay factor
+#else
+// kalman filter noise variances
+#define FQVA_9DOF_GBY_KALMAN 2E-6F // accelerometer noise g^2 so 1.4mg RMS
+#define FQVM_9DOF_GBY_KALMAN 0.1F  // magnetometer noise uT^2
+#define FQVG_9DOF_GBY_KALMAN 0.3F  // gyro noise (deg/s)^2
+#define FQWB_9DOF_GBY_KALMAN                                                   \
+  1E-9F // gyro offset drift (deg/s)^2: 1E-9 implies 0.09deg/s max at 50Hz
+#define FQWA_9DOF_GBY_KALMAN                                                   \
+  1E-4F // linear acceleration drift g^2 (increase slows convergence to g but
+        // reduces sensitivity to shake)
+#define FQWD_9DOF_GBY_KALMAN                                                   \
+  0.5F // magnetic disturbance drift uT^2 (increase slows convergence to B but
+       // reduces sensitivity to magnet)
+// initialization of Qw covariance matrix
+#define FQWINITTHTH_9DOF_GBY_KALMAN 2000E-5F // th_e * th_e terms
+#define FQWINITBB_9DOF_GBY_KALMAN 250E-3F    // b_e * b_e terms
+#define FQWINITTHB_9DOF_GBY_KALMAN 0.0F      // th_e * b_e terms
+#define FQWINITAA_9DOF_GBY_KALMAN                                              \
+  10E-5F // a_e * a_e terms (increase slows convergence to g but reduces
+         // sensitivity to shake)
+#define FQWINITDD_9DOF_GBY_KALMAN                                              \
+  600E-3F // d_e * d_e terms (increase slows convergence to B but reduces
+          // sensitivity to magnet)
+// linear acceleration and magnetic disturbance time constants
+#define FCA_9DOF_GBY_KALMAN 0.5F // linear acceleration decay factor
+#define FCD_9DOF_GBY_KALMAN 0.5F // magnetic disturbance decay factor
+#endif
+// maximum geomagnetic inclination angle tracked by Kalman filter
+#define SINDELTAMAX                                                            \
+  0.9063078F // sin of max +ve geomagnetic inclination angle: here 65.0 deg
+#define COSDELTAMAX                                                            \
+  0.4226183F // cos of max +ve geomagnetic inclination angle: here 65.0 deg
+#define DEFAULTB 50.0F // default geomagnetic field (uT)
+
+#endif
@@ -0,0 +1,8 @@
+// atan table of the AHRS_TRIG_LUT build of Adafruit_AHRS_NXPTrig.h, generated
+// by the compiler
+
+#include "Adafruit_AHRS_NXPTrig.h"
+
+#ifdef AHRS_TRIG_LUT
+extern constexpr AtanTable atanTable = AtanTable();
+#endif
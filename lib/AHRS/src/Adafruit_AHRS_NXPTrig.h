@@ -0,0 +1,246 @@
+// inverse trigonometric functions (deg) of the NXP 9DOF Kalman filter
+// (Adafruit_AHRS_NXPFusion.cpp)
+//
+// the default build evaluates atan with the NXP Pade approximation, which
+// costs a soft float division on top of the range reduction. defining
+// AHRS_TRIG_LUT in the build flags replaces it with linear interpolation in
+// a table of atan over 0 to 1 that the compiler generates in
+// Adafruit_AHRS_NXPTrig.cpp, so no table is pasted in here. fasin_deg,
+// facos_deg and fatan2_deg reduce to fatan_deg in both builds.
+// tools/trig_check sweeps every function against libm
+
+#ifndef __Adafruit_Nxp_Trig_h_
+#define __Adafruit_Nxp_Trig_h_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#endif
+
+// approximation to inverse tan function (deg) for x in range
+// -tan(15 deg) to tan(15 deg) giving an output -15 deg <= angle <= 15 deg
+// using modified Pade[3/2] approximation
+static inline float fatan_15deg(float x) {
+  float x2; // x^2
+
+#define PADE_A                                                                 \
+  96.644395816F // theoretical Pade[3/2] value is 5/3*180/PI=95.49296
+#define PADE_B                                                                 \
+  25.086941612F // theoretical Pade[3/2] value is 4/9*180/PI=25.46479
+#define PADE_C 1.6867633134F // theoretical Pade[3/2] value is 5/3=1.66667
+
+  // compute the approximation to the inverse tangent
+  // the function is anti-symmetric as required for positive and negative
+  // arguments
+  x2 = x * x;
+  return (x * (PADE_A + x2 * PADE_B) / (PADE_C + x2));
+}
+
+#ifdef AHRS_TRIG_LUT
+
+// number of intervals of the atan table over 0 <= x <= 1. linear
+// interpolation is off by at most h^2 / 8 * max|atan''| = 0.65 / (8 * 256^2)
+// rad = 7.1E-5 deg, the float rounding adds about 5E-6 deg. the table takes
+// 1 kB of flash
+#define ATAN_LUT_INTERVALS 256
+
+// atan(x) (deg) for 0 <= x <= 1 in double precision, from Euler's series
+// atan(x) = sum 2^2n (n!)^2 / (2n+1)! * x^(2n+1) / (1+x^2)^(n+1)
+// whose terms shrink by at least 1/2 each. only evaluated by the compiler
+static constexpr double atanTableEntryDeg(double x) {
+  double r = x * x / (1.0 + x * x);
+  double term = x / (1.0 + x * x);
+  double sum = 0.0;
+  for (int n = 0; n < 60; n++) {
+    sum += term;
+    term *= r * (2.0 * n + 2.0) / (2.0 * n + 3.0);
+  }
+  return sum * 57.295779513082321;
+}
+
+struct AtanTable {
+  float deg[ATAN_LUT_INTERVALS + 1]; // atan(i / ATAN_LUT_INTERVALS) (deg)
+
+  constexpr AtanTable() : deg() {
+    for (int i = 0; i <= ATAN_LUT_INTERVALS; i++) {
+      deg[i] = (float)atanTableEntryDeg((double)i / ATAN_LUT_INTERVALS);
+    }
+  }
+};
+
+// defined once in Adafruit_AHRS_NXPTrig.cpp so every file including this
+// header shares one copy
+extern const AtanTable atanTable;
+
+// table lookup of atan (deg) for x in range 0 to 1 inclusive giving an output
+// 0 deg <= angle <= 45 deg
+static inline float fatan_lut_deg(float x) {
+  // a NaN would make the table index undefined, pass it through like the
+  // Pade kernel does
+  if (!(x == x)) {
+    return x;
+  }
+
+  float fi = x * ATAN_LUT_INTERVALS; // fractional table index
+  int16_t i = (int16_t)fi;           // interval below x
+
+  // x = 1 falls on the last table entry
+  if (i >= ATAN_LUT_INTERVALS) {
+    i = ATAN_LUT_INTERVALS - 1;
+  }
+  return atanTable.deg[i] +
+         (fi - i) * (atanTable.deg[i + 1] - atanTable.deg[i]);
+}
+
+// function returns angle in range -90 to 90 deg
+// maximum error is 7.5E-5 deg
+static inline float fatan_deg(float x) {
+  float fangledeg;     // compute computed (deg)
+  int8_t ixisnegative; // argument x is negative
+  int8_t ixexceeds1;   // argument x is greater than 1.0
+
+  // reset all flags
+  ixisnegative = ixexceeds1 = 0;
+
+  // test for negative argument to allow use of tan(-x)=-tan(x)
+  if (x < 0.0F) {
+    x = -x;
+    ixisnegative = 1;
+  }
+
+  // test for argument above 1 to allow use of atan(x)=pi/2-atan(1/x)
+  if (x > 1.0F) {
+    x = 1.0F / x;
+    ixexceeds1 = 1;
+  }
+
+  // at this point, x is in the range 0 to 1 inclusive, which the table covers
+  fangledeg = fatan_lut_deg(x);
+
+  // undo the distortions applied earlier to obtain -90 deg <= angle <= 90 deg
+  if (ixexceeds1)
+    fangledeg = 90.0F - fangledeg;
+  if (ixisnegative)
+    fangledeg = -fangledeg;
+
+  return (fangledeg);
+}
+
+#else
+
+// function returns angle in range -90 to 90 deg
+// maximum error is 9.84E-6 deg
+static inline float fatan_deg(float x) {
+  float fangledeg;     // compute computed (deg)
+  int8_t ixisnegative; // argument x is negative
+  int8_t ixexceeds1;   // argument x is greater than 1.0
+  int8_t ixmapped;     // argument in range tan(15 deg) to tan(45 deg)=1.0
+
+#define TAN15DEG 0.26794919243F // tan(15 deg) = 2 - sqrt(3)
+#define TAN30DEG 0.57735026919F // tan(30 deg) = 1/sqrt(3)
+
+  // reset all flags
+  ixisnegative = ixexceeds1 = ixmapped = 0;
+
+  // test for negative argument to allow use of tan(-x)=-tan(x)
+  if (x < 0.0F) {
+    x = -x;
+    ixisnegative = 1;
+  }
+
+  // test for argument above 1 to allow use of atan(x)=pi/2-atan(1/x)
+  if (x > 1.0F) {
+    x = 1.0F / x;
+    ixexceeds1 = 1;
+  }
+
+  // at this point, x is in the range 0 to 1 inclusive
+  // map argument onto range -tan(15 deg) to tan(15 deg)
+  // using tan(angle-30deg) = (tan(angle)-tan(30deg)) / (1 +
+  // tan(angle)tan(30deg)) tan(15deg) maps to tan(-15 deg) = -tan(15 deg)
+  // 1. maps to (sqrt(3) - 1) / (sqrt(3) + 1) = 2 - sqrt(3) = tan(15 deg)
+  if (x > TAN15DEG) {
+    x = (x - TAN30DEG) / (1.0F + TAN30DEG * x);
+    ixmapped = 1;
+  }
+
+  // call the atan estimator to obtain -15 deg <= angle <= 15 deg
+  fangledeg = fatan_15deg(x);
+
+  // undo the distortions applied earlier to obtain -90 deg <= angle <= 90 deg
+  if (ixmapped)
+    fangledeg += 30.0F;
+  if (ixexceeds1)
+    fangledeg = 90.0F - fangledeg;
+  if (ixisnegative)
+    fangledeg = -fangledeg;
+
+  return (fangledeg);
+}
+
+#endif // AHRS_TRIG_LUT
+
+// function returns an approximation to angle(deg)=asin(x) for x in the range -1
+// <= x <= 1 and returns -90 <= angle <= 90 deg maximum error is 10.29E-6 deg
+// (7.7E-5 deg with AHRS_TRIG_LUT)
+static inline float fasin_deg(float x) {
+  // for robustness, check for invalid argument
+  if (x >= 1.0F)
+    return 90.0F;
+  if (x <= -1.0F)
+    return -90.0F;
+
+  // call the atan which will return an angle in the correct range -90 to 90 deg
+  // this line cannot fail from division by zero or negative square root since
+  // |x| < 1
+  return (fatan_deg(x / sqrtf(1.0F - x * x)));
+}
+
+// function returns an approximation to angle(deg)=acos(x) for x in the range -1
+// <= x <= 1 and returns 0 <= angle <= 180 deg maximum error is 14.67E-6 deg
+// (8.2E-5 deg with AHRS_TRIG_LUT)
+static inline float facos_deg(float x) {
+  // for robustness, check for invalid arguments
+  if (x >= 1.0F)
+    return 0.0F;
+  if (x <= -1.0F)
+    return 180.0F;
+
+  // call the atan which will return an angle in the incorrect range -90 to 90
+  // deg these lines cannot fail from division by zero or negative square root
+  if (x == 0.0F)
+    return 90.0F;
+  if (x > 0.0F)
+    return fatan_deg((sqrtf(1.0F - x * x) / x));
+  return 180.0F + fatan_deg((sqrtf(1.0F - x * x) / x));
+}
+
+// function returns approximate atan2 angle in range -180 to 180 deg
+// maximum error is 14.58E-6 deg (8.2E-5 deg with AHRS_TRIG_LUT)
+static inline float fatan2_deg(float y, float x) {
+  // check for zero x to avoid division by zero
+  if (x == 0.0F) {
+    // return 90 deg for positive y
+    if (y > 0.0F)
+      return 90.0F;
+    // return -90 deg for negative y
+    if (y < 0.0F)
+      return -90.0F;
+    // otherwise y= 0.0 and return 0 deg (invalid arguments)
+    return 0.0F;
+  }
+
+  // from here onwards, x is guaranteed to be non-zero
+  // compute atan2 for quadrant 1 (0 to 90 deg) and quadrant 4 (-90 to 0 deg)
+  if (x > 0.0F)
+    return (fatan_deg(y / x));
+  // compute atan2 for quadrant 2 (90 to 180 deg)
+  if ((x < 0.0F) && (y > 0.0F))
+    return (180.0F + fatan_deg(y / x));
+  // compute atan2 for quadrant 3 (-180 to -90 deg)
+  return (-180.0F + fatan_deg(y / x));
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+// Per-object SRAM budgets (bytes) checked by static_asserts in the
+// compile-time sized data handling classes. The STM32F103C8 only has 20 KB of
+// SRAM shared by every buffer, the stack and the Arduino core, so a template
+// instance that outgrows its slice fails the build instead of the flight.
+// Override from platformio.ini build_flags if a config really needs more.
+
+#ifndef MARTHA_LAUNCH_PREDICTOR_RAM_BUDGET
+#define MARTHA_LAUNCH_PREDICTOR_RAM_BUDGET 512
+#endif
+
+#ifndef MARTHA_SENSOR_DATA_HANDLER_RAM_BUDGET
+#define MARTHA_SENSOR_DATA_HANDLER_RAM_BUDGET 256
+#endif
+
+#endif
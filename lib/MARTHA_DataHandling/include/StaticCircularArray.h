@@ -0,0 +1,53 @@
+#ifndef STATIC_CIRCULAR_ARRAY_H
+#define STATIC_CIRCULAR_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed-capacity ring buffer with its storage sized at compile time.
+ *
+ * Lives entirely inside the owning object (no heap), so the linker map shows
+ * exactly what every instance costs. Index 0 is the oldest element.
+ */
+template <typename T, uint16_t Capacity>
+class StaticCircularArray {
+  static_assert(Capacity > 0, "StaticCircularArray needs a non-zero capacity");
+
+public:
+  StaticCircularArray() : head(0), count(0) {}
+
+  void push(const T &item) {
+    items[head] = item;
+    head = head + 1 == Capacity ? 0 : head + 1;
+    if (count < Capacity) {
+      count++;
+    }
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+  }
+
+  uint16_t size() const { return count; }
+  bool isFull() const { return count == Capacity; }
+  static constexpr uint16_t capacity() { return Capacity; }
+
+  // 0 is the oldest element, size() - 1 the newest
+  const T &operator[](uint16_t i) const {
+    uint16_t start = count == Capacity ? head : 0;
+    uint16_t index = start + i;
+    return items[index >= Capacity ? index - Capacity : index];
+  }
+
+  const T &oldest() const { return (*this)[0]; }
+  const T &newest() const { return items[head == 0 ? Capacity - 1 : head - 1]; }
+
+private:
+  T items[Capacity];
+  uint16_t head;
+  uint16_t count;
+};
+
+#endif
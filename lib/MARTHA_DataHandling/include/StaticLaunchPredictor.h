@@ -0,0 +1,152 @@
+#ifndef STATIC_LAUNCH_PREDICTOR_H
+#define STATIC_LAUNCH_PREDICTOR_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+#include "MemoryBudget.h"
+#include "StaticCircularArray.h"
+
+/**
+ * @brief Median launch detector with a window of WindowSamples samples sized
+ * at compile time.
+ *
+ * Same idea as the Avionics LaunchPredictor: keep one squared acceleration
+ * sample every windowInterval_ms and declare launch when the median of the
+ * full window exceeds the threshold squared. The median rejects short knocks
+ * on the pad while a sustained burn fills the window within about half a
+ * window length.
+ *
+ * The flight code uses it through StaticLaunchPredictor, which fixes the
+ * threshold and interval too. The host replay tools construct it directly so
+ * a parameter sweep runs exactly the code that flies.
+ *
+ * @tparam WindowSamples Number of samples in the median window.
+ */
+template <uint16_t WindowSamples>
+class WindowedLaunchPredictor {
+  static_assert(WindowSamples >= 3,
+                "Window must hold at least three samples for a median");
+
+public:
+  static constexpr uint16_t WINDOW_SAMPLES = WindowSamples;
+
+  enum UpdateResult {
+    LAUNCH_DETECTED,
+    ALREADY_LAUNCHED,
+    DATA_TOO_FAST,
+    WINDOW_NOT_FULL,
+    ACL_TOO_LOW,
+  };
+
+  /**
+   * @param threshold_ms2 Acceleration magnitude that counts as launch (m/s^2).
+   * @param windowInterval_ms Spacing between samples kept in the window.
+   * Samples arriving faster than this are ignored.
+   */
+  WindowedLaunchPredictor(float threshold_ms2, uint16_t windowInterval_ms)
+      : thresholdSquared(threshold_ms2 * threshold_ms2),
+        windowInterval_ms(windowInterval_ms), launched(false),
+        launchedTime_ms(0), lastSampleTime_ms(0),
+        medianAccelerationSquared(0.0f) {
+    static_assert(sizeof(WindowedLaunchPredictor) <=
+                      MARTHA_LAUNCH_PREDICTOR_RAM_BUDGET,
+                  "LaunchPredictor window exceeds its SRAM budget");
+  }
+
+  int update(DataPoint xac, DataPoint yac, DataPoint zac) {
+    if (launched) {
+      return ALREADY_LAUNCHED;
+    }
+
+    uint32_t time_ms = xac.timestamp_ms;
+    if (window.size() > 0) {
+      uint32_t gap_ms = time_ms - lastSampleTime_ms;
+      // A gap (e.g. a stalled I2C read) just leaves the window spanning a
+      // little more time, as in the Avionics predictor. Clearing it would
+      // restart detection on every hiccup
+      if (gap_ms < windowInterval_ms) {
+        return DATA_TOO_FAST;
+      }
+    }
+
+    lastSampleTime_ms = time_ms;
+    window.push(xac.data * xac.data + yac.data * yac.data +
+                zac.data * zac.data);
+
+    if (!window.isFull()) {
+      return WINDOW_NOT_FULL;
+    }
+
+    medianAccelerationSquared = windowMedian();
+    if (medianAccelerationSquared > thresholdSquared) {
+      launched = true;
+      launchedTime_ms = time_ms;
+      return LAUNCH_DETECTED;
+    }
+    return ACL_TOO_LOW;
+  }
+
+  void reset() {
+    launched = false;
+    launchedTime_ms = 0;
+    medianAccelerationSquared = 0.0f;
+    window.clear();
+  }
+
+  bool isLaunched() const { return launched; }
+  uint32_t getLaunchedTime() const { return launchedTime_ms; }
+  float getMedianAccelerationSquared() const {
+    return medianAccelerationSquared;
+  }
+
+private:
+  // Insertion sort into a scratch copy; WINDOW_SAMPLES is small and constant
+  float windowMedian() const {
+    float sorted[WINDOW_SAMPLES];
+    for (uint16_t i = 0; i < WINDOW_SAMPLES; i++) {
+      float value = window[i];
+      uint16_t j = i;
+      while (j > 0 && sorted[j - 1] > value) {
+        sorted[j] = sorted[j - 1];
+        j--;
+      }
+      sorted[j] = value;
+    }
+    return sorted[WINDOW_SAMPLES / 2];
+  }
+
+  StaticCircularArray<float, WINDOW_SAMPLES> window; // acceleration^2
+  float thresholdSquared;
+  uint16_t windowInterval_ms;
+  bool launched;
+  uint32_t launchedTime_ms;
+  uint32_t lastSampleTime_ms;
+  float medianAccelerationSquared;
+};
+
+/**
+ * @brief LaunchPredictor with its whole configuration fixed at compile time.
+ *
+ * Because the window length is a template argument the buffer lives inside
+ * the object, the sort loops have constant trip counts the compiler can
+ * unroll, and each configuration shows up as its own symbol in the linker
+ * map.
+ *
+ * @tparam Threshold_ms2 Acceleration magnitude that counts as launch (m/s^2).
+ * @tparam WindowSize_ms Length of the median window.
+ * @tparam WindowInterval_ms Spacing between samples kept in the window.
+ * Samples arriving faster than this are ignored.
+ */
+template <uint16_t Threshold_ms2, uint16_t WindowSize_ms,
+          uint16_t WindowInterval_ms>
+class StaticLaunchPredictor
+    : public WindowedLaunchPredictor<WindowSize_ms / WindowInterval_ms> {
+  static_assert(WindowInterval_ms > 0, "Window interval must be non-zero");
+
+public:
+  StaticLaunchPredictor()
+      : WindowedLaunchPredictor<WindowSize_ms / WindowInterval_ms>(
+            Threshold_ms2, WindowInterval_ms) {}
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef STATIC_SENSOR_DATA_HANDLER_H
+#define STATIC_SENSOR_DATA_HANDLER_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+#include "data_handling/SensorDataHandler.h"
+#include "MemoryBudget.h"
+#include "StaticCircularArray.h"
+
+/**
+ * @brief SensorDataHandler that also keeps the last HistoryLength samples in a
+ * buffer sized at compile time.
+ *
+ * Saving (including restrictSaveSpeed) is unchanged and handled by the base
+ * class. The history is for consumers on the flight computer that need a
+ * short window of a channel without allocating one at runtime.
+ */
+template <uint16_t HistoryLength>
+class StaticSensorDataHandler : public SensorDataHandler {
+public:
+  StaticSensorDataHandler(uint8_t name, IDataSaver *ds)
+      : SensorDataHandler(name, ds) {
+    static_assert(sizeof(StaticSensorDataHandler) <=
+                      MARTHA_SENSOR_DATA_HANDLER_RAM_BUDGET,
+                  "StaticSensorDataHandler history exceeds its SRAM budget");
+  }
+
+  void addData(DataPoint dp) {
+    history.push(dp);
+    SensorDataHandler::addData(dp);
+  }
+
+  // 0 is the oldest sample, getHistorySize() - 1 the newest
+  const DataPoint &getHistory(uint16_t i) const { return history[i]; }
+  uint16_t getHistorySize() const { return history.size(); }
+  const DataPoint &getLatest() const { return history.newest(); }
+
+private:
+  StaticCircularArray<DataPoint, HistoryLength> history;
+};
+
+#endif
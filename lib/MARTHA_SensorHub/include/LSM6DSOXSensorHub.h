@@ -0,0 +1,122 @@
+#ifndef LSM6DSOX_SENSOR_HUB_H
+#define LSM6DSOX_SENSOR_HUB_H
+
+#include <Adafruit_I2CDevice.h>
+#include <Wire.h>
+#include <stdint.h>
+
+// Accelerometer and gyroscope rate and the matching FIFO batch rate
+#define SENSOR_HUB_RATE_HZ 104.0f
+// Samples held between read() and consume()
+#define SENSOR_HUB_MAX_SAMPLES 16
+
+/**
+ * @brief The LSM6DSOX as I2C master of the LIS3MDL, read through its FIFO.
+ *
+ * Reading the IMU and then the magnetometer from the STM32 costs two bus
+ * transactions per sample, and the two readings are taken at different
+ * times. Here the LIS3MDL hangs off the LSM6DSOX auxiliary bus (SDx/SCx) and
+ * the sensor hub reads it on the IMU's own clock, batching its axes into the
+ * FIFO next to the accelerometer and gyroscope samples they were read with.
+ * The STM32 then drains everything with FIFO bursts: one transaction per
+ * four FIFO words instead of one per sensor per sample.
+ *
+ * begin() sets the accelerometer to +-16 g and the gyroscope to 2000 dps at
+ * 104 Hz, configures the LIS3MDL through the hub and starts the FIFO in
+ * continuous mode. read() decodes the FIFO into a small buffer of gyroscope
+ * and accelerometer samples, oldest first; the caller hands them to the
+ * fusion filter and releases them with consume(). The magnetometer is read by
+ * the hub at 52 Hz and the newest reading is kept, with getMag() reporting
+ * each one once. The IMU temperature is batched at 1.6 Hz.
+ *
+ * This only works with the LIS3MDL wired to the auxiliary bus. On a board
+ * with both sensors on the main bus, read the LIS3MDL directly.
+ */
+class LSM6DSOXSensorHub {
+public:
+  /**
+   * @param imuAddress I2C address of the LSM6DSOX.
+   * @param magAddress I2C address of the LIS3MDL on the auxiliary bus.
+   */
+  LSM6DSOXSensorHub(uint8_t imuAddress = 0x6A, uint8_t magAddress = 0x1E);
+
+  /**
+   * @brief Configure the IMU, the magnetometer through the hub, and the FIFO.
+   * @return False if the IMU does not answer or the hub finds no LIS3MDL.
+   */
+  bool begin(TwoWire *wire);
+
+  /**
+   * @brief Decode the FIFO into the sample buffer, after the samples already
+   * held. Words that do not fit stay in the FIFO for the next call.
+   * @return The number of samples held.
+   */
+  uint16_t read();
+
+  /**
+   * @brief Release the oldest samples.
+   */
+  void consume(uint16_t n);
+
+  uint16_t getSampleCount() const;
+
+  /**
+   * @brief Sample i, oldest first.
+   * @param gyro_dps Written with the gyroscope x, y and z axes in deg/s.
+   * @param accel_g Written with the accelerometer x, y and z axes in g.
+   */
+  void getSample(uint16_t i, float gyro_dps[3], float accel_g[3]) const;
+
+  /**
+   * @brief The newest sample read, kept after it is consumed. Zero before
+   * the first one.
+   */
+  void getLatest(float gyro_dps[3], float accel_g[3]) const;
+
+  /**
+   * @brief The newest magnetometer reading, uncalibrated.
+   * @param mag_uT Written with the x, y and z axes in uT.
+   * @return False, leaving mag_uT alone, if it was already returned.
+   */
+  bool getMag(float mag_uT[3]);
+
+  float getTemperature() const { return temperature_c; }
+
+  /**
+   * @brief Times the FIFO was found full, i.e. samples were lost because
+   * read() was not called often enough.
+   */
+  uint16_t getOverruns() const { return overruns; }
+
+private:
+  bool writeRegister(uint8_t reg, uint8_t value);
+  bool readRegisters(uint8_t reg, uint8_t *buffer, uint8_t length);
+  // Sensor hub register bank, FUNC_CFG_ACCESS
+  bool selectHubBank(bool hub);
+  // Wait for a STATUS_MASTER_MAINPAGE flag, the hub runs once per
+  // accelerometer sample
+  bool waitForHub(uint8_t flag);
+  bool writeMagRegister(uint8_t reg, uint8_t value);
+  bool readMagRegister(uint8_t reg, uint8_t *value);
+
+  Adafruit_I2CDevice *device;
+  uint8_t imuAddress;
+  uint8_t magAddress;
+
+  float gyro_dps[SENSOR_HUB_MAX_SAMPLES][3];
+  float accel_g[SENSOR_HUB_MAX_SAMPLES][3];
+  // Words of the two sensors decoded so far. A burst can end between the
+  // gyroscope and accelerometer words of a sample, so they are counted apart
+  // and only samples with both are handed out
+  uint16_t gyroCount;
+  uint16_t accelCount;
+
+  float latestGyro_dps[3];
+  float latestAccel_g[3];
+  float mag_uT[3];
+  bool newMag;
+  float temperature_c;
+  uint16_t overruns;
+};
+
+#endif
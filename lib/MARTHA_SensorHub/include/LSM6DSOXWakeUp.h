@@ -0,0 +1,51 @@
+#ifndef LSM6DSOX_WAKE_UP_H
+#define LSM6DSOX_WAKE_UP_H
+
+#include <Adafruit_I2CDevice.h>
+#include <Wire.h>
+#include <stdint.h>
+
+#include "LSM6DSOXWakeUpModel.h"
+
+/**
+ * @brief Pad wake-up detection on the LSM6DSOX wake-up engine.
+ *
+ * The rocket sits on the pad for hours, and the full-rate pipeline spends all
+ * of it finding out that nothing happened. The IMU can watch for that itself:
+ * begin() programs its wake-up engine (see LSM6DSOXWakeUpModel for what it
+ * computes) with a latched event, so the firmware only has to poll one
+ * register at a slow rate and switch to the full-rate pipeline once a jolt
+ * has been seen. The event is also routed to INT1, for boards that wire it
+ * to the STM32.
+ *
+ * The engine only decides when to look closely; LaunchPredictor and the
+ * vertical launch detector still decide what was a launch.
+ */
+class LSM6DSOXWakeUp {
+public:
+  LSM6DSOXWakeUp(uint8_t imuAddress = 0x6A);
+
+  /**
+   * @brief Program the wake-up engine. The accelerometer has to be running
+   * at WAKE_UP_ODR_HZ and WAKE_UP_FULL_SCALE_G already.
+   * @param thresholdLsb WK_THS, 0 to 63 in steps of FS / 64.
+   * @param duration WAKE_DUR, 0 to 3 samples above the threshold.
+   * @return False if the IMU does not answer.
+   */
+  bool begin(TwoWire *wire, uint8_t thresholdLsb = WAKE_UP_THS_LSB,
+             uint8_t duration = WAKE_UP_DUR_ODR);
+
+  /**
+   * @brief Read and clear the latched wake-up event.
+   * @return True if the engine saw a wake-up since the last poll.
+   */
+  bool poll();
+
+private:
+  bool writeRegister(uint8_t reg, uint8_t value);
+
+  Adafruit_I2CDevice *device;
+  uint8_t imuAddress;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LSM6DSOX_WAKE_UP_MODEL_H
+#define LSM6DSOX_WAKE_UP_MODEL_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Wake-up engine configuration. LSM6DSOXWakeUp programs these into the IMU
+// and LSM6DSOXWakeUpModel runs them on the host (tools/wakeup_sim.cpp), so
+// the two cannot drift apart
+#define WAKE_UP_ODR_HZ 104.0f      // accelerometer rate the engine runs at
+#define WAKE_UP_FULL_SCALE_G 16.0f // accelerometer range
+#define WAKE_UP_THS_LSB 8          // WK_THS in FS / 64 steps: 2 g
+#define WAKE_UP_DUR_ODR 3          // WAKE_DUR, samples above the threshold
+#define WAKE_UP_HP_CUTOFF_DIV 400.0f // HPCF_XL = 110, cut-off at ODR / 400
+
+/**
+ * @brief Host model of the LSM6DSOX wake-up engine as LSM6DSOXWakeUp sets it
+ * up.
+ *
+ * With SLOPE_FDS set the engine compares the high-pass filtered acceleration
+ * of each axis against the threshold and raises WU_IA once any axis has been
+ * above it for longer than the duration. Gravity and slow tilts on the pad
+ * are filtered out, a motor coming up to pressure is not. The filter here is
+ * a first order high-pass at the configured cut-off, which is how the
+ * datasheet describes the HPCF_XL path; the exact digital filter in the part
+ * is not documented, so check the thresholds against recorded pad data too.
+ */
+class LSM6DSOXWakeUpModel {
+public:
+  /**
+   * @param thresholdLsb WK_THS, 0 to 63 in steps of FS / 64.
+   * @param duration WAKE_DUR, 0 to 3 samples.
+   */
+  LSM6DSOXWakeUpModel(uint8_t thresholdLsb = WAKE_UP_THS_LSB,
+                      uint8_t duration = WAKE_UP_DUR_ODR)
+      : threshold_g(thresholdLsb * WAKE_UP_FULL_SCALE_G / 64.0f),
+        duration(duration) {
+    const float dt = 1.0f / WAKE_UP_ODR_HZ;
+    const float rc =
+        WAKE_UP_HP_CUTOFF_DIV / (2.0f * 3.14159265f * WAKE_UP_ODR_HZ);
+    alpha = rc / (rc + dt);
+    reset();
+  }
+
+  void reset() {
+    started = false;
+    above = 0;
+  }
+
+  /**
+   * @brief Feed one accelerometer sample at WAKE_UP_ODR_HZ.
+   * @return True on the samples where the engine flags a wake-up.
+   */
+  bool update(float ax_g, float ay_g, float az_g) {
+    const float in[3] = {ax_g, ay_g, az_g};
+    bool over = false;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      if (!started) {
+        last[axis] = in[axis];
+        out[axis] = 0.0f;
+      }
+      out[axis] = alpha * (out[axis] + in[axis] - last[axis]);
+      last[axis] = in[axis];
+      if (fabsf(out[axis]) > threshold_g) {
+        over = true;
+      }
+    }
+    started = true;
+
+    if (!over) {
+      above = 0;
+      return false;
+    }
+    if (above <= duration) {
+      above++;
+    }
+    return above > duration;
+  }
+
+  float getThreshold_g() const { return threshold_g; }
+
+private:
+  float threshold_g;
+  uint8_t duration;
+  float alpha;
+  bool started;
+  uint8_t above; // consecutive samples over the threshold, up to duration + 1
+  float last[3];
+  float out[3];
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "LSM6DSOXSensorHub.h"
+
+// LSM6DSOX registers, main bank
+#define FUNC_CFG_ACCESS 0x01
+#define FIFO_CTRL3 0x09
+#define FIFO_CTRL4 0x0A
+#define CTRL1_XL 0x10
+#define CTRL2_G 0x11
+#define CTRL3_C 0x12
+#define STATUS_MASTER_MAINPAGE 0x39
+#define FIFO_STATUS1 0x3A
+#define FIFO_DATA_OUT_TAG 0x78
+
+// LSM6DSOX registers, sensor hub bank
+#define SENSOR_HUB_1 0x02
+#define MASTER_CONFIG 0x14
+#define SLV0_ADD 0x15
+#define SLV0_SUBADD 0x16
+#define SLV0_CONFIG 0x17
+#define DATAWRITE_SLV0 0x21
+
+#define SHUB_REG_ACCESS 0x40  // FUNC_CFG_ACCESS
+#define CTRL1_XL_104_HZ_16_G 0x44
+#define CTRL2_G_104_HZ_2000_DPS 0x4C
+#define CTRL3_C_BDU_IF_INC 0x44
+#define MASTER_ON 0x04         // MASTER_CONFIG
+#define WRITE_ONCE 0x40        // MASTER_CONFIG
+#define RST_MASTER_REGS 0x80   // MASTER_CONFIG
+#define SENS_HUB_ENDOP 0x01    // STATUS_MASTER_MAINPAGE
+#define WR_ONCE_DONE 0x80      // STATUS_MASTER_MAINPAGE
+#define SHUB_ODR_52_HZ 0x40    // SLV0_CONFIG
+#define BATCH_EXT_SENS_0 0x08  // SLV0_CONFIG
+#define FIFO_BDR_104_HZ 0x44   // FIFO_CTRL3, gyroscope and accelerometer
+#define FIFO_T_1_6_HZ 0x10     // FIFO_CTRL4
+#define FIFO_CONTINUOUS 0x06   // FIFO_CTRL4
+#define FIFO_OVR_LATCHED 0x08  // FIFO_STATUS2
+#define FIFO_WORD_BYTES 7      // tag and three axes
+#define FIFO_BURST_WORDS 4     // fits the 32 byte Wire buffer
+
+// FIFO tags, the top five bits of the tag byte
+#define TAG_GYRO 0x01
+#define TAG_ACCEL 0x02
+#define TAG_TEMPERATURE 0x03
+#define TAG_SLAVE0 0x0E
+
+// LIS3MDL registers
+#define LIS3MDL_WHO_AM_I 0x0F
+#define LIS3MDL_ID 0x3D
+#define LIS3MDL_CTRL_REG1 0x20
+#define LIS3MDL_OUT_X_L 0x28
+#define LIS3MDL_AUTO_INCREMENT 0x80 // set in the register address
+
+#define ACCEL_G_PER_LSB 0.000488f // +-16 g
+#define GYRO_DPS_PER_LSB 0.070f   // 2000 dps
+#define MAG_LSB_PER_UT 68.42f     // +-4 gauss
+#define TEMPERATURE_LSB_PER_C 256.0f
+#define TEMPERATURE_OFFSET_C 25.0f
+
+#define HUB_TIMEOUT_MS 100
+
+LSM6DSOXSensorHub::LSM6DSOXSensorHub(uint8_t imuAddress, uint8_t magAddress)
+    : device(NULL), imuAddress(imuAddress), magAddress(magAddress),
+      gyroCount(0), accelCount(0), newMag(false),
+      temperature_c(TEMPERATURE_OFFSET_C), overruns(0) {
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    latestGyro_dps[axis] = 0.0f;
+    latestAccel_g[axis] = 0.0f;
+    mag_uT[axis] = 0.0f;
+  }
+}
+
+bool LSM6DSOXSensorHub::begin(TwoWire *wire) {
+  device = new Adafruit_I2CDevice(imuAddress, wire);
+  if (!device->begin()) {
+    return false;
+  }
+
+  // Samples are only decoded at these settings. Block data update keeps the
+  // bytes of one output sample together
+  if (!writeRegister(CTRL1_XL, CTRL1_XL_104_HZ_16_G) ||
+      !writeRegister(CTRL2_G, CTRL2_G_104_HZ_2000_DPS) ||
+      !writeRegister(CTRL3_C, CTRL3_C_BDU_IF_INC)) {
+    return false;
+  }
+
+  // Clear whatever the hub was doing before a reset of the STM32
+  selectHubBank(true);
+  writeRegister(MASTER_CONFIG, RST_MASTER_REGS);
+  writeRegister(MASTER_CONFIG, 0);
+  selectHubBank(false);
+
+  uint8_t id = 0;
+  if (!readMagRegister(LIS3MDL_WHO_AM_I, &id) || id != LIS3MDL_ID) {
+    return false;
+  }
+
+  // CTRL_REG1 to CTRL_REG5: x, y and z in ultra-high performance mode at
+  // 80 Hz, the slowest rate with a new reading for every 52 Hz hub read,
+  // +-4 gauss, continuous conversion and block data update
+  const uint8_t magConfig[5] = {0x7C, 0x00, 0x00, 0x0C, 0x40};
+  for (uint8_t i = 0; i < 5; i++) {
+    if (!writeMagRegister(LIS3MDL_CTRL_REG1 + i, magConfig[i])) {
+      return false;
+    }
+  }
+
+  // From here on the hub reads the six output bytes on every other
+  // accelerometer sample and batches them into the FIFO
+  selectHubBank(true);
+  writeRegister(SLV0_ADD, (magAddress << 1) | 1);
+  writeRegister(SLV0_SUBADD, LIS3MDL_OUT_X_L | LIS3MDL_AUTO_INCREMENT);
+  writeRegister(SLV0_CONFIG, SHUB_ODR_52_HZ | BATCH_EXT_SENS_0 | 6);
+  writeRegister(MASTER_CONFIG, MASTER_ON);
+  selectHubBank(false);
+
+  return writeRegister(FIFO_CTRL3, FIFO_BDR_104_HZ) &&
+         writeRegister(FIFO_CTRL4, FIFO_T_1_6_HZ | FIFO_CONTINUOUS);
+}
+
+uint16_t LSM6DSOXSensorHub::read() {
+  uint8_t status[2];
+  if (!readRegisters(FIFO_STATUS1, status, 2)) {
+    return getSampleCount();
+  }
+  if (status[1] & FIFO_OVR_LATCHED) {
+    overruns++;
+  }
+
+  // Every sample takes a gyroscope and an accelerometer word, so this many
+  // words never overfill the buffer
+  uint16_t words = status[0] | ((status[1] & 0x03) << 8);
+  uint16_t held = gyroCount > accelCount ? gyroCount : accelCount;
+  uint16_t room = (SENSOR_HUB_MAX_SAMPLES - held) * 2;
+  if (words > room) {
+    words = room;
+  }
+
+  uint8_t buffer[FIFO_BURST_WORDS * FIFO_WORD_BYTES];
+  while (words > 0) {
+    uint8_t burst = words > FIFO_BURST_WORDS ? FIFO_BURST_WORDS : words;
+    // The FIFO output address wraps back to the tag, so every burst starts
+    // at the next word
+    if (!readRegisters(FIFO_DATA_OUT_TAG, buffer, burst * FIFO_WORD_BYTES)) {
+      break;
+    }
+    words -= burst;
+
+    for (uint8_t w = 0; w < burst; w++) {
+      const uint8_t *word = &buffer[w * FIFO_WORD_BYTES];
+      int16_t raw[3];
+      for (uint8_t axis = 0; axis < 3; axis++) {
+        raw[axis] = (int16_t)(word[2 * axis + 1] | (word[2 * axis + 2] << 8));
+      }
+
+      switch (word[0] >> 3) {
+      case TAG_GYRO:
+        for (uint8_t axis = 0; axis < 3; axis++) {
+          latestGyro_dps[axis] = raw[axis] * GYRO_DPS_PER_LSB;
+          if (gyroCount < SENSOR_HUB_MAX_SAMPLES) {
+            gyro_dps[gyroCount][axis] = latestGyro_dps[axis];
+          }
+        }
+        if (gyroCount < SENSOR_HUB_MAX_SAMPLES) {
+          gyroCount++;
+        }
+        break;
+      case TAG_ACCEL:
+        for (uint8_t axis = 0; axis < 3; axis++) {
+          latestAccel_g[axis] = raw[axis] * ACCEL_G_PER_LSB;
+          if (accelCount < SENSOR_HUB_MAX_SAMPLES) {
+            accel_g[accelCount][axis] = latestAccel_g[axis];
+          }
+        }
+        if (accelCount < SENSOR_HUB_MAX_SAMPLES) {
+          accelCount++;
+        }
+        break;
+      case TAG_SLAVE0:
+        for (uint8_t axis = 0; axis < 3; axis++) {
+          mag_uT[axis] = raw[axis] / MAG_LSB_PER_UT;
+        }
+        newMag = true;
+        break;
+      case TAG_TEMPERATURE:
+        temperature_c = raw[0] / TEMPERATURE_LSB_PER_C + TEMPERATURE_OFFSET_C;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  return getSampleCount();
+}
+
+void LSM6DSOXSensorHub::consume(uint16_t n) {
+  if (n > getSampleCount()) {
+    n = getSampleCount();
+  }
+  for (uint16_t i = n; i < gyroCount; i++) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      gyro_dps[i - n][axis] = gyro_dps[i][axis];
+    }
+  }
+  for (uint16_t i = n; i < accelCount; i++) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      accel_g[i - n][axis] = accel_g[i][axis];
+    }
+  }
+  gyroCount -= n;
+  accelCount -= n;
+}
+
+uint16_t LSM6DSOXSensorHub::getSampleCount() const {
+  return gyroCount < accelCount ? gyroCount : accelCount;
+}
+
+void LSM6DSOXSensorHub::getSample(uint16_t i, float gyro[3],
+                                  float accel[3]) const {
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    gyro[axis] = gyro_dps[i][axis];
+    accel[axis] = accel_g[i][axis];
+  }
+}
+
+void LSM6DSOXSensorHub::getLatest(float gyro[3], float accel[3]) const {
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    gyro[axis] = latestGyro_dps[axis];
+    accel[axis] = latestAccel_g[axis];
+  }
+}
+
+bool LSM6DSOXSensorHub::getMag(float mag[3]) {
+  if (!newMag) {
+    return false;
+  }
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    mag[axis] = mag_uT[axis];
+  }
+  newMag = false;
+  return true;
+}
+
+bool LSM6DSOXSensorHub::writeRegister(uint8_t reg, uint8_t value) {
+  uint8_t buffer[2] = {reg, value};
+  return device->write(buffer, 2);
+}
+
+bool LSM6DSOXSensorHub::readRegisters(uint8_t reg, uint8_t *buffer,
+                                      uint8_t length) {
+  return device->write_then_read(&reg, 1, buffer, length);
+}
+
+bool LSM6DSOXSensorHub::selectHubBank(bool hub) {
+  return writeRegister(FUNC_CFG_ACCESS, hub ? SHUB_REG_ACCESS : 0);
+}
+
+bool LSM6DSOXSensorHub::waitForHub(uint8_t flag) {
+  uint32_t start = millis();
+  uint8_t status = 0;
+  while (millis() - start < HUB_TIMEOUT_MS) {
+    if (readRegisters(STATUS_MASTER_MAINPAGE, &status, 1) && (status & flag)) {
+      return true;
+    }
+    delay(1);
+  }
+  return false;
+}
+
+bool LSM6DSOXSensorHub::writeMagRegister(uint8_t reg, uint8_t value) {
+  // Reading the status clears a flag left from an earlier transfer
+  uint8_t status;
+  readRegisters(STATUS_MASTER_MAINPAGE, &status, 1);
+
+  selectHubBank(true);
+  writeRegister(SLV0_ADD, magAddress << 1);
+  writeRegister(SLV0_SUBADD, reg);
+  writeRegister(DATAWRITE_SLV0, value);
+  writeRegister(MASTER_CONFIG, WRITE_ONCE | MASTER_ON);
+  selectHubBank(false);
+
+  bool done = waitForHub(WR_ONCE_DONE);
+
+  selectHubBank(true);
+  writeRegister(MASTER_CONFIG, 0);
+  selectHubBank(false);
+  return done;
+}
+
+bool LSM6DSOXSensorHub::readMagRegister(uint8_t reg, uint8_t *value) {
+  uint8_t status;
+  readRegisters(STATUS_MASTER_MAINPAGE, &status, 1);
+
+  selectHubBank(true);
+  writeRegister(SLV0_ADD, (magAddress << 1) | 1);
+  writeRegister(SLV0_SUBADD, reg);
+  writeRegister(SLV0_CONFIG, 1);
+  writeRegister(MASTER_CONFIG, MASTER_ON);
+  selectHubBank(false);
+
+  bool done = waitForHub(SENS_HUB_ENDOP);
+
+  selectHubBank(true);
+  if (done) {
+    done = readRegisters(SENSOR_HUB_1, value, 1);
+  }
+  writeRegister(MASTER_CONFIG, 0);
+  selectHubBank(false);
+  return done;
+}
@@ -0,0 +1,59 @@
+#include "LSM6DSOXWakeUp.h"
+
+// LSM6DSOX registers
+#define CTRL8_XL 0x17
+#define WAKE_UP_SRC 0x1B
+#define TAP_CFG0 0x56
+#define TAP_CFG2 0x58
+#define WAKE_UP_THS 0x5B
+#define WAKE_UP_DUR 0x5C
+#define MD1_CFG 0x5E
+
+#define HPCF_XL_ODR_DIV_400 0xC0 // CTRL8_XL, output data path unchanged
+#define LIR 0x01                 // TAP_CFG0, latch the event
+#define SLOPE_FDS 0x10           // TAP_CFG0, high-pass instead of slope
+#define INT_CLR_ON_READ 0x40     // TAP_CFG0, reading WAKE_UP_SRC clears it
+#define INTERRUPTS_ENABLE 0x80   // TAP_CFG2
+#define INT1_WU 0x20             // MD1_CFG
+#define WU_IA 0x08               // WAKE_UP_SRC
+#define WAKE_DUR_SHIFT 5         // WAKE_UP_DUR
+
+LSM6DSOXWakeUp::LSM6DSOXWakeUp(uint8_t imuAddress)
+    : device(NULL), imuAddress(imuAddress) {}
+
+bool LSM6DSOXWakeUp::begin(TwoWire *wire, uint8_t thresholdLsb,
+                           uint8_t duration) {
+  device = new Adafruit_I2CDevice(imuAddress, wire);
+  if (!device->begin()) {
+    return false;
+  }
+
+  if (thresholdLsb > 0x3F) {
+    thresholdLsb = 0x3F;
+  }
+  if (duration > 3) {
+    duration = 3;
+  }
+
+  // WAKE_THS_W stays clear so the threshold is in FS / 64 steps
+  return writeRegister(CTRL8_XL, HPCF_XL_ODR_DIV_400) &&
+         writeRegister(WAKE_UP_THS, thresholdLsb) &&
+         writeRegister(WAKE_UP_DUR, duration << WAKE_DUR_SHIFT) &&
+         writeRegister(TAP_CFG0, INT_CLR_ON_READ | SLOPE_FDS | LIR) &&
+         writeRegister(TAP_CFG2, INTERRUPTS_ENABLE) &&
+         writeRegister(MD1_CFG, INT1_WU);
+}
+
+bool LSM6DSOXWakeUp::poll() {
+  uint8_t reg = WAKE_UP_SRC;
+  uint8_t source = 0;
+  if (!device->write_then_read(&reg, 1, &source, 1)) {
+    return false;
+  }
+  return (source & WU_IA) != 0;
+}
+
+bool LSM6DSOXWakeUp::writeRegister(uint8_t reg, uint8_t value) {
+  uint8_t buffer[2] = {reg, value};
+  return device->write(buffer, 2);
+}
@@ -0,0 +1,92 @@
+#ifndef APOGEE_DETECTOR_H
+#define APOGEE_DETECTOR_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+#include "VerticalChannel.h"
+
+/**
+ * @brief Detects apogee from the vertical velocity zero crossing, confirmed by
+ * a falling barometric altitude trend.
+ *
+ * Vertical velocity and altitude come from a two-state complementary filter:
+ * the accelerometer is integrated every sample and the barometer pulls the
+ * estimate back whenever a new altitude is available. Every call does a fixed
+ * amount of work (no loops, no history buffers) so the cost per sample is
+ * bounded regardless of flight length.
+ */
+class ApogeeDetector {
+public:
+  /**
+   * @param minAscentVelocity_ms Velocity that must be exceeded before a zero
+   * crossing counts as apogee. Rejects pad noise and weak motors.
+   * @param baroDropThreshold_m How far the barometric altitude must fall below
+   * its maximum before the baro trend agrees that we are descending.
+   * @param baroDescendingSamples Number of consecutive falling baro samples
+   * required by the trend test.
+   */
+  ApogeeDetector(float minAscentVelocity_ms = 30.0f,
+                 float baroDropThreshold_m = 3.0f,
+                 uint8_t baroDescendingSamples = 3);
+
+  /**
+   * @brief Start tracking the flight. Call once when launch is detected. The
+   * velocity and altitude start from the motion since liftoff, which update()
+   * follows before arming.
+   */
+  void arm(uint32_t launchTime_ms);
+
+  /**
+   * @brief Integrate one accelerometer sample. Call it on the pad too.
+   * @param verticalAccel Specific force along the up axis in m/s^2. Reads
+   * +9.81 on the pad.
+   */
+  void update(DataPoint verticalAccel);
+
+  /**
+   * @brief Fold in a fresh barometric altitude (m). Before arming this only
+   * tracks the pad altitude.
+   */
+  void updateAltitude(DataPoint altitude);
+
+  bool isArmed() const { return armed; }
+  bool isApogeeDetected() const { return apogeeDetected; }
+
+  // Time the detector declared apogee (both tests agree)
+  uint32_t getApogeeTime() const { return apogeeTime_ms; }
+  // Time the velocity estimate crossed zero, our best guess at true apogee
+  uint32_t getVelocityZeroCrossingTime() const { return zeroCrossingTime_ms; }
+
+  float getVerticalVelocity() const { return velocity_ms; }
+  float getAltitude() const { return altitude_m; }
+  float getMaxBaroAltitude() const { return maxBaroAltitude_m; }
+
+private:
+  void checkApogee(uint32_t time_ms);
+
+  float minAscentVelocity_ms;
+  float baroDropThreshold_m;
+  uint8_t baroDescendingSamples;
+
+  bool armed;
+  bool apogeeDetected;
+  bool ascentVelocityReached;
+  bool velocityCrossed;
+  bool baroDescending;
+
+  bool hasAccel;
+  LiftoffIntegrator liftoff; // motion since the last sample at rest
+  uint32_t lastAccelTime_ms;
+  uint32_t apogeeTime_ms;
+  uint32_t zeroCrossingTime_ms;
+
+  float velocity_ms;
+  float altitude_m;
+  float padAltitude_m; // baro altitude at the last sample at rest
+
+  float lastBaroAltitude_m;
+  float maxBaroAltitude_m;
+  uint8_t descendingCount;
+};
+
+#endif
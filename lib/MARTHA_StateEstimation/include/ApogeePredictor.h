@@ -0,0 +1,53 @@
+#ifndef APOGEE_PREDICTOR_H
+#define APOGEE_PREDICTOR_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+
+/**
+ * @brief Predicts the time of apogee during coast.
+ *
+ * After burnout the only forces are gravity and drag, so the accelerometer
+ * reads the drag deceleration directly. Assuming quadratic drag (a = -g - k*v^2)
+ * the drag coefficient k is estimated from each sample and smoothed, and the
+ * closed-form time to apogee is
+ *
+ *     t = atan(v * sqrt(k / g)) / sqrt(k * g)
+ *
+ * which falls back to v / g as k goes to zero. Each update costs one sqrt and
+ * one atan, independent of flight length.
+ */
+class ApogeePredictor {
+public:
+  /**
+   * @param minVelocity_ms Below this velocity k is not re-estimated because
+   * drag is too small to measure against accelerometer noise.
+   * @param dragSmoothing Weight of each new drag estimate (0..1).
+   */
+  ApogeePredictor(float minVelocity_ms = 20.0f, float dragSmoothing = 0.1f);
+
+  /**
+   * @brief Update the prediction.
+   * @param verticalAccel Specific force along the up axis in m/s^2.
+   * @param verticalVelocity_ms Current vertical velocity estimate.
+   */
+  void update(DataPoint verticalAccel, float verticalVelocity_ms);
+
+  // True once coast has been seen and a prediction is available
+  bool isPredictionValid() const { return predictionValid; }
+  uint32_t getPredictedApogeeTime() const { return predictedApogeeTime_ms; }
+  float getTimeToApogee() const { return timeToApogee_s; }
+  float getDragCoefficient() const { return dragCoefficient; }
+
+private:
+  float minVelocity_ms;
+  float dragSmoothing;
+
+  bool coasting;
+  bool predictionValid;
+  float dragCoefficient; // k in a_drag = k * v^2 (1/m)
+  float timeToApogee_s;
+  uint32_t predictedApogeeTime_ms;
+};
+
+#endif
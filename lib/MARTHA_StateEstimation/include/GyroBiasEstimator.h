@@ -0,0 +1,75 @@
+#ifndef GYRO_BIAS_ESTIMATOR_H
+#define GYRO_BIAS_ESTIMATOR_H
+
+#include <stdint.h>
+
+/**
+ * @brief Gyro offset estimate from the readings taken while the rocket sits
+ * still on the pad.
+ *
+ * Started from zero the fusion filter spends the first seconds of flight
+ * learning the gyro offset, with the attitude off by however far the offset
+ * has integrated. On the pad the true rate is zero, so the mean gyro reading
+ * is the offset. This accumulates that mean and its variance one reading at a
+ * time (Welford's method) and hands both to the filter before launch.
+ *
+ * A reading only counts while the median acceleration magnitude is within a
+ * tolerance of 1 g, and once the estimate is ready while it stays close to the
+ * mean, so handling the rocket on the pad does not leak into the offset. After
+ * the window fills the weight of new readings stops shrinking, which turns the
+ * mean into a moving average that follows the offset as the board warms up.
+ */
+class GyroBiasEstimator {
+public:
+  /**
+   * @param tolerance_ms2 Largest difference between the median acceleration
+   * magnitude and 1 g that counts as stationary.
+   * @param maxDeviation_dps Largest difference of a reading from the mean
+   * that is not taken as motion, once the estimate is ready.
+   * @param minSamples Readings before the estimate is ready.
+   * @param window Readings the moving average spans once it is full.
+   */
+  GyroBiasEstimator(float tolerance_ms2 = 0.5f, float maxDeviation_dps = 3.0f,
+                    uint16_t minSamples = 500, uint16_t window = 4096);
+
+  /**
+   * @param medianAccelSquared Median squared acceleration magnitude in
+   * (m/s^2)^2, from LaunchPredictor.
+   * @param gx Gyroscope x axis in deg/s.
+   * @param gy Gyroscope y axis in deg/s.
+   * @param gz Gyroscope z axis in deg/s.
+   */
+  void update(float medianAccelSquared, float gx, float gy, float gz);
+
+  void reset();
+
+  bool isReady() const { return count >= minSamples; }
+  // The moving average window is full, the estimate is as tight as it gets
+  bool isSettled() const { return count >= window; }
+  uint16_t getSampleCount() const { return count; }
+
+  /**
+   * @brief The gyro offset, the mean reading while stationary, in deg/s.
+   */
+  float getBias(uint8_t axis) const { return mean[axis]; }
+
+  /**
+   * @brief Variance of the offset estimate in (deg/s)^2, the largest of the
+   * three axes. This is the reading variance over the number of readings
+   * averaged, so it is what the fusion filter should assume for the seed.
+   */
+  float getBiasVariance() const;
+
+private:
+  float stationaryMin;   // smallest stationary squared magnitude (m/s^2)^2
+  float stationaryMax;   // largest stationary squared magnitude (m/s^2)^2
+  float maxDeviation_dps;
+  uint16_t minSamples;
+  uint16_t window;
+
+  uint16_t count;  // readings averaged, saturates at window
+  float mean[3];   // running mean (deg/s)
+  float m2[3];     // running sum of squared deviations from the mean
+};
+
+#endif
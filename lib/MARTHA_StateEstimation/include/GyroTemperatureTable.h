@@ -0,0 +1,82 @@
+#ifndef GYRO_TEMPERATURE_TABLE_H
+#define GYRO_TEMPERATURE_TABLE_H
+
+#include <stdint.h>
+
+// Bins of the table, every 5 C from -20 C to 70 C. Outside that range the
+// offset of the nearest end is used
+#define GYRO_TEMP_TABLE_MIN_C -20.0f
+#define GYRO_TEMP_TABLE_STEP_C 5.0f
+#define GYRO_TEMP_TABLE_BINS 19
+
+/**
+ * @brief Gyro offset against IMU temperature, per axis.
+ *
+ * The gyro offset drifts as the board warms up on the pad and cools in
+ * flight. Rather than leaving that drift for the fusion filter to chase, the
+ * offset is learned into a table of temperature bins while the rocket sits
+ * still and is subtracted from every reading by linear interpolation between
+ * the two bins around the current temperature.
+ *
+ * learn() averages offset estimates (e.g. from GyroBiasEstimator) into the
+ * nearest bin and refills the bins that have not been learned from their
+ * learned neighbours, so getBias() is a fixed handful of operations. The
+ * learned bins are kept in a plain struct so the firmware can write them to
+ * the SD card and load them on the next boot.
+ */
+class GyroTemperatureTable {
+public:
+  /**
+   * @brief The learned part of the table, as stored on the SD card.
+   */
+  struct Data {
+    uint32_t magic;                       // GYRO_TEMP_TABLE_MAGIC when valid
+    float bias[GYRO_TEMP_TABLE_BINS][3];  // mean offset per bin (deg/s)
+    uint16_t count[GYRO_TEMP_TABLE_BINS]; // estimates averaged per bin
+  };
+
+  /**
+   * @param maxCount Estimates a bin averages before its weight stops
+   * shrinking, so a bin still follows a slowly changing offset.
+   */
+  GyroTemperatureTable(uint16_t maxCount = 64);
+
+  void reset();
+
+  /**
+   * @brief Average an offset estimate into the bin nearest the temperature.
+   * @param temperature_c IMU temperature in C.
+   * @param bias_dps Offset of the x, y and z axes in deg/s.
+   */
+  void learn(float temperature_c, const float bias_dps[3]);
+
+  /**
+   * @brief The interpolated offset at a temperature, zero until a bin has
+   * been learned.
+   * @param temperature_c IMU temperature in C.
+   * @param bias_dps Written with the offset of the x, y and z axes in deg/s.
+   */
+  void getBias(float temperature_c, float bias_dps[3]) const;
+
+  bool isEmpty() const { return learnedBins == 0; }
+  uint8_t getLearnedBins() const { return learnedBins; }
+
+  const Data &getData() const { return data; }
+
+  /**
+   * @brief Replace the table with one loaded from storage.
+   * @return False, leaving the table unchanged, if the data is not a table.
+   */
+  bool setData(const Data &loaded);
+
+private:
+  // Recompute the lookup bins from the learned ones
+  void fill();
+
+  uint16_t maxCount;
+  uint8_t learnedBins;
+  Data data;
+  float lookup[GYRO_TEMP_TABLE_BINS][3]; // every bin, learned or filled in
+};
+
+#endif
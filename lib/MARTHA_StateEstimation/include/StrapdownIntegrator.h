@@ -0,0 +1,79 @@
+#ifndef STRAPDOWN_INTEGRATOR_H
+#define STRAPDOWN_INTEGRATOR_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+#include "VerticalChannel.h"
+
+/**
+ * @brief Dead reckoning of velocity and position in the NED frame from the
+ * linear acceleration of the fusion filter.
+ *
+ * The fusion filter already rotates each accelerometer reading into the
+ * global frame and takes gravity out (aGlPl), so what is left is plain
+ * integration. The acceleration is taken as linear between updates: velocity
+ * is the trapezoid of the last two readings and position the exact integral
+ * of that linear velocity change, so a constant jerk adds no error. Sculling
+ * corrections belong to integrating in the body frame and have nothing left to
+ * correct once the filter has done the rotation.
+ *
+ * Like ApogeeDetector, the down axis is pulled toward the barometer whenever
+ * a new altitude comes in (a complementary filter on the baro innovation), so
+ * vertical drift stays bounded while north and east are pure dead reckoning.
+ * Every call does a fixed amount of work with no history buffers.
+ */
+class StrapdownIntegrator {
+public:
+  /**
+   * @param baroPositionGain Part of the baro innovation added to the down
+   * position on each new altitude.
+   * @param baroVelocityGain Gain from the baro innovation (m) to the down
+   * velocity (m/s) on each new altitude.
+   */
+  StrapdownIntegrator(float baroPositionGain = BARO_POSITION_GAIN,
+                      float baroVelocityGain = BARO_VELOCITY_GAIN);
+
+  /**
+   * @brief Start integrating. Call once when launch is detected. The down
+   * velocity and position start from the motion since liftoff, which update()
+   * follows before arming. North and east start at zero: on the rail the
+   * rocket barely moves sideways before detection.
+   */
+  void arm();
+
+  /**
+   * @brief Integrate one fusion update. Call it on the pad too.
+   * @param dt_s Time since the previous update in s.
+   * @param aN_g Linear acceleration (gravity removed) along north in g.
+   * @param aE_g Along east in g.
+   * @param aD_g Along down in g.
+   */
+  void update(float dt_s, float aN_g, float aE_g, float aD_g);
+
+  /**
+   * @brief Fold in a fresh barometric altitude (m). Before arming this only
+   * tracks the pad altitude the position is measured from, until the rocket
+   * starts moving.
+   */
+  void updateAltitude(DataPoint altitude);
+
+  bool isArmed() const { return armed; }
+
+  // NED, relative to the pad, in m/s and m
+  float getVelocity(uint8_t axis) const { return velocity_ms[axis]; }
+  float getPosition(uint8_t axis) const { return position_m[axis]; }
+  float getAltitude() const { return -position_m[2]; }
+
+private:
+  float baroPositionGain;
+  float baroVelocityGain;
+
+  bool armed;
+  LiftoffIntegrator liftoff; // up motion since the last update at rest
+  float padAltitude_m;
+  float lastAccel_ms2[3];
+  float velocity_ms[3];
+  float position_m[3];
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef VERTICAL_CHANNEL_H
+#define VERTICAL_CHANNEL_H
+
+// Shared by the vertical estimators (ApogeeDetector, ApogeePredictor,
+// StrapdownIntegrator) so they cannot drift apart
+
+#define GRAVITY_MS2 9.80665f
+
+// Integrators ignore gaps longer than this (e.g. a stalled I2C read) rather
+// than integrating one huge step
+#define MAX_INTEGRATION_DT_S 0.1f
+
+// Complementary filter gains applied to the baro innovation each baro sample
+#define BARO_POSITION_GAIN 0.10f
+#define BARO_VELOCITY_GAIN 0.02f
+
+/**
+ * @brief One step with the acceleration linear from a0 to a1: velocity gains
+ * the trapezoid and position v0 dt + (2 a0 + a1) dt^2 / 6, so a constant jerk
+ * adds no error.
+ */
+inline void integrateLinearAccel(float dt_s, float a0, float a1,
+                                 float &position, float &velocity) {
+  position += velocity * dt_s + (2.0f * a0 + a1) * dt_s * dt_s * (1.0f / 6.0f);
+  velocity += 0.5f * (a0 + a1) * dt_s;
+}
+
+/**
+ * @brief Pull a position and velocity toward the barometer.
+ * @param innovation Baro position minus the estimate, in the same axis and
+ * sign as position.
+ */
+inline void applyBaroCorrection(float innovation, float &position,
+                                float &velocity,
+                                float positionGain = BARO_POSITION_GAIN,
+                                float velocityGain = BARO_VELOCITY_GAIN) {
+  position += positionGain * innovation;
+  velocity += velocityGain * innovation;
+}
+
+/**
+ * @brief Vertical velocity and height gained since the accelerometer last read
+ * 1 g, the motion launch detection has already missed.
+ *
+ * The launch predictor only fires once most of its median window sees thrust,
+ * about half a window after liftoff, when the rocket is already moving fast.
+ * Fed every sample before launch, this integrates the vertical linear
+ * acceleration and starts over whenever it is within a tolerance of zero, so
+ * at detection it holds the motion since the last sample at rest, which is
+ * liftoff. Estimators seed their state from it when they arm.
+ *
+ * Pad noise and handling only accumulate until the next still sample. Fixed
+ * work per sample and no history buffer.
+ */
+class LiftoffIntegrator {
+public:
+  /**
+   * @param stillTolerance_ms2 Largest vertical linear acceleration taken as
+   * being at rest.
+   */
+  LiftoffIntegrator(float stillTolerance_ms2 = 2.0f);
+
+  /**
+   * @param dt_s Time since the previous sample in s.
+   * @param linearAccel_ms2 Vertical acceleration with gravity removed, up
+   * positive, in m/s^2.
+   */
+  void update(float dt_s, float linearAccel_ms2);
+
+  void reset();
+
+  // Up, since the last sample at rest, in m/s and m
+  float getVelocity() const { return velocity_ms; }
+  float getHeight() const { return height_m; }
+
+private:
+  float stillTolerance_ms2;
+  float lastAccel_ms2;
+  float velocity_ms;
+  float height_m;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef VERTICAL_LAUNCH_DETECTOR_H
+#define VERTICAL_LAUNCH_DETECTOR_H
+
+#include <stdint.h>
+#include "data_handling/DataPoint.h"
+
+/**
+ * @brief Launch and boost detection on the vertical component of the
+ * global-frame linear acceleration from the fusion filter.
+ *
+ * Gravity is already removed and the acceleration is projected onto the
+ * vertical, so the threshold only has to clear pad noise rather than 1 g plus
+ * whatever the rocket's lean adds to the magnitude. That lets it fire earlier
+ * and on a smaller threshold than the magnitude-based LaunchPredictor. A tilt
+ * gate rejects a rocket being carried or knocked over.
+ *
+ * The detector needs a handful of samples inside its sustain window and no
+ * more, so it tells the caller how often to run the fusion filter.
+ */
+class VerticalLaunchDetector {
+public:
+  /**
+   * @param threshold_g Upward linear acceleration that counts as launch.
+   * @param sustain_ms How long the threshold must be held.
+   * @param maxTilt_deg Largest angle of the rocket axis from vertical that
+   * still counts as a launch.
+   */
+  VerticalLaunchDetector(float threshold_g = 1.5f, uint16_t sustain_ms = 100,
+                         float maxTilt_deg = 30.0f);
+
+  /**
+   * @param upAccel Upward linear acceleration in g (gravity removed).
+   * @param tilt_deg Angle between the rocket axis and vertical.
+   */
+  void update(DataPoint upAccel, float tilt_deg);
+
+  bool isLaunched() const { return launched; }
+  bool isBoosting() const { return launched && !burnout; }
+  uint32_t getLaunchedTime() const { return launchedTime_ms; }
+  uint32_t getBurnoutTime() const { return burnoutTime_ms; }
+
+  /**
+   * @brief How often the fusion filter must run to feed this detector.
+   */
+  uint16_t getFusionInterval_ms() const { return fusionInterval_ms; }
+
+private:
+  float threshold_g;
+  uint16_t sustain_ms;
+  float maxTilt_deg;
+  uint16_t fusionInterval_ms;
+
+  bool aboveThreshold;
+  bool launched;
+  bool burnout;
+  uint32_t aboveSince_ms;
+  uint32_t launchedTime_ms;
+  uint32_t burnoutTime_ms;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "ApogeeDetector.h"
+
+ApogeeDetector::ApogeeDetector(float minAscentVelocity_ms,
+                               float baroDropThreshold_m,
+                               uint8_t baroDescendingSamples)
+    : minAscentVelocity_ms(minAscentVelocity_ms),
+      baroDropThreshold_m(baroDropThreshold_m),
+      baroDescendingSamples(baroDescendingSamples), armed(false),
+      apogeeDetected(false), ascentVelocityReached(false),
+      velocityCrossed(false), baroDescending(false), hasAccel(false),
+      lastAccelTime_ms(0), apogeeTime_ms(0), zeroCrossingTime_ms(0),
+      velocity_ms(0.0f), altitude_m(0.0f), padAltitude_m(0.0f),
+      lastBaroAltitude_m(0.0f), maxBaroAltitude_m(0.0f), descendingCount(0) {}
+
+void ApogeeDetector::arm(uint32_t launchTime_ms) {
+  if (armed) {
+    return;
+  }
+  armed = true;
+  if (!hasAccel) {
+    lastAccelTime_ms = launchTime_ms;
+  }
+  // Launch is detected well after liftoff, start from the motion since then.
+  // Measured from the pad altitude the baro innovation begins near zero
+  velocity_ms = liftoff.getVelocity();
+  altitude_m = padAltitude_m + liftoff.getHeight();
+  maxBaroAltitude_m = lastBaroAltitude_m;
+  descendingCount = 0;
+}
+
+void ApogeeDetector::update(DataPoint verticalAccel) {
+  if (apogeeDetected) {
+    return;
+  }
+
+  float dt = (verticalAccel.timestamp_ms - lastAccelTime_ms) * 0.001f;
+  lastAccelTime_ms = verticalAccel.timestamp_ms;
+  float accel = verticalAccel.data - GRAVITY_MS2;
+  if (!armed) {
+    liftoff.update(hasAccel ? dt : 0.0f, accel);
+    hasAccel = true;
+    return;
+  }
+  if (dt <= 0.0f || dt > MAX_INTEGRATION_DT_S) {
+    return;
+  }
+
+  float previousVelocity = velocity_ms;
+
+  // Trapezoid on velocity keeps the altitude estimate unbiased
+  velocity_ms += accel * dt;
+  altitude_m += 0.5f * (previousVelocity + velocity_ms) * dt;
+
+  if (velocity_ms > minAscentVelocity_ms) {
+    ascentVelocityReached = true;
+  }
+
+  if (ascentVelocityReached && !velocityCrossed && velocity_ms <= 0.0f) {
+    velocityCrossed = true;
+    zeroCrossingTime_ms = verticalAccel.timestamp_ms;
+  }
+
+  checkApogee(verticalAccel.timestamp_ms);
+}
+
+void ApogeeDetector::updateAltitude(DataPoint altitude) {
+  if (!armed) {
+    // The pad altitude stops following the baro once the rocket moves
+    if (liftoff.getHeight() == 0.0f) {
+      padAltitude_m = altitude.data;
+    }
+    lastBaroAltitude_m = altitude.data;
+    return;
+  }
+  if (apogeeDetected) {
+    return;
+  }
+
+  applyBaroCorrection(altitude.data - altitude_m, altitude_m, velocity_ms);
+
+  // Trend test: consecutive falling samples and a real drop below the max
+  if (altitude.data > maxBaroAltitude_m) {
+    maxBaroAltitude_m = altitude.data;
+  }
+  if (altitude.data < lastBaroAltitude_m) {
+    if (descendingCount < 255) {
+      descendingCount++;
+    }
+  } else {
+    descendingCount = 0;
+  }
+  lastBaroAltitude_m = altitude.data;
+
+  baroDescending =
+      descendingCount >= baroDescendingSamples &&
+      (maxBaroAltitude_m - altitude.data) >= baroDropThreshold_m;
+
+  checkApogee(altitude.timestamp_ms);
+}
+
+void ApogeeDetector::checkApogee(uint32_t time_ms) {
+  if (!apogeeDetected && velocityCrossed && baroDescending) {
+    apogeeDetected = true;
+    apogeeTime_ms = time_ms;
+  }
+}
@@ -0,0 +1,48 @@
+#include "ApogeePredictor.h"
+#include <math.h>
+#include "VerticalChannel.h"
+
+// After burnout the accelerometer only sees drag, which points down, so the
+// measured specific force along the up axis drops below zero
+#define COAST_SPECIFIC_FORCE_MS2 0.0f
+
+ApogeePredictor::ApogeePredictor(float minVelocity_ms, float dragSmoothing)
+    : minVelocity_ms(minVelocity_ms), dragSmoothing(dragSmoothing),
+      coasting(false), predictionValid(false), dragCoefficient(0.0f),
+      timeToApogee_s(0.0f), predictedApogeeTime_ms(0) {}
+
+void ApogeePredictor::update(DataPoint verticalAccel,
+                             float verticalVelocity_ms) {
+  if (!coasting) {
+    if (verticalAccel.data >= COAST_SPECIFIC_FORCE_MS2) {
+      return;
+    }
+    coasting = true;
+  }
+
+  if (verticalVelocity_ms <= 0.0f) {
+    // Past apogee: the last prediction stands
+    return;
+  }
+
+  // Drag deceleration is the negative specific force: k = a_drag / v^2
+  if (verticalVelocity_ms > minVelocity_ms) {
+    float drag = -verticalAccel.data;
+    if (drag < 0.0f) {
+      drag = 0.0f;
+    }
+    float k = drag / (verticalVelocity_ms * verticalVelocity_ms);
+    dragCoefficient += dragSmoothing * (k - dragCoefficient);
+  }
+
+  if (dragCoefficient > 1e-7f) {
+    float kg = sqrtf(dragCoefficient * GRAVITY_MS2);
+    timeToApogee_s = atanf(verticalVelocity_ms * kg / GRAVITY_MS2) / kg;
+  } else {
+    timeToApogee_s = verticalVelocity_ms / GRAVITY_MS2;
+  }
+
+  predictedApogeeTime_ms =
+      verticalAccel.timestamp_ms + (uint32_t)(timeToApogee_s * 1000.0f);
+  predictionValid = true;
+}
@@ -0,0 +1,76 @@
+#include "GyroBiasEstimator.h"
+
+#define STANDARD_GRAVITY_MS2 9.80665f
+
+GyroBiasEstimator::GyroBiasEstimator(float tolerance_ms2,
+                                     float maxDeviation_dps,
+                                     uint16_t minSamples, uint16_t window)
+    : maxDeviation_dps(maxDeviation_dps), minSamples(minSamples),
+      window(window) {
+  // Compare squared magnitudes so the median needs no square root
+  float low = STANDARD_GRAVITY_MS2 - tolerance_ms2;
+  float high = STANDARD_GRAVITY_MS2 + tolerance_ms2;
+  stationaryMin = low > 0.0f ? low * low : 0.0f;
+  stationaryMax = high * high;
+  if (this->window < 2) {
+    this->window = 2;
+  }
+  reset();
+}
+
+void GyroBiasEstimator::reset() {
+  count = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    mean[i] = 0.0f;
+    m2[i] = 0.0f;
+  }
+}
+
+void GyroBiasEstimator::update(float medianAccelSquared, float gx, float gy,
+                               float gz) {
+  if (medianAccelSquared < stationaryMin ||
+      medianAccelSquared > stationaryMax) {
+    return;
+  }
+
+  float reading[3] = {gx, gy, gz};
+  if (isReady()) {
+    for (uint8_t i = 0; i < 3; i++) {
+      float deviation = reading[i] - mean[i];
+      if (deviation > maxDeviation_dps || deviation < -maxDeviation_dps) {
+        return;
+      }
+    }
+  }
+
+  // Welford's update. Once the window is full the count stops growing, so
+  // the oldest readings fade out at the rate of a window-long average and the
+  // sum of squares decays to match
+  bool full = count >= window;
+  if (!full) {
+    count++;
+  }
+  float weight = 1.0f / count;
+  for (uint8_t i = 0; i < 3; i++) {
+    float delta = reading[i] - mean[i];
+    mean[i] += delta * weight;
+    if (full) {
+      m2[i] -= m2[i] * weight;
+    }
+    m2[i] += delta * (reading[i] - mean[i]);
+  }
+}
+
+float GyroBiasEstimator::getBiasVariance() const {
+  if (count < 2) {
+    return 0.0f;
+  }
+  float largest = m2[0];
+  for (uint8_t i = 1; i < 3; i++) {
+    if (m2[i] > largest) {
+      largest = m2[i];
+    }
+  }
+  // Variance of the readings, m2 / (n - 1), over the n readings averaged
+  return largest / ((float)(count - 1) * (float)count);
+}
@@ -0,0 +1,107 @@
+#include "GyroTemperatureTable.h"
+
+// "GTT1", bump when Data changes so old files are ignored
+#define GYRO_TEMP_TABLE_MAGIC 0x31545447UL
+
+GyroTemperatureTable::GyroTemperatureTable(uint16_t maxCount)
+    : maxCount(maxCount > 0 ? maxCount : 1) {
+  reset();
+}
+
+void GyroTemperatureTable::reset() {
+  data.magic = GYRO_TEMP_TABLE_MAGIC;
+  for (uint8_t i = 0; i < GYRO_TEMP_TABLE_BINS; i++) {
+    data.count[i] = 0;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      data.bias[i][axis] = 0.0f;
+    }
+  }
+  fill();
+}
+
+void GyroTemperatureTable::learn(float temperature_c, const float bias_dps[3]) {
+  float position =
+      (temperature_c - GYRO_TEMP_TABLE_MIN_C) / GYRO_TEMP_TABLE_STEP_C + 0.5f;
+  uint8_t bin = 0;
+  if (position >= GYRO_TEMP_TABLE_BINS - 1) {
+    bin = GYRO_TEMP_TABLE_BINS - 1;
+  } else if (position > 0.0f) {
+    bin = (uint8_t)position;
+  }
+
+  if (data.count[bin] < maxCount) {
+    data.count[bin]++;
+  }
+  float weight = 1.0f / data.count[bin];
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    data.bias[bin][axis] += (bias_dps[axis] - data.bias[bin][axis]) * weight;
+  }
+  fill();
+}
+
+void GyroTemperatureTable::getBias(float temperature_c,
+                                   float bias_dps[3]) const {
+  float position =
+      (temperature_c - GYRO_TEMP_TABLE_MIN_C) / GYRO_TEMP_TABLE_STEP_C;
+  uint8_t bin = 0;
+  float fraction = 0.0f;
+  if (position >= GYRO_TEMP_TABLE_BINS - 1) {
+    bin = GYRO_TEMP_TABLE_BINS - 2;
+    fraction = 1.0f;
+  } else if (position > 0.0f) {
+    bin = (uint8_t)position;
+    fraction = position - bin;
+  }
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    bias_dps[axis] = lookup[bin][axis] +
+                     (lookup[bin + 1][axis] - lookup[bin][axis]) * fraction;
+  }
+}
+
+bool GyroTemperatureTable::setData(const Data &loaded) {
+  if (loaded.magic != GYRO_TEMP_TABLE_MAGIC) {
+    return false;
+  }
+  data = loaded;
+  for (uint8_t i = 0; i < GYRO_TEMP_TABLE_BINS; i++) {
+    if (data.count[i] > maxCount) {
+      data.count[i] = maxCount;
+    }
+  }
+  fill();
+  return true;
+}
+
+void GyroTemperatureTable::fill() {
+  // Bins between two learned ones are interpolated, bins beyond the last
+  // learned one on either side hold its offset. Only runs when the table
+  // changes, so getBias() never searches
+  int8_t previous = -1;
+  learnedBins = 0;
+  for (uint8_t i = 0; i < GYRO_TEMP_TABLE_BINS; i++) {
+    if (data.count[i] == 0) {
+      continue;
+    }
+    learnedBins++;
+    for (uint8_t j = previous + 1; j <= i; j++) {
+      for (uint8_t axis = 0; axis < 3; axis++) {
+        if (previous < 0) {
+          lookup[j][axis] = data.bias[i][axis];
+        } else {
+          float fraction = (float)(j - previous) / (float)(i - previous);
+          lookup[j][axis] =
+              data.bias[previous][axis] +
+              (data.bias[i][axis] - data.bias[previous][axis]) * fraction;
+        }
+      }
+    }
+    previous = i;
+  }
+
+  for (uint8_t j = previous + 1; j < GYRO_TEMP_TABLE_BINS; j++) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      lookup[j][axis] = previous < 0 ? 0.0f : data.bias[previous][axis];
+    }
+  }
+}
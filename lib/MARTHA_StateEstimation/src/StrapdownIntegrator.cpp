@@ -0,0 +1,61 @@
+#include "StrapdownIntegrator.h"
+
+StrapdownIntegrator::StrapdownIntegrator(float baroPositionGain,
+                                         float baroVelocityGain)
+    : baroPositionGain(baroPositionGain), baroVelocityGain(baroVelocityGain),
+      armed(false), padAltitude_m(0.0f) {
+  for (uint8_t i = 0; i < 3; i++) {
+    lastAccel_ms2[i] = 0.0f;
+    velocity_ms[i] = 0.0f;
+    position_m[i] = 0.0f;
+  }
+}
+
+void StrapdownIntegrator::arm() {
+  if (armed) {
+    return;
+  }
+  armed = true;
+  for (uint8_t i = 0; i < 2; i++) {
+    velocity_ms[i] = 0.0f;
+    position_m[i] = 0.0f;
+  }
+  // Launch is detected well after liftoff, start from the motion since then
+  velocity_ms[2] = -liftoff.getVelocity();
+  position_m[2] = -liftoff.getHeight();
+}
+
+void StrapdownIntegrator::update(float dt_s, float aN_g, float aE_g,
+                                 float aD_g) {
+  float accel[3] = {aN_g * GRAVITY_MS2, aE_g * GRAVITY_MS2,
+                    aD_g * GRAVITY_MS2};
+
+  if (!armed) {
+    liftoff.update(dt_s, -accel[2]);
+  } else if (dt_s > 0.0f && dt_s <= MAX_INTEGRATION_DT_S) {
+    for (uint8_t i = 0; i < 3; i++) {
+      integrateLinearAccel(dt_s, lastAccel_ms2[i], accel[i], position_m[i],
+                           velocity_ms[i]);
+    }
+  }
+
+  // Kept before arming too, so the first step after launch has its start
+  for (uint8_t i = 0; i < 3; i++) {
+    lastAccel_ms2[i] = accel[i];
+  }
+}
+
+void StrapdownIntegrator::updateAltitude(DataPoint altitude) {
+  if (!armed) {
+    // The pad altitude stops following the baro once the rocket moves
+    if (liftoff.getHeight() == 0.0f) {
+      padAltitude_m = altitude.data;
+    }
+    return;
+  }
+
+  // Down is negative height above the pad
+  applyBaroCorrection(-(altitude.data - padAltitude_m) - position_m[2],
+                      position_m[2], velocity_ms[2], baroPositionGain,
+                      baroVelocityGain);
+}
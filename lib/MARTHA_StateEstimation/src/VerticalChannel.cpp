@@ -0,0 +1,26 @@
+#include "VerticalChannel.h"
+
+#include <math.h>
+
+LiftoffIntegrator::LiftoffIntegrator(float stillTolerance_ms2)
+    : stillTolerance_ms2(stillTolerance_ms2) {
+  reset();
+}
+
+void LiftoffIntegrator::reset() {
+  lastAccel_ms2 = 0.0f;
+  velocity_ms = 0.0f;
+  height_m = 0.0f;
+}
+
+void LiftoffIntegrator::update(float dt_s, float linearAccel_ms2) {
+  if (fabsf(linearAccel_ms2) <= stillTolerance_ms2) {
+    reset();
+    return;
+  }
+  if (dt_s > 0.0f && dt_s <= MAX_INTEGRATION_DT_S) {
+    integrateLinearAccel(dt_s, lastAccel_ms2, linearAccel_ms2, height_m,
+                         velocity_ms);
+  }
+  lastAccel_ms2 = linearAccel_ms2;
+}
@@ -0,0 +1,46 @@
+#include "VerticalLaunchDetector.h"
+
+// Samples wanted inside one sustain window, this sets the fusion rate
+#define SAMPLES_PER_SUSTAIN 5
+// Never ask for the fusion faster than the 104 Hz IMU can deliver
+#define MIN_FUSION_INTERVAL_MS 10
+
+VerticalLaunchDetector::VerticalLaunchDetector(float threshold_g,
+                                               uint16_t sustain_ms,
+                                               float maxTilt_deg)
+    : threshold_g(threshold_g), sustain_ms(sustain_ms),
+      maxTilt_deg(maxTilt_deg), aboveThreshold(false), launched(false),
+      burnout(false), aboveSince_ms(0), launchedTime_ms(0),
+      burnoutTime_ms(0) {
+  fusionInterval_ms = sustain_ms / SAMPLES_PER_SUSTAIN;
+  if (fusionInterval_ms < MIN_FUSION_INTERVAL_MS) {
+    fusionInterval_ms = MIN_FUSION_INTERVAL_MS;
+  }
+}
+
+void VerticalLaunchDetector::update(DataPoint upAccel, float tilt_deg) {
+  if (launched) {
+    // Motor burnout: drag and gravity take over and the rocket decelerates
+    if (!burnout && upAccel.data < 0.0f) {
+      burnout = true;
+      burnoutTime_ms = upAccel.timestamp_ms;
+    }
+    return;
+  }
+
+  if (upAccel.data < threshold_g || tilt_deg > maxTilt_deg) {
+    aboveThreshold = false;
+    return;
+  }
+
+  if (!aboveThreshold) {
+    aboveThreshold = true;
+    aboveSince_ms = upAccel.timestamp_ms;
+  }
+
+  if (upAccel.timestamp_ms - aboveSince_ms >= sustain_ms) {
+    launched = true;
+    // The burn started when the threshold was first crossed
+    launchedTime_ms = aboveSince_ms;
+  }
+}
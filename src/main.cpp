@@ -3,6 +3,7 @@
 #include <Adafruit_MPL3115A2.h>
 #include <Adafruit_LSM6DSOX.h>
 #include <Adafruit_LIS3MDL.h>
+#include <Adafruit_I2CDevice.h>
 #include <SD.h>
 
 #define DEBUG
@@ -10,7 +11,44 @@
 #include "data_handling/SensorDataHandler.h"
 #include "data_handling/DataSaverSDSerial.h"
 #include "data_handling/DataNames.h"
-#include "data_handling/LaunchPredictor.h"
+#include "StaticLaunchPredictor.h"
+#include "MarthaDataNames.h"
+#include "ApogeeDetector.h"
+#include "ApogeePredictor.h"
+#include "VerticalLaunchDetector.h"
+#include "GyroBiasEstimator.h"
+#include "GyroTemperatureTable.h"
+#include "StrapdownIntegrator.h"
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "Adafruit_AHRS_Mahony.h"
+#include "Adafruit_AHRS_MagCalibration.h"
+#include "Adafruit_AHRS_Static.h"
+#include "LSM6DSOXSensorHub.h"
+#include "LSM6DSOXWakeUp.h"
+
+// Detect launch on the vertical acceleration from the fusion filter instead
+// of the acceleration magnitude median of StaticLaunchPredictor. The fusion
+// runs either way and VerticalLaunchDetector is logged either way; leave this
+// off until a flight replay shows the filter's tilt holds up under boost
+// vibration
+// #define USE_VERTICAL_LAUNCH_DETECTOR
+
+// Run the 6DOF Mahony filter instead of the NXP Kalman filter. It is cheap
+// enough to run on every IMU sample; see tools/ahrs_mahony_compare.cpp for how
+// its tilt compares
+// #define AHRS_MAHONY
+
+// Read the magnetometer through the LSM6DSOX sensor hub and drain the IMU
+// FIFO instead of reading each sensor from the STM32. One burst then returns
+// accel, gyro and mag samples taken together. Needs the LIS3MDL wired to the
+// LSM6DSOX auxiliary bus
+// #define IMU_SENSOR_HUB
+
+// Run the loop at a slow rate on the pad until the LSM6DSOX wake-up engine
+// sees a jolt, then at full rate until launch or until it has been quiet for
+// a while. See tools/wakeup_sim.cpp for the latency after liftoff and how
+// often handling wakes it
+// #define PAD_WAKE_UP
 
 #define DEBUG Serial
 
@@ -31,19 +69,315 @@ SensorDataHandler xGyroData(GYROSCOPE_X, &dataSaverSDSerial);
 SensorDataHandler yGyroData(GYROSCOPE_Y, &dataSaverSDSerial);
 SensorDataHandler zGyroData(GYROSCOPE_Z, &dataSaverSDSerial);
 
+SensorDataHandler xMagData(MAGNETOMETER_X, &dataSaverSDSerial);
+SensorDataHandler yMagData(MAGNETOMETER_Y, &dataSaverSDSerial);
+SensorDataHandler zMagData(MAGNETOMETER_Z, &dataSaverSDSerial);
+
 // Storing these at a slower rate b/c less important
 SensorDataHandler temperatureData(TEMPERATURE, &dataSaverSDSerial);
 
 SensorDataHandler medianAccelSquared(MEDIAN_ACCELERATION_SQUARED, &dataSaverSDSerial);
 SensorDataHandler cycleRate(AVERAGE_CYCLE_RATE, &dataSaverSDSerial);
 
-LaunchPredictor launchPredictor(30, 1000, 50);
+SensorDataHandler altitudeData(ALTITUDE, &dataSaverSDSerial);
+SensorDataHandler verticalVelocity(VERTICAL_VELOCITY, &dataSaverSDSerial);
+SensorDataHandler predictedApogeeTime(PREDICTED_APOGEE_TIME, &dataSaverSDSerial);
+SensorDataHandler apogeeDetectedTime(APOGEE_DETECTED_TIME, &dataSaverSDSerial);
+SensorDataHandler apogeeUpdateMicros(APOGEE_UPDATE_MICROS, &dataSaverSDSerial);
+SensorDataHandler apogeeUpdateOverruns(APOGEE_UPDATE_OVERRUNS, &dataSaverSDSerial);
+
+// Threshold (m/s^2), window (ms), sample interval (ms). Sized at compile time
+StaticLaunchPredictor<30, 1000, 50> launchPredictor;
+ApogeeDetector apogeeDetector;
+ApogeePredictor apogeePredictor;
+
+// The filter is picked at compile time so its calls skip the vtable and its
+// getters inline
+#if defined(AHRS_MAHONY)
+Adafruit_AHRS_Static<Adafruit_Mahony> fusion;
+#else
+Adafruit_AHRS_Static<Adafruit_NXPSensorFusion> fusion;
+// Once the filter has settled on the pad, recompute the Kalman gain only every
+// few fusion updates. The attitude barely changes over that many updates
+#define FUSION_GAIN_SETTLE_S 5.0f
+#define FUSION_GAIN_REFRESH_INTERVAL 5
+SensorDataHandler fusionGainRefreshMicros(FUSION_GAIN_REFRESH_MICROS, &dataSaverSDSerial);
+#ifdef AHRS_NXP_PROFILE
+// Cycles each filter stage took, the mean and max over every logging interval
+#define FUSION_PROFILE_LOG_INTERVAL_MS 1000
+uint32_t last_profile_log_time = 0;
+SensorDataHandler fusionStageMean[NXP_STAGE_COUNT] = {
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_PREDICT, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_C, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_GAIN, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_INVERSE, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_CORRECTION, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_COVARIANCE, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MEAN + NXP_STAGE_DERIVED, &dataSaverSDSerial)};
+SensorDataHandler fusionStageMax[NXP_STAGE_COUNT] = {
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_PREDICT, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_C, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_GAIN, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_INVERSE, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_CORRECTION, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_COVARIANCE, &dataSaverSDSerial),
+    SensorDataHandler(FUSION_STAGE_CYCLES_MAX + NXP_STAGE_DERIVED, &dataSaverSDSerial)};
+#endif
+#endif
+// Threshold (g, gravity removed), sustain time (ms), max tilt from vertical (deg)
+VerticalLaunchDetector verticalLaunchDetector(1.5, 100, 30);
+SensorDataHandler verticalLinearAccel(VERTICAL_LINEAR_ACCELERATION, &dataSaverSDSerial);
+uint32_t last_fusion_time = 0;
+
+// Velocity and position in NED from the fusion filter's linear acceleration,
+// armed at launch. Integrated on every fusion update, logged at a slower rate
+StrapdownIntegrator strapdown;
+#define STRAPDOWN_LOG_INTERVAL_MS 100
+SensorDataHandler northVelocity(STRAPDOWN_VELOCITY_N, &dataSaverSDSerial);
+SensorDataHandler eastVelocity(STRAPDOWN_VELOCITY_E, &dataSaverSDSerial);
+SensorDataHandler downVelocity(STRAPDOWN_VELOCITY_D, &dataSaverSDSerial);
+SensorDataHandler northPosition(STRAPDOWN_POSITION_N, &dataSaverSDSerial);
+SensorDataHandler eastPosition(STRAPDOWN_POSITION_E, &dataSaverSDSerial);
+SensorDataHandler downPosition(STRAPDOWN_POSITION_D, &dataSaverSDSerial);
+
+// Gyro offset learned on the pad. It is handed to the fusion filter once the
+// estimate settles, so the filter starts the flight with the offset known
+// instead of converging on it during boost
+GyroBiasEstimator gyroBiasEstimator;
+#define GYRO_BIAS_SEED_INTERVAL_MS 1000
+uint32_t last_bias_seed_time = 0;
+bool gyro_offset_seeded = false;
+SensorDataHandler xGyroBias(GYROSCOPE_BIAS_X, &dataSaverSDSerial);
+SensorDataHandler yGyroBias(GYROSCOPE_BIAS_Y, &dataSaverSDSerial);
+SensorDataHandler zGyroBias(GYROSCOPE_BIAS_Z, &dataSaverSDSerial);
+
+// Gyro offset against IMU temperature. Every pad offset estimate is learned
+// into it and it is kept on the SD card between boots, so the drift as the
+// board warms up is taken out of the gyro readings before the fusion filter
+// and the logs see them
+GyroTemperatureTable gyroTemperatureTable;
+#define GYRO_TEMP_TABLE_FILE "GYROTEMP.BIN"
+#define GYRO_TEMP_TABLE_SAVE_INTERVAL_MS 60000
+uint32_t last_table_save_time = 0;
+// Opened once at boot and kept open, so a save rewrites the table in place
+// instead of deleting and recreating the file
+File gyroTemperatureTableFile;
+
+// The magnetometer runs continuously at the lowest rate that has a new sample
+// for every fusion update. The Adafruit driver sets it up, the loop reads it
+// through its own device so the data-ready flag and the three axes come in one
+// burst, and nothing is read until a new sample is there
+#define MAG_ADDRESS 0x1E
+#define MAG_STATUS_REG 0x27
+#define MAG_CTRL_REG5 0x24
+#define MAG_AUTO_INCREMENT 0x80 // set in the register address
+#define MAG_STATUS_ZYXDA 0x08   // new x, y and z sample
+#define MAG_CTRL_REG5_BDU 0x40  // hold the outputs until both bytes are read
+#define MAG_LSB_PER_UT 68.42f   // +-4 gauss range
+Adafruit_I2CDevice *magDevice = NULL;
+uint32_t last_mag_time = 0;
+float mag_uT[3] = {0.0f, 0.0f, 0.0f}; // latest calibrated reading
+
+// Hard and soft iron calibration, learned from every new reading. A fit starts
+// every few seconds on the pad and runs one bounded step per loop pass, so it
+// never holds up the loop. The fusion filter skips the mag corrections until
+// it has a calibration
+Adafruit_AHRS_MagCalibration magCalibration;
+#define MAG_CALIBRATION_SOLVE_INTERVAL_MS 5000
+uint32_t last_mag_solve_time = 0;
+
+#ifdef PAD_WAKE_UP
+LSM6DSOXWakeUp padWakeUp;
+#define PAD_IDLE_INTERVAL_MS 50
+#define PAD_WAKE_UP_HOLD_MS 10000
+uint32_t last_pad_idle_time = 0;
+uint32_t last_wake_up_time = 0;
+bool pad_awake = false;
+SensorDataHandler padWakeUpData(PAD_AWAKE, &dataSaverSDSerial);
+#endif
+bool has_launched = false;
+
+#ifdef IMU_SENSOR_HUB
+LSM6DSOXSensorHub sensorHub;
+// FIFO samples per fusion update. The gyro is integrated at the full 104 Hz,
+// the Kalman update runs at 52 Hz, about the rate the launch detector asks for
+#define FUSION_OVERSAMPLE_RATIO 2
+#endif
+
+// Worst case time the apogee logic may take per loop. Anything slower than
+// this is counted in the log so it shows up post-flight.
+#define APOGEE_UPDATE_BUDGET_US 200
+uint32_t max_apogee_update_us = 0;
+uint32_t apogee_update_overruns = 0;
+bool apogee_logged = false;
 
 float cycle_count = 0;
 
 int last_led_toggle = 0;
 int toggle_delay = 500;
 
+void loadGyroTemperatureTable() {
+  // Not FILE_WRITE, which appends every write
+  gyroTemperatureTableFile = SD.open(GYRO_TEMP_TABLE_FILE, O_RDWR | O_CREAT);
+  if (!gyroTemperatureTableFile) {
+    Serial.println("Cannot open the gyro temperature table, it will not be saved");
+    return;
+  }
+  if (gyroTemperatureTableFile.size() == 0) {
+    Serial.println("No gyro temperature table, starting empty");
+    return;
+  }
+  GyroTemperatureTable::Data data;
+  if (gyroTemperatureTableFile.read((uint8_t *)&data, sizeof(data)) != (int)sizeof(data) ||
+      !gyroTemperatureTable.setData(data)) {
+    Serial.println("Gyro temperature table is invalid, starting empty");
+  }
+}
+
+void saveGyroTemperatureTable() {
+  if (!gyroTemperatureTableFile) {
+    return;
+  }
+  // The table always has the same size, so the flush writes back its data
+  // block and the directory entry and leaves the FAT alone
+  const GyroTemperatureTable::Data &data = gyroTemperatureTable.getData();
+  gyroTemperatureTableFile.seek(0);
+  gyroTemperatureTableFile.write((const uint8_t *)&data, sizeof(data));
+  gyroTemperatureTableFile.flush();
+}
+
+lis3mdl_dataRate_t magDataRate(float rate_hz) {
+  if (rate_hz <= 10.0f) {
+    return LIS3MDL_DATARATE_10_HZ;
+  } else if (rate_hz <= 20.0f) {
+    return LIS3MDL_DATARATE_20_HZ;
+  } else if (rate_hz <= 40.0f) {
+    return LIS3MDL_DATARATE_40_HZ;
+  } else if (rate_hz <= 80.0f) {
+    return LIS3MDL_DATARATE_80_HZ;
+  } else if (rate_hz <= 155.0f) {
+    return LIS3MDL_DATARATE_155_HZ;
+  } else if (rate_hz <= 300.0f) {
+    return LIS3MDL_DATARATE_300_HZ;
+  } else if (rate_hz <= 560.0f) {
+    return LIS3MDL_DATARATE_560_HZ;
+  }
+  return LIS3MDL_DATARATE_1000_HZ;
+}
+
+// Returns false, leaving raw_uT alone, if there is no new sample
+bool readMagnetometer(float raw_uT[3]) {
+  uint8_t reg = MAG_STATUS_REG | MAG_AUTO_INCREMENT;
+  uint8_t buffer[7]; // STATUS_REG, then OUT_X_L to OUT_Z_H
+  if (!magDevice->write_then_read(&reg, 1, buffer, sizeof(buffer)) ||
+      !(buffer[0] & MAG_STATUS_ZYXDA)) {
+    return false;
+  }
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    int16_t counts = (int16_t)(buffer[2 * axis + 1] | (buffer[2 * axis + 2] << 8));
+    raw_uT[axis] = counts / MAG_LSB_PER_UT;
+  }
+  return true;
+}
+
+#ifdef IMU_SENSOR_HUB
+// Hands the oldest hub samples to the fusion filter as one block, with the
+// temperature dependent gyro offset removed. They all get the newest
+// magnetometer reading, which the hub read at most one FIFO read after them
+void fuseSensorHubSamples(const float gyro_bias_dps[3]) {
+  float gx[FUSION_OVERSAMPLE_RATIO], gy[FUSION_OVERSAMPLE_RATIO], gz[FUSION_OVERSAMPLE_RATIO];
+  float ax[FUSION_OVERSAMPLE_RATIO], ay[FUSION_OVERSAMPLE_RATIO], az[FUSION_OVERSAMPLE_RATIO];
+  float mx[FUSION_OVERSAMPLE_RATIO], my[FUSION_OVERSAMPLE_RATIO], mz[FUSION_OVERSAMPLE_RATIO];
+  uint32_t timestamp_us[FUSION_OVERSAMPLE_RATIO];
+  uint32_t now_us = micros();
+  for (uint8_t k = 0; k < FUSION_OVERSAMPLE_RATIO; k++) {
+    float gyro_dps[3], accel_g[3];
+    sensorHub.getSample(k, gyro_dps, accel_g);
+    gx[k] = gyro_dps[0] - gyro_bias_dps[0];
+    gy[k] = gyro_dps[1] - gyro_bias_dps[1];
+    gz[k] = gyro_dps[2] - gyro_bias_dps[2];
+    ax[k] = accel_g[0];
+    ay[k] = accel_g[1];
+    az[k] = accel_g[2];
+    mx[k] = mag_uT[0];
+    my[k] = mag_uT[1];
+    mz[k] = mag_uT[2];
+    // Only approximate, the filters here run on the rate given to begin()
+    timestamp_us[k] = now_us - (uint32_t)((FUSION_OVERSAMPLE_RATIO - 1 - k) * 1e6f / SENSOR_HUB_RATE_HZ);
+  }
+  Adafruit_AHRS_SampleBlock block = {gx, gy, gz, ax, ay, az, mx, my, mz,
+                                     timestamp_us, FUSION_OVERSAMPLE_RATIO};
+  fusion.updateBatch(block);
+  sensorHub.consume(FUSION_OVERSAMPLE_RATIO);
+}
+#endif
+
+#ifdef PAD_WAKE_UP
+// Runs first in loop(). While idle on the pad, waits out the rest of the slow
+// interval; the wake-up event is latched in the IMU so none is missed
+void waitForPadWakeUp() {
+  if (!pad_awake && !has_launched) {
+    uint32_t elapsed = millis() - last_pad_idle_time;
+    if (elapsed < PAD_IDLE_INTERVAL_MS) {
+      delay(PAD_IDLE_INTERVAL_MS - elapsed);
+    }
+    last_pad_idle_time = millis();
+  }
+  if (has_launched) {
+    return;
+  }
+
+  uint32_t now = millis();
+  if (padWakeUp.poll()) {
+    if (!pad_awake) {
+      padWakeUpData.addData(DataPoint(now, 1));
+    }
+    pad_awake = true;
+    last_wake_up_time = now;
+  } else if (pad_awake && now - last_wake_up_time >= PAD_WAKE_UP_HOLD_MS) {
+    pad_awake = false;
+    padWakeUpData.addData(DataPoint(now, 0));
+  }
+}
+#endif
+
+// Everything that runs on the fusion output, dt_s after the last update
+void updateFromFusion(uint32_t current_time, float dt_s) {
+  float linear_x, linear_y, linear_z;
+  fusion.getGlobalLinearAcceleration(&linear_x, &linear_y, &linear_z);
+
+  strapdown.update(dt_s, linear_x, linear_y, linear_z);
+  if (strapdown.isArmed()) {
+    northVelocity.addData(DataPoint(current_time, strapdown.getVelocity(0)));
+    eastVelocity.addData(DataPoint(current_time, strapdown.getVelocity(1)));
+    downVelocity.addData(DataPoint(current_time, strapdown.getVelocity(2)));
+    northPosition.addData(DataPoint(current_time, strapdown.getPosition(0)));
+    eastPosition.addData(DataPoint(current_time, strapdown.getPosition(1)));
+    downPosition.addData(DataPoint(current_time, strapdown.getPosition(2)));
+  }
+
+  // Global z points down. +X is the rocket axis, so its tilt from vertical
+  // is 90 deg plus the pitch
+  verticalLaunchDetector.update(DataPoint(current_time, -linear_z), 90.0f + fusion.getPitch());
+  verticalLinearAccel.addData(DataPoint(current_time, -linear_z));
+#ifdef FUSION_GAIN_SETTLE_S
+  fusionGainRefreshMicros.addData(DataPoint(current_time, fusion.filter().getGainRefreshMicros()));
+#endif
+#ifdef FUSION_PROFILE_LOG_INTERVAL_MS
+  if (current_time - last_profile_log_time >= FUSION_PROFILE_LOG_INTERVAL_MS) {
+    last_profile_log_time = current_time;
+    for (uint8_t stage = 0; stage < NXP_STAGE_COUNT; stage++) {
+      uint32_t min_cycles, mean_cycles, max_cycles;
+      if (fusion.filter().getStageProfile(stage, &min_cycles, &mean_cycles, &max_cycles) > 0) {
+        fusionStageMean[stage].addData(DataPoint(current_time, mean_cycles));
+        fusionStageMax[stage].addData(DataPoint(current_time, max_cycles));
+      }
+    }
+    fusion.filter().resetProfile();
+  }
+#endif
+}
+
 void setup(void) {
   
   pinMode(PA9, OUTPUT);
@@ -62,6 +396,7 @@ void setup(void) {
 
   // Start the SPI SD card
   SD.begin(PA4);
+  loadGyroTemperatureTable();
 
 
 
@@ -82,6 +417,34 @@ void setup(void) {
 
   temperatureData.restrictSaveSpeed(1000); // Save temperature data every second
   cycleRate.restrictSaveSpeed(1000); // Save cycle rate every second
+  verticalVelocity.restrictSaveSpeed(100);
+  predictedApogeeTime.restrictSaveSpeed(100);
+  apogeeUpdateMicros.restrictSaveSpeed(1000);
+  apogeeUpdateOverruns.restrictSaveSpeed(1000);
+
+  // Kick off the first non-blocking altitude conversion, loop() picks it up
+  baro.startOneShot();
+
+#if defined(IMU_SENSOR_HUB) && !defined(AHRS_MAHONY)
+  // Integrate every FIFO gyro reading, one Kalman update per block
+  fusion.filter().begin(SENSOR_HUB_RATE_HZ, FUSION_OVERSAMPLE_RATIO);
+#elif defined(IMU_SENSOR_HUB)
+  fusion.begin(SENSOR_HUB_RATE_HZ);
+#else
+  // Run the fusion only as fast as the launch detector needs it
+  fusion.begin(1000.0f / verticalLaunchDetector.getFusionInterval_ms());
+#endif
+  verticalLinearAccel.restrictSaveSpeed(100);
+  northVelocity.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+  eastVelocity.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+  downVelocity.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+  northPosition.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+  eastPosition.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+  downPosition.restrictSaveSpeed(STRAPDOWN_LOG_INTERVAL_MS);
+#ifdef FUSION_GAIN_SETTLE_S
+  fusion.filter().setGainRefresh(FUSION_GAIN_SETTLE_S, FUSION_GAIN_REFRESH_INTERVAL);
+  fusionGainRefreshMicros.restrictSaveSpeed(1000);
+#endif
 
   // Setting the barometer to altimeter
   // baro.setMode(MPL3115A2_ALTIMETER);
@@ -112,32 +475,58 @@ void setup(void) {
     Serial.println("Failed to set Gyro data rate");
   }
 
-  // Setup for the magnetometer
-  // Serial.println("Setting up magnetometer...");
-  // while (!mag.begin_I2C(0x1E, wire)) {
-  //   Serial.println("Could not find sensor. Check wiring.");
-  //   delay(10);
-  // }
-  // mag.setDataRate(LIS3MDL_DATARATE_155_HZ);
-  // mag.setRange(LIS3MDL_RANGE_4_GAUSS);
-  // mag.setOperationMode(LIS3MDL_SINGLEMODE);
-  // mag.setPerformanceMode(LIS3MDL_MEDIUMMODE);
-
-  // mag.setIntThreshold(500);
-  // mag.configInterrupt(false, false, true, // enable z axis
-  //                         true, // polarity
-  //                         false, // don't latch
-  //                         true); // enabled!
-
-  // if (mag.getDataRate() != LIS3MDL_DATARATE_155_HZ) {
-  //   Serial.println("Failed to set Mag data rate");
-  // }
+#ifdef IMU_SENSOR_HUB
+  // Takes over the IMU rates and ranges set above and sets up the
+  // magnetometer through the hub
+  Serial.println("Setting up the sensor hub and magnetometer...");
+  while (!sensorHub.begin(wire)) {
+    Serial.println("Could not set up the sensor hub. Check wiring.");
+    delay(10);
+  }
+#else
+  Serial.println("Setting up magnetometer...");
+  while (!mag.begin_I2C(MAG_ADDRESS, wire)) {
+    Serial.println("Could not find sensor. Check wiring.");
+    delay(10);
+  }
+  // The 155 Hz and faster rates pick their own performance mode
+  lis3mdl_dataRate_t mag_rate =
+      magDataRate(1000.0f / verticalLaunchDetector.getFusionInterval_ms());
+  mag.setPerformanceMode(LIS3MDL_ULTRAHIGHMODE);
+  mag.setDataRate(mag_rate);
+  mag.setRange(LIS3MDL_RANGE_4_GAUSS);
+  mag.setOperationMode(LIS3MDL_CONTINUOUSMODE);
+  if (mag.getDataRate() != mag_rate) {
+    Serial.println("Failed to set Mag data rate");
+  }
+  if (mag.getRange() != LIS3MDL_RANGE_4_GAUSS) {
+    Serial.println("Failed to set Mag range");
+  }
+
+  magDevice = new Adafruit_I2CDevice(MAG_ADDRESS, wire);
+  magDevice->begin();
+  uint8_t bdu[2] = {MAG_CTRL_REG5, MAG_CTRL_REG5_BDU};
+  magDevice->write(bdu, sizeof(bdu));
+#endif
+  magCalibration.begin();
+
+#ifdef PAD_WAKE_UP
+  // Needs the accelerometer at the rate and range set above
+  while (!padWakeUp.begin(wire)) {
+    Serial.println("Could not set up the wake-up engine. Check wiring.");
+    delay(10);
+  }
+#endif
+
   // test_DataHandler();
   temperatureData.restrictSaveSpeed(1000); // Save temperature data every second
   Serial.println("Setup Complete!!!");
 }
 
 void loop() {
+#ifdef PAD_WAKE_UP
+  waitForPadWakeUp();
+#endif
   cycle_count++;
 
   // if (flightStatus.getStage() > ARMED) {
@@ -155,7 +544,41 @@ void loop() {
   sensors_event_t accel;
   sensors_event_t gyro;
   sensors_event_t temp;
+  // The pad offset estimate must count each gyro sample once, however many
+  // loop passes run per sample
+  bool new_gyro;
+#ifdef IMU_SENSOR_HUB
+  // The fusion filter gets every FIFO sample, the rest of the loop works on
+  // the newest one
+  uint16_t held_samples = sensorHub.getSampleCount();
+  new_gyro = sensorHub.read() > held_samples;
+  float hub_gyro_dps[3], hub_accel_g[3];
+  sensorHub.getLatest(hub_gyro_dps, hub_accel_g);
+  accel.acceleration.x = hub_accel_g[0] * SENSORS_GRAVITY_STANDARD;
+  accel.acceleration.y = hub_accel_g[1] * SENSORS_GRAVITY_STANDARD;
+  accel.acceleration.z = hub_accel_g[2] * SENSORS_GRAVITY_STANDARD;
+  gyro.gyro.x = hub_gyro_dps[0] * DEG_TO_RAD;
+  gyro.gyro.y = hub_gyro_dps[1] * DEG_TO_RAD;
+  gyro.gyro.z = hub_gyro_dps[2] * DEG_TO_RAD;
+  temp.temperature = sensorHub.getTemperature();
+#else
+  // Reading the outputs clears the new data flag, so check it first. Only the
+  // pad needs it, so the flight loop skips the extra bus transfer
+  new_gyro = !has_launched && sox.gyroscopeAvailable();
   sox.getEvent(&accel, &gyro, &temp);
+#endif
+
+  // The pad offset estimate needs the raw readings. Everything else gets
+  // them with the temperature dependent offset removed
+  float raw_gyro_dps[3];
+  raw_gyro_dps[0] = gyro.gyro.x * RAD_TO_DEG;
+  raw_gyro_dps[1] = gyro.gyro.y * RAD_TO_DEG;
+  raw_gyro_dps[2] = gyro.gyro.z * RAD_TO_DEG;
+  float gyro_temp_bias_dps[3];
+  gyroTemperatureTable.getBias(temp.temperature, gyro_temp_bias_dps);
+  gyro.gyro.x -= gyro_temp_bias_dps[0] * DEG_TO_RAD;
+  gyro.gyro.y -= gyro_temp_bias_dps[1] * DEG_TO_RAD;
+  gyro.gyro.z -= gyro_temp_bias_dps[2] * DEG_TO_RAD;
 
   xAccelData.addData(DataPoint(current_time, accel.acceleration.x));
   yAccelData.addData(DataPoint(current_time, accel.acceleration.y));
@@ -167,10 +590,163 @@ void loop() {
 
   temperatureData.addData(DataPoint(current_time, temp.temperature));
 
-  launchPredictor.update(DataPoint(current_time, accel.acceleration.x), DataPoint(current_time, accel.acceleration.y), DataPoint(current_time, accel.acceleration.z));
-  if (launchPredictor.isLaunched()) {
+  // A window sample was taken, the next one is an interval away
+  bool launch_checked = launchPredictor.update(DataPoint(current_time, accel.acceleration.x), DataPoint(current_time, accel.acceleration.y), DataPoint(current_time, accel.acceleration.z)) !=
+                        launchPredictor.DATA_TOO_FAST;
+
+  float raw_mag_uT[3];
+#ifdef IMU_SENSOR_HUB
+  bool new_mag = sensorHub.getMag(raw_mag_uT);
+#else
+  // Only look for a new magnetometer sample as often as the fusion runs
+  bool new_mag = current_time - last_mag_time >= verticalLaunchDetector.getFusionInterval_ms() &&
+                 readMagnetometer(raw_mag_uT);
+#endif
+  if (new_mag) {
+    last_mag_time = current_time;
+    magCalibration.addSample(raw_mag_uT[0], raw_mag_uT[1], raw_mag_uT[2]);
+    magCalibration.apply(raw_mag_uT[0], raw_mag_uT[1], raw_mag_uT[2],
+                         &mag_uT[0], &mag_uT[1], &mag_uT[2]);
+    xMagData.addData(DataPoint(current_time, mag_uT[0]));
+    yMagData.addData(DataPoint(current_time, mag_uT[1]));
+    zMagData.addData(DataPoint(current_time, mag_uT[2]));
+  }
+
+#ifdef IMU_SENSOR_HUB
+  while (sensorHub.getSampleCount() >= FUSION_OVERSAMPLE_RATIO) {
+    last_fusion_time = current_time;
+    fuseSensorHubSamples(gyro_temp_bias_dps);
+    updateFromFusion(current_time, FUSION_OVERSAMPLE_RATIO / SENSOR_HUB_RATE_HZ);
+  }
+#else
+  if (current_time - last_fusion_time >= verticalLaunchDetector.getFusionInterval_ms()) {
+    float fusion_dt_s = (current_time - last_fusion_time) * 0.001f;
+    last_fusion_time = current_time;
+    fusion.update(gyro.gyro.x * RAD_TO_DEG, gyro.gyro.y * RAD_TO_DEG, gyro.gyro.z * RAD_TO_DEG,
+                  accel.acceleration.x / SENSORS_GRAVITY_STANDARD,
+                  accel.acceleration.y / SENSORS_GRAVITY_STANDARD,
+                  accel.acceleration.z / SENSORS_GRAVITY_STANDARD,
+                  mag_uT[0], mag_uT[1], mag_uT[2]);
+    updateFromFusion(current_time, fusion_dt_s);
+  }
+#endif
+#ifdef USE_VERTICAL_LAUNCH_DETECTOR
+  bool launched = verticalLaunchDetector.isLaunched();
+  // The detector runs with every fusion update instead
+  launch_checked = last_fusion_time == current_time;
+#else
+  bool launched = launchPredictor.isLaunched();
+#endif
+
+  has_launched = launched;
+  if (launched) {
     toggle_delay = 50;
+  } else {
+    if (new_gyro) {
+      gyroBiasEstimator.update(launchPredictor.getMedianAccelerationSquared(),
+                               raw_gyro_dps[0], raw_gyro_dps[1], raw_gyro_dps[2]);
+    }
+    if (gyroBiasEstimator.isReady() &&
+        current_time - last_bias_seed_time >= GYRO_BIAS_SEED_INTERVAL_MS) {
+      last_bias_seed_time = current_time;
+      float pad_bias_dps[3] = {gyroBiasEstimator.getBias(0),
+                               gyroBiasEstimator.getBias(1),
+                               gyroBiasEstimator.getBias(2)};
+      gyroTemperatureTable.learn(temp.temperature, pad_bias_dps);
+      gyroTemperatureTable.getBias(temp.temperature, gyro_temp_bias_dps);
+#ifndef AHRS_MAHONY
+      // The filter sees the readings with the table offset removed, so it
+      // gets what the table leaves. Seed it once, when the estimate has
+      // settled: from then on the filter tracks the offset and its own
+      // covariance, which a fresh seed every second would overwrite with a
+      // variance that knows nothing of the table residual. Mahony learns the
+      // offset through its integral gain instead
+      if (!gyro_offset_seeded && gyroBiasEstimator.isSettled()) {
+        gyro_offset_seeded = true;
+        fusion.filter().setGyroOffset(pad_bias_dps[0] - gyro_temp_bias_dps[0],
+                                      pad_bias_dps[1] - gyro_temp_bias_dps[1],
+                                      pad_bias_dps[2] - gyro_temp_bias_dps[2],
+                                      gyroBiasEstimator.getBiasVariance());
+      }
+#endif
+      xGyroBias.addData(DataPoint(current_time, pad_bias_dps[0]));
+      yGyroBias.addData(DataPoint(current_time, pad_bias_dps[1]));
+      zGyroBias.addData(DataPoint(current_time, pad_bias_dps[2]));
+    }
+    if (!magCalibration.isSolving() &&
+        current_time - last_mag_solve_time >= MAG_CALIBRATION_SOLVE_INTERVAL_MS) {
+      last_mag_solve_time = current_time;
+      magCalibration.startSolve();
+    }
+    if (magCalibration.isSolving()) {
+#ifdef AHRS_MAHONY
+      magCalibration.solveStep();
+#else
+      if (magCalibration.solveStep()) {
+        fusion.filter().setMagCalibration(true, magCalibration.getFieldStrength());
+      }
+#endif
+    }
+    // Writing the SD card takes a while, only do it on the pad and right
+    // after a launch check so the write falls in the gap before the next one.
+    // How long the flush takes on the flight card has not been measured; one
+    // that overruns the gap delays the next check, which the predictor takes
+    // as a window spanning a little more time
+    if (launch_checked && !gyroTemperatureTable.isEmpty() &&
+        current_time - last_table_save_time >= GYRO_TEMP_TABLE_SAVE_INTERVAL_MS) {
+      last_table_save_time = current_time;
+      saveGyroTemperatureTable();
+    }
   }
 
   medianAccelSquared.addData(DataPoint(current_time, launchPredictor.getMedianAccelerationSquared()));
+
+  // Only read the barometer once a conversion has finished so the loop never
+  // waits on it
+  bool new_altitude = false;
+  float altitude = 0;
+  if (baro.conversionComplete()) {
+    altitude = baro.getLastConversionResults(MPL3115A2_ALTITUDE);
+    baro.startOneShot();
+    new_altitude = true;
+    altitudeData.addData(DataPoint(current_time, altitude));
+  }
+
+  // MARTHA is mounted with +X toward the nose, so X is the up axis on the rail
+  DataPoint vertical_accel(current_time, accel.acceleration.x);
+
+  uint32_t apogee_start_us = micros();
+  if (launched) {
+    apogeeDetector.arm(current_time);
+    strapdown.arm();
+  }
+  if (new_altitude) {
+    apogeeDetector.updateAltitude(DataPoint(current_time, altitude));
+    strapdown.updateAltitude(DataPoint(current_time, altitude));
+  }
+  apogeeDetector.update(vertical_accel);
+  if (apogeeDetector.isArmed() && !apogeeDetector.isApogeeDetected()) {
+    apogeePredictor.update(vertical_accel, apogeeDetector.getVerticalVelocity());
+  }
+  uint32_t apogee_update_us = micros() - apogee_start_us;
+
+  if (apogee_update_us > max_apogee_update_us) {
+    max_apogee_update_us = apogee_update_us;
+  }
+  if (apogee_update_us > APOGEE_UPDATE_BUDGET_US) {
+    apogee_update_overruns++;
+  }
+  apogeeUpdateMicros.addData(DataPoint(current_time, max_apogee_update_us));
+  apogeeUpdateOverruns.addData(DataPoint(current_time, apogee_update_overruns));
+
+  if (apogeeDetector.isArmed()) {
+    verticalVelocity.addData(DataPoint(current_time, apogeeDetector.getVerticalVelocity()));
+  }
+  if (apogeePredictor.isPredictionValid()) {
+    predictedApogeeTime.addData(DataPoint(current_time, apogeePredictor.getPredictedApogeeTime()));
+  }
+  if (apogeeDetector.isApogeeDetected() && !apogee_logged) {
+    apogeeDetectedTime.addData(DataPoint(current_time, apogeeDetector.getApogeeTime()));
+    apogee_logged = true;
+  }
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#ifndef ATTITUDE_GENERATOR_H
+#define ATTITUDE_GENERATOR_H
+
+// Host-side generator for synthetic 9DOF streams with a known attitude.
+// Produces what the fusion filters in lib/AHRS are fed (gyro in deg/s,
+// accelerometer in g, magnetometer in uT) together with the true orientation
+// quaternion at every sample, so attitude error can be measured exactly.
+//
+// Conventions follow Adafruit_AHRS_NXPFusion: NED global frame, a sensor
+// frame vector is R * (global frame vector), gravity reads +1 g along the
+// down axis and the orientation advances as q = q * dq(omega * dt).
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#define ATT_DEG2RAD 0.017453292519943295
+
+struct AttitudeParams {
+  std::string name = "static";
+  float sampleRate_hz = 104.0f;
+  float duration_s = 60.0f;
+
+  // body angular rate: constant part plus one sinusoid per axis (deg/s)
+  float rate_dps[3] = {0.0f, 0.0f, 0.0f};
+  float wobble_dps[3] = {0.0f, 0.0f, 0.0f};
+  float wobble_hz[3] = {0.5f, 0.7f, 0.3f};
+
+  float initialRollPitchYaw_deg[3] = {0.0f, 0.0f, 0.0f};
+
+  float gyroBias_dps[3] = {0.0f, 0.0f, 0.0f};
+  float gyroNoise_dps = 0.05f;
+  float accelNoise_g = 0.002f;
+  float magNoise_uT = 0.3f;
+  float field_uT = 50.0f;       // geomagnetic field strength
+  float inclination_deg = 60.0f; // positive down, northern hemisphere
+
+  // sinusoidal linear acceleration along the sensor x axis (motor vibration)
+  float vibration_g = 0.0f;
+  float vibration_hz = 37.0f;
+
+  uint32_t seed = 1;
+};
+
+struct AttitudeSample {
+  float gx, gy, gz; // deg/s
+  float ax, ay, az; // g
+  float mx, my, mz; // uT
+  double q[4];      // true orientation quaternion (w, x, y, z)
+};
+
+// q = q * dq where dq rotates by the rotation vector rvec (rad)
+inline void attitudeRotate(double q[4], const double rvec[3]) {
+  double eta = sqrt(rvec[0] * rvec[0] + rvec[1] * rvec[1] + rvec[2] * rvec[2]);
+  double dq[4] = {1.0, 0.0, 0.0, 0.0};
+  if (eta > 0.0) {
+    double s = sin(0.5 * eta) / eta;
+    dq[0] = cos(0.5 * eta);
+    dq[1] = rvec[0] * s;
+    dq[2] = rvec[1] * s;
+    dq[3] = rvec[2] * s;
+  }
+  double r[4] = {q[0] * dq[0] - q[1] * dq[1] - q[2] * dq[2] - q[3] * dq[3],
+                 q[0] * dq[1] + q[1] * dq[0] + q[2] * dq[3] - q[3] * dq[2],
+                 q[0] * dq[2] - q[1] * dq[3] + q[2] * dq[0] + q[3] * dq[1],
+                 q[0] * dq[3] + q[1] * dq[2] - q[2] * dq[1] + q[3] * dq[0]};
+  double n = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+  for (int i = 0; i < 4; i++) {
+    q[i] = r[i] / n;
+  }
+}
+
+// rotation matrix of the NXP filters from an orientation quaternion
+inline void attitudeMatrix(const double q[4], double R[3][3]) {
+  R[0][0] = 2.0 * (q[0] * q[0] + q[1] * q[1]) - 1.0;
+  R[0][1] = 2.0 * (q[1] * q[2] + q[0] * q[3]);
+  R[0][2] = 2.0 * (q[1] * q[3] - q[0] * q[2]);
+  R[1][0] = 2.0 * (q[1] * q[2] - q[0] * q[3]);
+  R[1][1] = 2.0 * (q[0] * q[0] + q[2] * q[2]) - 1.0;
+  R[1][2] = 2.0 * (q[2] * q[3] + q[0] * q[1]);
+  R[2][0] = 2.0 * (q[1] * q[3] + q[0] * q[2]);
+  R[2][1] = 2.0 * (q[2] * q[3] - q[0] * q[1]);
+  R[2][2] = 2.0 * (q[0] * q[0] + q[3] * q[3]) - 1.0;
+}
+
+// angle (deg) between two orientations, ignoring the quaternion sign and
+// norm
+inline double attitudeErrorDeg(const double a[4], const double b[4]) {
+  double na = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3]);
+  double nb = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+  double d = fabs(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]) /
+             (na * nb);
+  if (d > 1.0) {
+    d = 1.0;
+  }
+  return 2.0 * acos(d) / ATT_DEG2RAD;
+}
+
+inline std::vector<AttitudeSample> generateAttitude(const AttitudeParams &p) {
+  std::vector<AttitudeSample> samples;
+  std::mt19937 rng(p.seed);
+  std::normal_distribution<float> gyroNoise(0.0f, p.gyroNoise_dps);
+  std::normal_distribution<float> accelNoise(0.0f, p.accelNoise_g);
+  std::normal_distribution<float> magNoise(0.0f, p.magNoise_uT);
+
+  // initial orientation from roll, pitch then yaw about the body axes
+  double q[4] = {1.0, 0.0, 0.0, 0.0};
+  double r[3] = {0.0, 0.0, p.initialRollPitchYaw_deg[2] * ATT_DEG2RAD};
+  attitudeRotate(q, r);
+  r[1] = p.initialRollPitchYaw_deg[1] * ATT_DEG2RAD;
+  r[2] = 0.0;
+  attitudeRotate(q, r);
+  r[0] = p.initialRollPitchYaw_deg[0] * ATT_DEG2RAD;
+  r[1] = 0.0;
+  attitudeRotate(q, r);
+
+  const double dt = 1.0 / p.sampleRate_hz;
+  const double inc = p.inclination_deg * ATT_DEG2RAD;
+  const double mGl[3] = {p.field_uT * cos(inc), 0.0, p.field_uT * sin(inc)};
+  const size_t count = (size_t)(p.duration_s * p.sampleRate_hz);
+  samples.reserve(count);
+
+  for (size_t k = 0; k < count; k++) {
+    double t = k * dt;
+    double w[3];
+    for (int i = 0; i < 3; i++) {
+      w[i] = p.rate_dps[i] +
+             p.wobble_dps[i] * sin(2.0 * M_PI * p.wobble_hz[i] * t);
+    }
+
+    // the gyro reading at sample k drives the step from k-1 to k
+    double rvec[3] = {w[0] * dt * ATT_DEG2RAD, w[1] * dt * ATT_DEG2RAD,
+                      w[2] * dt * ATT_DEG2RAD};
+    attitudeRotate(q, rvec);
+
+    double R[3][3];
+    attitudeMatrix(q, R);
+    double vib = p.vibration_g * sin(2.0 * M_PI * p.vibration_hz * t);
+
+    AttitudeSample s;
+    s.gx = (float)w[0] + p.gyroBias_dps[0] + gyroNoise(rng);
+    s.gy = (float)w[1] + p.gyroBias_dps[1] + gyroNoise(rng);
+    s.gz = (float)w[2] + p.gyroBias_dps[2] + gyroNoise(rng);
+    s.ax = (float)(R[0][2] + vib) + accelNoise(rng);
+    s.ay = (float)R[1][2] + accelNoise(rng);
+    s.az = (float)R[2][2] + accelNoise(rng);
+    s.mx = (float)(R[0][0] * mGl[0] + R[0][2] * mGl[2]) + magNoise(rng);
+    s.my = (float)(R[1][0] * mGl[0] + R[1][2] * mGl[2]) + magNoise(rng);
+    s.mz = (float)(R[2][0] * mGl[0] + R[2][2] * mGl[2]) + magNoise(rng);
+    for (int i = 0; i < 4; i++) {
+      s.q[i] = q[i];
+    }
+    samples.push_back(s);
+  }
+
+  return samples;
+}
+
+// The scenarios the filter comparison tools all run: static, wobble, gyro
+// bias, fast roll, vibration and a high sample rate
+inline std::vector<AttitudeParams> comparisonScenarios(float duration_s) {
+  std::vector<AttitudeParams> scenarios;
+  AttitudeParams p;
+  p.duration_s = duration_s;
+
+  p.name = "static, tilted";
+  p.initialRollPitchYaw_deg[0] = 20.0f;
+  p.initialRollPitchYaw_deg[1] = -10.0f;
+  p.initialRollPitchYaw_deg[2] = 135.0f;
+  scenarios.push_back(p);
+
+  AttitudeParams slow = p;
+  slow.name = "slow wobble 30 deg/s";
+  for (int i = 0; i < 3; i++) {
+    slow.wobble_dps[i] = 30.0f;
+  }
+  scenarios.push_back(slow);
+
+  AttitudeParams bias = slow;
+  bias.name = "wobble + 2 deg/s gyro bias";
+  bias.gyroBias_dps[0] = 2.0f;
+  bias.gyroBias_dps[1] = -1.5f;
+  bias.gyroBias_dps[2] = 1.0f;
+  scenarios.push_back(bias);
+
+  AttitudeParams roll = p;
+  roll.name = "roll 360 deg/s";
+  roll.rate_dps[0] = 360.0f;
+  roll.wobble_dps[1] = 10.0f;
+  scenarios.push_back(roll);
+
+  AttitudeParams vib = slow;
+  vib.name = "wobble + 2 g vibration";
+  vib.vibration_g = 2.0f;
+  scenarios.push_back(vib);
+
+  AttitudeParams fast = slow;
+  fast.name = "slow wobble, 833 Hz";
+  fast.sampleRate_hz = 833.0f;
+  scenarios.push_back(fast);
+
+  return scenarios;
+}
+
+#endif
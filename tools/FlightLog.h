@@ -0,0 +1,65 @@
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+// Loads a recorded flight into the same Trajectory type the synthetic
+// generator produces, so both can be replayed through the same code.
+//
+// Expected format is one sample per line:
+//
+//     # liftoff_ms=123456
+//     time_ms,ax,ay,az[,altitude_m]
+//
+// Accelerations are m/s^2 in the board frame. The liftoff comment is the
+// ground truth used to score detection; leave it out for pad-only recordings
+// (every trigger then counts as false). Other lines starting with '#' and a
+// non-numeric header row are skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "TrajectoryGenerator.h"
+
+inline bool loadFlightLog(const std::string &path, Trajectory &traj) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) {
+    return false;
+  }
+
+  traj = Trajectory();
+  traj.params.name = path;
+  traj.liftoffTime_ms = UINT32_MAX;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') {
+      const char *key = strstr(line, "liftoff_ms=");
+      if (key) {
+        traj.liftoffTime_ms = (uint32_t)strtoul(key + 11, NULL, 10);
+      }
+      continue;
+    }
+
+    TrajectorySample s;
+    float alt = 0.0f;
+    unsigned long t;
+    int n = sscanf(line, "%lu,%f,%f,%f,%f", &t, &s.ax, &s.ay, &s.az, &alt);
+    if (n < 4) {
+      continue;
+    }
+    s.time_ms = (uint32_t)t;
+    s.hasAltitude = n == 5;
+    s.altitude_m = alt;
+    traj.samples.push_back(s);
+  }
+  fclose(f);
+
+  if (traj.liftoffTime_ms == UINT32_MAX && !traj.samples.empty()) {
+    // Pad-only recording: put liftoff after the last sample
+    traj.liftoffTime_ms = traj.samples.back().time_ms + 1;
+  }
+  return !traj.samples.empty();
+}
+
+#endif
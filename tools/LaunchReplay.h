@@ -0,0 +1,84 @@
+#ifndef LAUNCH_REPLAY_H
+#define LAUNCH_REPLAY_H
+
+// Replays a trajectory through the flight launch predictor
+// (WindowedLaunchPredictor from lib/MARTHA_DataHandling, the class behind
+// StaticLaunchPredictor) exactly the way src/main.cpp feeds it and scores the
+// outcome.
+
+#include <utility>
+
+#include "StaticLaunchPredictor.h"
+#include "TrajectoryGenerator.h"
+#include "data_handling/DataPoint.h"
+
+// Longest window the replay instantiates. Larger ones would not fit the
+// SRAM budget of the flight build anyway
+#define LAUNCH_REPLAY_MAX_WINDOW_SAMPLES 100
+
+struct LaunchPredictorConfig {
+  float threshold_ms2;
+  uint16_t windowSize_ms;
+  uint16_t windowInterval_ms;
+};
+
+struct LaunchReplayResult {
+  bool detected;      // fired at any point
+  bool falseTrigger;  // fired before liftoff
+  int32_t latency_ms; // detection time minus liftoff (valid if detected)
+};
+
+inline uint16_t launchWindowSamples(const LaunchPredictorConfig &cfg) {
+  return cfg.windowInterval_ms ? cfg.windowSize_ms / cfg.windowInterval_ms : 0;
+}
+
+// The window length is a template argument in the flight code, so the
+// configuration can be replayed if it maps to 3 to
+// LAUNCH_REPLAY_MAX_WINDOW_SAMPLES samples
+inline bool isReplayableLaunchConfig(const LaunchPredictorConfig &cfg) {
+  uint16_t samples = launchWindowSamples(cfg);
+  return samples >= 3 && samples <= LAUNCH_REPLAY_MAX_WINDOW_SAMPLES;
+}
+
+template <uint16_t WindowSamples>
+LaunchReplayResult replayLaunchWindow(const Trajectory &traj,
+                                      const LaunchPredictorConfig &cfg) {
+  WindowedLaunchPredictor<WindowSamples> predictor(cfg.threshold_ms2,
+                                                   cfg.windowInterval_ms);
+  LaunchReplayResult result = {false, false, 0};
+
+  for (const TrajectorySample &s : traj.samples) {
+    predictor.update(DataPoint(s.time_ms, s.ax), DataPoint(s.time_ms, s.ay),
+                     DataPoint(s.time_ms, s.az));
+    if (predictor.isLaunched()) {
+      result.detected = true;
+      result.falseTrigger = s.time_ms < traj.liftoffTime_ms;
+      result.latency_ms = (int32_t)s.time_ms - (int32_t)traj.liftoffTime_ms;
+      break;
+    }
+  }
+  return result;
+}
+
+typedef LaunchReplayResult (*LaunchReplayFunction)(
+    const Trajectory &, const LaunchPredictorConfig &);
+
+// replayLaunchWindow<N> for N = 0 .. LAUNCH_REPLAY_MAX_WINDOW_SAMPLES - 3,
+// offset by the 3 sample minimum
+template <uint16_t... N>
+inline const LaunchReplayFunction *
+launchReplayTable(std::integer_sequence<uint16_t, N...>) {
+  static const LaunchReplayFunction table[] = {replayLaunchWindow<N + 3>...};
+  return table;
+}
+
+// Only call with a configuration isReplayableLaunchConfig() accepts
+inline LaunchReplayResult replayLaunch(const Trajectory &traj,
+                                       const LaunchPredictorConfig &cfg) {
+  const LaunchReplayFunction *table = launchReplayTable(
+      std::make_integer_sequence<uint16_t,
+                                 LAUNCH_REPLAY_MAX_WINDOW_SAMPLES - 2>());
+  return table[launchWindowSamples(cfg) - 3](traj, cfg);
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef TRAJECTORY_GENERATOR_H
+#define TRAJECTORY_GENERATOR_H
+
+// Host-side generator for synthetic MARTHA flights. Produces the same streams
+// the firmware sees (accelerometer in m/s^2 along the board axes, barometric
+// altitude in m) at any sample rate, with a known liftoff time so detection
+// latency can be measured exactly.
+//
+// The board is assumed to sit on the rail with +X toward the nose, matching
+// src/main.cpp.
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#define TRAJ_GRAVITY_MS2 9.80665f
+
+enum ThrustShape {
+  THRUST_BOXCAR,      // constant thrust for the whole burn
+  THRUST_PROGRESSIVE, // ramps up over the burn
+  THRUST_REGRESSIVE,  // peaks at ignition and tails off
+};
+
+struct TrajectoryParams {
+  std::string name = "nominal";
+  float sampleRate_hz = 104.0f;
+  float baroRate_hz = 50.0f;
+
+  float padTime_s = 20.0f;   // time on the pad before ignition
+  float flightTime_s = 10.0f; // time simulated after ignition
+
+  ThrustShape thrustShape = THRUST_BOXCAR;
+  float burnTime_s = 2.0f;
+  float peakThrust_ms2 = 80.0f; // peak specific force from the motor
+  float thrustRise_s = 0.05f;   // time for the motor to come up to pressure
+  float dragCoefficient = 0.0005f; // k in a_drag = k * v^2
+
+  float accelNoise_ms2 = 0.15f; // white noise per axis
+  float baroNoise_m = 0.3f;
+
+  float vibration_ms2 = 0.0f; // sinusoidal vibration amplitude (all axes)
+  float vibration_hz = 37.0f;
+
+  int padBumps = 0;          // handling bumps while waiting on the pad
+  float padBump_ms2 = 40.0f; // peak specific force of a bump
+  float padBump_s = 0.05f;   // duration of a bump
+
+  uint32_t seed = 1;
+};
+
+struct TrajectorySample {
+  uint32_t time_ms;
+  float ax, ay, az; // m/s^2, board frame
+  bool hasAltitude;
+  float altitude_m;
+  // truth of the synthetic flight, 0 in recorded flights
+  float trueVelocity_ms = 0.0f;
+  float trueAltitude_m = 0.0f;
+};
+
+struct Trajectory {
+  TrajectoryParams params;
+  uint32_t liftoffTime_ms;
+  std::vector<TrajectorySample> samples;
+};
+
+inline float trajectoryThrust(const TrajectoryParams &p, float t) {
+  if (t < 0.0f || t >= p.burnTime_s) {
+    return 0.0f;
+  }
+  float rise = p.thrustRise_s > 0.0f ? fminf(t / p.thrustRise_s, 1.0f) : 1.0f;
+  float frac = t / p.burnTime_s;
+  switch (p.thrustShape) {
+  case THRUST_PROGRESSIVE:
+    return rise * p.peakThrust_ms2 * (0.5f + 0.5f * frac);
+  case THRUST_REGRESSIVE:
+    return rise * p.peakThrust_ms2 * (1.0f - 0.5f * frac);
+  case THRUST_BOXCAR:
+  default:
+    return rise * p.peakThrust_ms2;
+  }
+}
+
+inline Trajectory generateTrajectory(const TrajectoryParams &p) {
+  Trajectory traj;
+  traj.params = p;
+
+  std::mt19937 rng(p.seed);
+  std::normal_distribution<float> accelNoise(0.0f, p.accelNoise_ms2);
+  std::normal_distribution<float> baroNoise(0.0f, p.baroNoise_m);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  // Pad bumps are placed at random times, away from ignition
+  std::vector<float> bumpStart;
+  for (int i = 0; i < p.padBumps; i++) {
+    bumpStart.push_back(uniform(rng) * (p.padTime_s - 2.0f));
+  }
+
+  const float dt = 1.0f / p.sampleRate_hz;
+  const float baroPeriod = 1.0f / p.baroRate_hz;
+  const size_t count = (size_t)((p.padTime_s + p.flightTime_s) * p.sampleRate_hz);
+  traj.liftoffTime_ms = (uint32_t)(p.padTime_s * 1000.0f);
+  traj.samples.reserve(count);
+
+  float velocity = 0.0f;
+  float altitude = 0.0f;
+  float nextBaro = 0.0f;
+
+  for (size_t i = 0; i < count; i++) {
+    float t = i * dt;
+    float tFlight = t - p.padTime_s;
+
+    // Specific force along the rocket axis: what the accelerometer reads
+    float thrust = trajectoryThrust(p, tFlight);
+    float drag = p.dragCoefficient * velocity * fabsf(velocity);
+    float specificForce;
+    if (tFlight < 0.0f || (altitude <= 0.0f && thrust < TRAJ_GRAVITY_MS2)) {
+      // Sitting on the pad (or the motor cannot lift it yet)
+      specificForce = TRAJ_GRAVITY_MS2;
+      velocity = 0.0f;
+    } else {
+      specificForce = thrust - drag;
+      velocity += (specificForce - TRAJ_GRAVITY_MS2) * dt;
+      altitude += velocity * dt;
+    }
+
+    float bump = 0.0f;
+    for (float start : bumpStart) {
+      if (t >= start && t < start + p.padBump_s) {
+        // Half-sine shaped knock
+        bump = p.padBump_ms2 * sinf(3.14159265f * (t - start) / p.padBump_s);
+      }
+    }
+
+    float vib = p.vibration_ms2 * sinf(2.0f * 3.14159265f * p.vibration_hz * t);
+
+    TrajectorySample s;
+    s.time_ms = (uint32_t)(t * 1000.0f);
+    s.ax = specificForce + bump + vib + accelNoise(rng);
+    s.ay = vib + 0.3f * bump + accelNoise(rng);
+    s.az = vib + accelNoise(rng);
+    s.hasAltitude = t >= nextBaro;
+    s.altitude_m = 0.0f;
+    if (s.hasAltitude) {
+      s.altitude_m = altitude + baroNoise(rng);
+      nextBaro += baroPeriod;
+    }
+    s.trueVelocity_ms = velocity;
+    s.trueAltitude_m = altitude;
+    traj.samples.push_back(s);
+  }
+
+  return traj;
+}
+
+#endif
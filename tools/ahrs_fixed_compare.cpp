@@ -0,0 +1,98 @@
+// Fixed-point fusion comparison.
+//
+// Runs Adafruit_NXPSensorFusion (float) and Adafruit_NXPSensorFusionQ (fixed
+// point) side by side on synthetic 9DOF streams with a known attitude and
+// prints a markdown table of attitude error against the truth and of the time
+// per update.
+//
+// Usage: ahrs_fixed_compare [duration_s] [settle_s]
+// Defaults to 60 s per scenario with the first 5 s excluded from the errors.
+//
+// See tools/README.md for build instructions.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "Adafruit_AHRS_NXPFusionQ.h"
+#include "AttitudeGenerator.h"
+
+struct FilterResult {
+  double maxError_deg = 0.0;
+  double rmsError_deg = 0.0;
+  double update_ns = 0.0;
+};
+
+template <typename Filter>
+static FilterResult runFilter(const AttitudeParams &p,
+                              const std::vector<AttitudeSample> &samples,
+                              float settle_s) {
+  FilterResult result;
+  // zero the filter like the global instance in the firmware: begin() does
+  // not clear every member
+  Filter filter = Filter();
+  filter.begin(p.sampleRate_hz);
+  // the generated magnetometer readings need no calibration
+  filter.setMagCalibration(true, p.field_uT);
+
+  size_t settle = (size_t)(settle_s * p.sampleRate_hz);
+  size_t counted = 0;
+  double sumSq = 0.0;
+  double busy_ns = 0.0;
+
+  for (size_t k = 0; k < samples.size(); k++) {
+    const AttitudeSample &s = samples[k];
+    auto start = std::chrono::steady_clock::now();
+    filter.update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az, s.mx, s.my, s.mz);
+    auto end = std::chrono::steady_clock::now();
+    busy_ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+    if (k < settle) {
+      continue;
+    }
+    float w, x, y, z;
+    filter.getQuaternion(&w, &x, &y, &z);
+    double q[4] = {w, x, y, z};
+    double err = attitudeErrorDeg(q, s.q);
+    sumSq += err * err;
+    if (err > result.maxError_deg) {
+      result.maxError_deg = err;
+    }
+    counted++;
+  }
+
+  if (counted > 0) {
+    result.rmsError_deg = sqrt(sumSq / counted);
+  }
+  result.update_ns = busy_ns / samples.size();
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float duration_s = 60.0f;
+  float settle_s = 5.0f;
+  if (argc >= 2) {
+    duration_s = atof(argv[1]);
+  }
+  if (argc >= 3) {
+    settle_s = atof(argv[2]);
+  }
+
+  printf("| scenario | float max/rms (deg) | fixed max/rms (deg) "
+         "| float ns/update | fixed ns/update |\n");
+  printf("|---|---|---|---|---|\n");
+
+  for (const AttitudeParams &p : comparisonScenarios(duration_s)) {
+    std::vector<AttitudeSample> samples = generateAttitude(p);
+    FilterResult f = runFilter<Adafruit_NXPSensorFusion>(p, samples, settle_s);
+    FilterResult q =
+        runFilter<Adafruit_NXPSensorFusionQ>(p, samples, settle_s);
+    printf("| %s | %.3f / %.3f | %.3f / %.3f | %.0f | %.0f |\n",
+           p.name.c_str(), f.maxError_deg, f.rmsError_deg, q.maxError_deg,
+           q.rmsError_deg, f.update_ns, q.update_ns);
+  }
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+// NXP fusion stage profile.
+//
+// Runs Adafruit_NXPSensorFusion built with AHRS_NXP_PROFILE on a synthetic
+// wobbling stream the way src/main.cpp drives it: blocks of oversampleRatio
+// readings through updateBatch(), then the linear acceleration and pitch
+// getters. It prints the min/mean/max host time of every stage from
+// getStageProfile(), which shows where the update spends its time and how
+// an optimisation moves it.
+//
+// Usage: ahrs_profile [duration_s oversampleRatio gainRefreshInterval]
+// Defaults to 60 s at 104 Hz, one reading per update and a gain refresh on
+// every update.
+//
+// See tools/README.md for build instructions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "AttitudeGenerator.h"
+
+#ifndef AHRS_NXP_PROFILE
+#error "build ahrs_profile with -DAHRS_NXP_PROFILE"
+#endif
+
+static const char *stageNames[NXP_STAGE_COUNT] = {
+    "predict", "C update", "gain", "inverse",
+    "correction", "covariance", "derived"};
+
+int main(int argc, char **argv) {
+  AttitudeParams p;
+  p.name = "slow wobble 30 deg/s";
+  p.initialRollPitchYaw_deg[0] = 20.0f;
+  p.initialRollPitchYaw_deg[1] = -10.0f;
+  for (int i = 0; i < 3; i++) {
+    p.wobble_dps[i] = 30.0f;
+  }
+  uint8_t oversampleRatio = 1;
+  uint16_t refreshInterval = 1;
+
+  if (argc >= 2) {
+    p.duration_s = atof(argv[1]);
+  }
+  if (argc >= 3) {
+    oversampleRatio = (uint8_t)atoi(argv[2]);
+    if (oversampleRatio < 1) {
+      oversampleRatio = 1;
+    }
+  }
+  if (argc >= 4) {
+    refreshInterval = (uint16_t)atoi(argv[3]);
+  }
+
+  std::vector<AttitudeSample> samples = generateAttitude(p);
+
+  // zero the filter like the global instance in the firmware: begin() does
+  // not clear every member
+  Adafruit_NXPSensorFusion filter = Adafruit_NXPSensorFusion();
+  filter.begin(p.sampleRate_hz, oversampleRatio);
+  filter.setMagCalibration(true, p.field_uT);
+  filter.setGainRefresh(0.0f, refreshInterval);
+
+  std::vector<float> g[3], a[3], m[3];
+  for (int i = 0; i < 3; i++) {
+    g[i].resize(oversampleRatio);
+    a[i].resize(oversampleRatio);
+    m[i].resize(oversampleRatio);
+  }
+
+  size_t updates = 0;
+  for (size_t k = 0; k + oversampleRatio <= samples.size();
+       k += oversampleRatio) {
+    for (uint8_t j = 0; j < oversampleRatio; j++) {
+      const AttitudeSample &s = samples[k + j];
+      g[0][j] = s.gx, g[1][j] = s.gy, g[2][j] = s.gz;
+      a[0][j] = s.ax, a[1][j] = s.ay, a[2][j] = s.az;
+      m[0][j] = s.mx, m[1][j] = s.my, m[2][j] = s.mz;
+    }
+    Adafruit_AHRS_SampleBlock block = {
+        g[0].data(), g[1].data(), g[2].data(), a[0].data(), a[1].data(),
+        a[2].data(), m[0].data(), m[1].data(), m[2].data(), NULL,
+        oversampleRatio};
+    filter.updateBatch(block);
+
+    float x, y, z;
+    filter.getGlobalLinearAcceleration(&x, &y, &z);
+    filter.getPitch();
+    updates++;
+  }
+
+  printf("%s, %g Hz, %u readings per update, gain refresh every %u, "
+         "%zu updates\n\n",
+         p.name.c_str(), p.sampleRate_hz, oversampleRatio, refreshInterval,
+         updates);
+  printf("| stage | cycles run | min (ns) | mean (ns) | max (ns) |\n");
+  printf("|---|---:|---:|---:|---:|\n");
+
+  // the last cycle closes when the next update begins
+  uint64_t meanTotal = 0;
+  for (uint8_t stage = 0; stage < NXP_STAGE_COUNT; stage++) {
+    uint32_t min, mean, max;
+    uint32_t count = filter.getStageProfile(stage, &min, &mean, &max);
+    printf("| %s | %u | %u | %u | %u |\n", stageNames[stage], count, min,
+           mean, max);
+    if (updates > 1) {
+      meanTotal += (uint64_t)mean * count / (updates - 1);
+    }
+  }
+  printf("\nMean per update: %u ns\n", (unsigned)meanTotal);
+
+  return 0;
+}
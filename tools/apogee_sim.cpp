@@ -0,0 +1,199 @@
+// Apogee estimate benchmark.
+//
+// Flies synthetic trajectories (TrajectoryGenerator.h) to apogee through the
+// flight launch predictor, ApogeeDetector, ApogeePredictor and the down axis of
+// StrapdownIntegrator wired the way src/main.cpp wires them: they are armed
+// when launch is detected, integrate the up axis every sample and fold in
+// every baro sample. The strapdown gets the true attitude, so only its
+// vertical channel is tested. It prints how long after liftoff launch is
+// detected, the velocity the rocket already has then, both velocity errors 3 s
+// later, the error of the predicted apogee time at that point and how late
+// apogee is declared.
+//
+// Usage: apogee_sim [runs]
+// 104 Hz accelerometer, 10 Hz barometer, 20 runs per scenario by default.
+//
+// See tools/README.md for build instructions.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ApogeeDetector.h"
+#include "ApogeePredictor.h"
+#include "StaticLaunchPredictor.h"
+#include "StrapdownIntegrator.h"
+#include "TrajectoryGenerator.h"
+
+// Time after detection the velocity and predicted apogee are scored at
+#define SCORE_DELAY_MS 3000
+
+struct ApogeeRun {
+  bool detected;
+  float gap_ms;             // liftoff to launch detection
+  float velocityAtLaunch;   // true velocity at launch detection (m/s)
+  float velocityError;      // estimate minus truth SCORE_DELAY_MS later
+  float strapdownError;     // strapdown up velocity minus truth, same moment
+  float predictionError_s;  // predicted minus true apogee time, same moment
+  float apogeeDelay_s;      // declared minus true apogee time
+};
+
+static std::vector<TrajectoryParams> apogeeScenarios() {
+  std::vector<TrajectoryParams> scenarios;
+  TrajectoryParams p;
+  p.baroRate_hz = 10.0f;
+  p.flightTime_s = 30.0f;
+
+  TrajectoryParams base = p;
+  p.name = "boxcar 8g";
+  scenarios.push_back(p);
+
+  p = base;
+  p.name = "high thrust 15g";
+  p.peakThrust_ms2 = 150.0f;
+  p.burnTime_s = 1.0f;
+  scenarios.push_back(p);
+
+  p = base;
+  p.name = "regressive 4g slow rise";
+  p.thrustShape = THRUST_REGRESSIVE;
+  p.peakThrust_ms2 = 40.0f;
+  p.thrustRise_s = 0.3f;
+  scenarios.push_back(p);
+
+  p = base;
+  p.name = "boxcar 8g, 2g vibration";
+  p.vibration_ms2 = 20.0f;
+  p.vibration_hz = 120.0f;
+  scenarios.push_back(p);
+
+  p = base;
+  p.name = "boxcar 8g, pad bumps";
+  p.padBumps = 6;
+  p.padBump_ms2 = 60.0f;
+  scenarios.push_back(p);
+
+  return scenarios;
+}
+
+static ApogeeRun flyToApogee(const Trajectory &traj) {
+  StaticLaunchPredictor<30, 1000, 50> launchPredictor;
+  ApogeeDetector apogeeDetector;
+  ApogeePredictor apogeePredictor;
+  StrapdownIntegrator strapdown;
+  ApogeeRun run = {false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+  // true apogee: the velocity turns negative after liftoff
+  uint32_t trueApogee_ms = 0;
+  for (const TrajectorySample &s : traj.samples) {
+    if (s.time_ms > traj.liftoffTime_ms && s.trueAltitude_m > 0.0f &&
+        s.trueVelocity_ms <= 0.0f) {
+      trueApogee_ms = s.time_ms;
+      break;
+    }
+  }
+
+  uint32_t launch_ms = 0;
+  uint32_t last_ms = traj.samples.empty() ? 0 : traj.samples[0].time_ms;
+  bool scored = false;
+  for (const TrajectorySample &s : traj.samples) {
+    float dt_s = (s.time_ms - last_ms) * 0.001f;
+    last_ms = s.time_ms;
+
+    launchPredictor.update(DataPoint(s.time_ms, s.ax), DataPoint(s.time_ms, s.ay),
+                           DataPoint(s.time_ms, s.az));
+    if (launchPredictor.isLaunched() && !apogeeDetector.isArmed()) {
+      launch_ms = s.time_ms;
+      run.gap_ms = (float)(launch_ms - traj.liftoffTime_ms);
+      run.velocityAtLaunch = s.trueVelocity_ms;
+    }
+    if (launchPredictor.isLaunched()) {
+      apogeeDetector.arm(s.time_ms);
+      strapdown.arm();
+    }
+    if (s.hasAltitude) {
+      apogeeDetector.updateAltitude(DataPoint(s.time_ms, s.altitude_m));
+      strapdown.updateAltitude(DataPoint(s.time_ms, s.altitude_m));
+    }
+    // Linear acceleration in g along down, as the fusion filter reports it
+    strapdown.update(dt_s, 0.0f, 0.0f, -(s.ax - TRAJ_GRAVITY_MS2) / TRAJ_GRAVITY_MS2);
+    DataPoint verticalAccel(s.time_ms, s.ax);
+    apogeeDetector.update(verticalAccel);
+    if (apogeeDetector.isArmed() && !apogeeDetector.isApogeeDetected()) {
+      apogeePredictor.update(verticalAccel, apogeeDetector.getVerticalVelocity());
+    }
+
+    if (apogeeDetector.isArmed() && !scored &&
+        s.time_ms >= launch_ms + SCORE_DELAY_MS) {
+      scored = true;
+      run.velocityError = apogeeDetector.getVerticalVelocity() - s.trueVelocity_ms;
+      run.strapdownError = -strapdown.getVelocity(2) - s.trueVelocity_ms;
+      if (apogeePredictor.isPredictionValid()) {
+        run.predictionError_s =
+            ((float)apogeePredictor.getPredictedApogeeTime() - (float)trueApogee_ms) * 0.001f;
+      } else {
+        run.predictionError_s = NAN;
+      }
+    }
+    if (apogeeDetector.isApogeeDetected()) {
+      run.detected = true;
+      run.apogeeDelay_s =
+          ((float)apogeeDetector.getApogeeTime() - (float)trueApogee_ms) * 0.001f;
+      break;
+    }
+  }
+  return run;
+}
+
+int main(int argc, char **argv) {
+  int runs = argc >= 2 ? atoi(argv[1]) : 20;
+  if (runs < 1) {
+    runs = 1;
+  }
+
+  printf("StaticLaunchPredictor<30, 1000, 50>, 104 Hz accel, 10 Hz baro, "
+         "%d runs per scenario, means\n\n", runs);
+  printf("| scenario | apogee found | liftoff to launch (ms) | velocity at launch (m/s) "
+         "| velocity error +3 s (m/s) | strapdown velocity error +3 s (m/s) "
+         "| apogee prediction error +3 s (s) | apogee declared late by (s) |\n");
+  printf("|---|---:|---:|---:|---:|---:|---:|---:|\n");
+
+  for (TrajectoryParams params : apogeeScenarios()) {
+    int found = 0;
+    int predicted = 0;
+    float gap = 0.0f, velocity = 0.0f, velocityError = 0.0f, strapdownError = 0.0f;
+    float predictionError = 0.0f, delay = 0.0f;
+
+    for (int i = 0; i < runs; i++) {
+      params.seed = 2000u + (uint32_t)i;
+      ApogeeRun run = flyToApogee(generateTrajectory(params));
+      gap += run.gap_ms;
+      velocity += run.velocityAtLaunch;
+      velocityError += run.velocityError;
+      strapdownError += run.strapdownError;
+      if (!isnan(run.predictionError_s)) {
+        predictionError += run.predictionError_s;
+        predicted++;
+      }
+      if (run.detected) {
+        delay += run.apogeeDelay_s;
+        found++;
+      }
+    }
+
+    char predictionCol[16] = "-";
+    if (predicted) {
+      snprintf(predictionCol, sizeof(predictionCol), "%.2f", predictionError / predicted);
+    }
+    char delayCol[16] = "-";
+    if (found) {
+      snprintf(delayCol, sizeof(delayCol), "%.2f", delay / found);
+    }
+    printf("| %s | %d/%d | %.0f | %.1f | %.1f | %.1f | %s | %s |\n",
+           params.name.c_str(), found, runs, gap / runs, velocity / runs,
+           velocityError / runs, strapdownError / runs, predictionCol, delayCol);
+  }
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Coning integration benchmark.
+//
+// Drives the gyro integration of Adafruit_NXPSensorFusion with classic coning
+// motion, where the analytic attitude is known at every instant: the body
+// rotates by the half cone angle beta about an axis that itself turns in the
+// y-z plane at the coning frequency. That makes the body rate
+//   w = (-W (1 - cos beta), -W sin beta sin Wt, W sin beta cos Wt)
+// whose non-commutativity the first-order integration in predict() turns
+// into a steady attitude drift.
+//
+// The gyro readings are the exact mean rate over each sample interval, as
+// from an integrating gyro, so the only errors left are the integrator's.
+// The table compares predict() on every reading with predictBlock() on FIFO
+// blocks of several sizes: attitude error at the end of the run and host time
+// per reading.
+//
+// Usage: coning_bench [beta_deg coning_hz odr_hz seconds]
+// Defaults to a 2 deg cone at 10 Hz sampled at 833 Hz for 60 s.
+//
+// See tools/README.md for build instructions.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "AttitudeGenerator.h"
+
+struct ConingMotion {
+  double beta;  // half cone angle (rad)
+  double omega; // coning frequency (rad/s)
+
+  // attitude at time t
+  void quaternion(double t, double q[4]) const {
+    q[0] = cos(0.5 * beta);
+    q[1] = 0.0;
+    q[2] = sin(0.5 * beta) * cos(omega * t);
+    q[3] = sin(0.5 * beta) * sin(omega * t);
+  }
+
+  // mean body rate (deg/s) between t1 and t2
+  void meanRate(double t1, double t2, float w[3]) const {
+    double dt = t2 - t1;
+    w[0] = (float)(-omega * (1.0 - cos(beta)) / ATT_DEG2RAD);
+    w[1] = (float)(sin(beta) * (cos(omega * t2) - cos(omega * t1)) / dt /
+                   ATT_DEG2RAD);
+    w[2] = (float)(sin(beta) * (sin(omega * t2) - sin(omega * t1)) / dt /
+                   ATT_DEG2RAD);
+  }
+};
+
+struct IntegratorResult {
+  double finalError_deg;
+  double maxError_deg;
+  double ns_per_sample;
+};
+
+// block == 0 runs predict() on every reading
+static IntegratorResult runIntegrator(const ConingMotion &motion, float odr_hz,
+                                      float seconds, int block) {
+  const double dt = 1.0 / odr_hz;
+  const size_t count = (size_t)(seconds * odr_hz);
+  const int n = block > 0 ? block : 1;
+
+  std::vector<float> gx(count), gy(count), gz(count);
+  for (size_t k = 0; k < count; k++) {
+    float w[3];
+    motion.meanRate(k * dt, (k + 1) * dt, w);
+    gx[k] = w[0];
+    gy[k] = w[1];
+    gz[k] = w[2];
+  }
+
+  Adafruit_NXPSensorFusion filter = Adafruit_NXPSensorFusion();
+  filter.begin(odr_hz);
+  double q0[4];
+  motion.quaternion(0.0, q0);
+  filter.setQuaternion(q0[0], q0[1], q0[2], q0[3]);
+
+  IntegratorResult result = {0.0, 0.0, 0.0};
+  double busy_ns = 0.0;
+  for (size_t k = 0; k + n <= count; k += n) {
+    auto start = std::chrono::steady_clock::now();
+    if (block > 0) {
+      filter.predictBlock(&gx[k], &gy[k], &gz[k], n);
+    } else {
+      filter.predict(gx[k], gy[k], gz[k]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    busy_ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+    float w, x, y, z;
+    filter.getPredictedQuaternion(&w, &x, &y, &z);
+    double q[4] = {w, x, y, z};
+    double truth[4];
+    motion.quaternion((k + n) * dt, truth);
+    result.finalError_deg = attitudeErrorDeg(q, truth);
+    if (result.finalError_deg > result.maxError_deg) {
+      result.maxError_deg = result.finalError_deg;
+    }
+  }
+  result.ns_per_sample = busy_ns / count;
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float beta_deg = 2.0f;
+  float coning_hz = 10.0f;
+  float odr_hz = 833.0f;
+  float seconds = 60.0f;
+  if (argc >= 5) {
+    beta_deg = atof(argv[1]);
+    coning_hz = atof(argv[2]);
+    odr_hz = atof(argv[3]);
+    seconds = atof(argv[4]);
+  }
+
+  ConingMotion motion;
+  motion.beta = beta_deg * ATT_DEG2RAD;
+  motion.omega = 2.0 * M_PI * coning_hz;
+
+  printf("coning: %.1f deg half angle at %.1f Hz, %.0f Hz ODR, %.0f s\n\n",
+         beta_deg, coning_hz, odr_hz, seconds);
+  printf("| integrator | final error (deg) | max error (deg) | ns/reading |\n");
+  printf("|---|---|---|---|\n");
+
+  const int blocks[] = {0, 2, 4, 8, 16, 32};
+  for (int block : blocks) {
+    IntegratorResult r = runIntegrator(motion, odr_hz, seconds, block);
+    if (block == 0) {
+      printf("| predict() per reading ");
+    } else {
+      printf("| predictBlock() x%d ", block);
+    }
+    printf("| %.4f | %.4f | %.1f |\n", r.finalError_deg, r.maxError_deg,
+           r.ns_per_sample);
+  }
+
+  return 0;
+}
@@ -0,0 +1,232 @@
+// NXP Kalman gain kernel check.
+//
+// The gain and a posteriori covariance of Adafruit_NXPSensorFusion are
+// computed with kernels written against the fixed structure of Qw and C (see
+// refreshGain()). This runs the float filter on the synthetic streams of
+// AttitudeGenerator.h, toggling the magnetometer calibration every few
+// seconds, and after every gain refresh recomputes K and P+ from the same Qw,
+// C and Qv with the general 12x12 / 6x12 products of the original NXP code
+// kept below. It prints how many gain refreshes were checked and how many
+// elements of K and P+ differ from the reference, bit for bit and in value.
+//
+// Usage: kalman_kernel_check [duration_s]
+// Defaults to 60 s per scenario.
+//
+// See tools/README.md for build instructions.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Adafruit_AHRS_NXPFusion.h"
+#include "AttitudeGenerator.h"
+
+// magnetometer calibration valid / invalid period of the check
+#define MAG_TOGGLE_S 7.0f
+
+extern "C" void fmatrixAeqInvA(float *A[], int8_t iColInd[], int8_t iRowInd[],
+                               int8_t iPivot[], int8_t isize);
+
+struct KernelResult {
+  unsigned long refreshes = 0;
+  unsigned long kBitDiffs = 0;
+  unsigned long pBitDiffs = 0;
+  double maxDiff = 0.0;
+};
+
+// K and P+ from the general products of the NXP code before the structured
+// kernels: every operand walked in full, zero and +-1 elements of Qw and C
+// tested element by element
+static void referenceGain(float Qw12x12[12][12], float C6x12[6][12],
+                          float QvAA, float QvMM, float K12x6[12][6],
+                          float PPlus12x12[12][12]) {
+  float ftmpA12x6[12][6];
+  float *pfRows[6];
+  int8_t iColInd[6];
+  int8_t iRowInd[6];
+  int8_t iPivot[6];
+  int i, j, k;
+
+  // ftmpA12x6 = Qw * C^T
+  for (i = 0; i < 12; i++) {
+    for (j = 0; j < 6; j++) {
+      ftmpA12x6[i][j] = 0.0F;
+      for (k = 0; k < 12; k++) {
+        if ((Qw12x12[i][k] != 0.0F) && (C6x12[j][k] != 0.0F)) {
+          if (C6x12[j][k] == 1.0F)
+            ftmpA12x6[i][j] += Qw12x12[i][k];
+          else if (C6x12[j][k] == -1.0F)
+            ftmpA12x6[i][j] -= Qw12x12[i][k];
+          else
+            ftmpA12x6[i][j] += Qw12x12[i][k] * C6x12[j][k];
+        }
+      }
+    }
+  }
+
+  // P+ (6x6 scratch) = C * ftmpA12x6 + Qv
+  for (i = 0; i < 6; i++) {
+    for (j = i; j < 6; j++) {
+      PPlus12x12[i][j] = 0.0F;
+      for (k = 0; k < 12; k++) {
+        if ((C6x12[i][k] != 0.0F) && (ftmpA12x6[k][j] != 0.0F)) {
+          if (C6x12[i][k] == 1.0F)
+            PPlus12x12[i][j] += ftmpA12x6[k][j];
+          else if (C6x12[i][k] == -1.0F)
+            PPlus12x12[i][j] -= ftmpA12x6[k][j];
+          else
+            PPlus12x12[i][j] += C6x12[i][k] * ftmpA12x6[k][j];
+        }
+      }
+    }
+  }
+  for (i = 0; i < 3; i++) {
+    PPlus12x12[i][i] += QvAA;
+    PPlus12x12[i + 3][i + 3] += QvMM;
+  }
+  for (i = 1; i < 6; i++)
+    for (j = 0; j < i; j++)
+      PPlus12x12[i][j] = PPlus12x12[j][i];
+  for (i = 0; i < 6; i++) {
+    pfRows[i] = PPlus12x12[i];
+  }
+  fmatrixAeqInvA(pfRows, iColInd, iRowInd, iPivot, 3);
+
+  // K = ftmpA12x6 * inv(P+ 6x6)
+  for (i = 0; i < 12; i++) {
+    for (j = 0; j < 6; j++) {
+      K12x6[i][j] = 0.0F;
+      for (k = 0; k < 6; k++) {
+        if (ftmpA12x6[i][k] != 0.0F) {
+          K12x6[i][j] += ftmpA12x6[i][k] * PPlus12x12[k][j];
+        }
+      }
+    }
+  }
+
+  // P+ (6x12 scratch) = C * Qw
+  for (i = 0; i < 6; i++) {
+    for (j = 0; j < 12; j++) {
+      PPlus12x12[i][j] = 0.0F;
+      for (k = 0; k < 12; k++) {
+        if ((C6x12[i][k] != 0.0F) && (Qw12x12[k][j] != 0.0F)) {
+          if (C6x12[i][k] == 1.0F)
+            PPlus12x12[i][j] += Qw12x12[k][j];
+          else if (C6x12[i][k] == -1.0F)
+            PPlus12x12[i][j] -= Qw12x12[k][j];
+          else
+            PPlus12x12[i][j] += C6x12[i][k] * Qw12x12[k][j];
+        }
+      }
+    }
+  }
+
+  // Qw = Qw - K * (C * Qw), on and above the diagonal
+  for (i = 0; i < 12; i++) {
+    for (j = i; j < 12; j++) {
+      for (k = 0; k < 6; k++) {
+        if (PPlus12x12[k][j] != 0.0F) {
+          Qw12x12[i][j] -= K12x6[i][k] * PPlus12x12[k][j];
+        }
+      }
+    }
+  }
+  for (i = 0; i < 12; i++) {
+    for (j = i; j < 12; j++) {
+      PPlus12x12[i][j] = Qw12x12[i][j];
+    }
+  }
+}
+
+static void compare(float reference, float kernel, unsigned long *bitDiffs,
+                    double *maxDiff) {
+  if (memcmp(&reference, &kernel, sizeof(float)) != 0) {
+    (*bitDiffs)++;
+  }
+  double diff = fabs((double)reference - (double)kernel);
+  if (diff > *maxDiff || (diff != diff)) {
+    *maxDiff = diff;
+  }
+}
+
+static KernelResult checkScenario(const AttitudeParams &p) {
+  KernelResult result;
+  std::vector<AttitudeSample> samples = generateAttitude(p);
+  // zero the filter like the global instance in the firmware
+  Adafruit_NXPSensorFusion filter = Adafruit_NXPSensorFusion();
+  filter.begin(p.sampleRate_hz);
+
+  float Qw[12][12];
+  float C[6][12];
+  float K[12][6];
+  float PPlus[12][12];
+  uint32_t toggle = (uint32_t)(MAG_TOGGLE_S * p.sampleRate_hz);
+
+  for (size_t n = 0; n < samples.size(); n++) {
+    const AttitudeSample &s = samples[n];
+    filter.setMagCalibration((n / toggle) % 2 == 0, p.field_uT);
+
+    // Qw going into the update, the proxy for P-
+    for (int i = 0; i < 12; i++) {
+      for (int j = 0; j < 12; j++) {
+        Qw[i][j] = filter.QwUT12x12[Adafruit_NXPSensorFusion::symIndex12(i, j)];
+      }
+    }
+    uint32_t count = filter.updateCount;
+    filter.update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az, s.mx, s.my, s.mz);
+    if (filter.updateCount == count) {
+      continue;
+    }
+
+    // C of this update: the variable columns plus +I and -I
+    for (int i = 0; i < 6; i++) {
+      for (int j = 0; j < 12; j++) {
+        C[i][j] = (j < 6) ? filter.C6x6[i][j] : 0.0F;
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      C[i][i + 6] = 1.0F;
+      C[i + 3][i + 9] = -1.0F;
+    }
+
+    referenceGain(Qw, C, filter.QvAA, filter.QvMM, K, PPlus);
+    result.refreshes++;
+    for (int i = 0; i < 12; i++) {
+      for (int j = 0; j < 6; j++) {
+        compare(K[i][j], filter.K12x6[i][j], &result.kBitDiffs,
+                &result.maxDiff);
+      }
+      for (int j = i; j < 12; j++) {
+        compare(PPlus[i][j], filter.getPPlus(i, j), &result.pBitDiffs,
+                &result.maxDiff);
+      }
+    }
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float duration_s = 60.0f;
+  if (argc >= 2) {
+    duration_s = atof(argv[1]);
+  }
+
+  printf("| scenario | gain refreshes | K elements differing "
+         "| P+ elements differing | largest difference |\n");
+  printf("|---|---|---|---|---|\n");
+
+  bool identical = true;
+  for (const AttitudeParams &p : comparisonScenarios(duration_s)) {
+    KernelResult r = checkScenario(p);
+    printf("| %s | %lu | %lu of %lu | %lu of %lu | %g |\n", p.name.c_str(),
+           r.refreshes, r.kBitDiffs, r.refreshes * 72, r.pBitDiffs,
+           r.refreshes * SYM12_PACKED_SIZE, r.maxDiff);
+    if (r.kBitDiffs || r.pBitDiffs) {
+      identical = false;
+    }
+  }
+
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Launch detection latency benchmark.
+//
+// Generates families of synthetic flights (different motors, sample rates,
+// vibration and pad handling), runs each through the flight launch predictor
+// (see LaunchReplay.h) and prints a markdown table of detection latency and
+// false trigger rate. Keep the output of each release in the PR so
+// regressions are easy to spot.
+//
+// Usage: launch_latency_bench [threshold_ms2 windowSize_ms windowInterval_ms] [runs]
+// Defaults to the flight configuration in src/main.cpp: (30, 1000, 50).
+//
+// See tools/README.md for build instructions.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "LaunchReplay.h"
+#include "TrajectoryGenerator.h"
+
+static std::vector<TrajectoryParams> benchmarkScenarios() {
+  std::vector<TrajectoryParams> scenarios;
+  TrajectoryParams p;
+
+  p.name = "nominal boxcar 8g";
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "progressive 5g";
+  p.thrustShape = THRUST_PROGRESSIVE;
+  p.peakThrust_ms2 = 50.0f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "regressive 4g slow rise";
+  p.thrustShape = THRUST_REGRESSIVE;
+  p.peakThrust_ms2 = 40.0f;
+  p.thrustRise_s = 0.3f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "high thrust 15g";
+  p.peakThrust_ms2 = 150.0f;
+  p.burnTime_s = 1.0f;
+  scenarios.push_back(p);
+
+  const float rates[] = {52.0f, 416.0f, 833.0f};
+  for (float rate : rates) {
+    p = TrajectoryParams();
+    p.name = "nominal boxcar 8g";
+    p.sampleRate_hz = rate;
+    scenarios.push_back(p);
+  }
+
+  p = TrajectoryParams();
+  p.name = "motor vibration 2g";
+  p.vibration_ms2 = 20.0f;
+  p.vibration_hz = 120.0f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "pad bumps short";
+  p.padBumps = 6;
+  p.padBump_ms2 = 60.0f;
+  p.padBump_s = 0.05f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "pad bumps long";
+  p.padBumps = 3;
+  p.padBump_ms2 = 40.0f;
+  p.padBump_s = 0.6f;
+  scenarios.push_back(p);
+
+  // No flight at all: anything that fires is a false trigger
+  p = TrajectoryParams();
+  p.name = "pad only, rough handling";
+  p.padTime_s = 60.0f;
+  p.flightTime_s = 0.0f;
+  p.padBumps = 20;
+  p.padBump_ms2 = 50.0f;
+  p.padBump_s = 0.3f;
+  p.vibration_ms2 = 5.0f;
+  scenarios.push_back(p);
+
+  return scenarios;
+}
+
+int main(int argc, char **argv) {
+  LaunchPredictorConfig cfg = {30.0f, 1000, 50};
+  int runs = 20;
+
+  if (argc >= 4) {
+    cfg.threshold_ms2 = (float)atof(argv[1]);
+    cfg.windowSize_ms = (uint16_t)atoi(argv[2]);
+    cfg.windowInterval_ms = (uint16_t)atoi(argv[3]);
+  }
+  if (argc == 2 || argc >= 5) {
+    runs = atoi(argv[argc == 2 ? 1 : 4]);
+  }
+  if (!isReplayableLaunchConfig(cfg)) {
+    fprintf(stderr, "the window must hold 3 to %d samples\n",
+            LAUNCH_REPLAY_MAX_WINDOW_SAMPLES);
+    return 1;
+  }
+
+  printf("StaticLaunchPredictor<%g, %u, %u>, %d runs per scenario\n\n",
+         cfg.threshold_ms2, cfg.windowSize_ms, cfg.windowInterval_ms, runs);
+  printf("| scenario | rate (Hz) | detected | false triggers | median latency (ms) | max latency (ms) |\n");
+  printf("|---|---:|---:|---:|---:|---:|\n");
+
+  for (TrajectoryParams params : benchmarkScenarios()) {
+    std::vector<int32_t> latencies;
+    int detected = 0;
+    int falseTriggers = 0;
+    const bool hasFlight = params.flightTime_s > 0.0f;
+
+    for (int run = 0; run < runs; run++) {
+      params.seed = 1000u + (uint32_t)run;
+      Trajectory traj = generateTrajectory(params);
+      LaunchReplayResult result = replayLaunch(traj, cfg);
+
+      if (result.falseTrigger) {
+        falseTriggers++;
+      } else if (result.detected) {
+        detected++;
+        latencies.push_back(result.latency_ms);
+      }
+    }
+
+    char median[16] = "-";
+    char worst[16] = "-";
+    if (!latencies.empty()) {
+      std::sort(latencies.begin(), latencies.end());
+      snprintf(median, sizeof(median), "%d", (int)latencies[latencies.size() / 2]);
+      snprintf(worst, sizeof(worst), "%d", (int)latencies.back());
+    }
+
+    char detectedCol[16] = "-";
+    if (hasFlight) {
+      snprintf(detectedCol, sizeof(detectedCol), "%d/%d", detected, runs);
+    }
+
+    printf("| %s | %g | %s | %d/%d | %s | %s |\n", params.name.c_str(),
+           params.sampleRate_hz, detectedCol, falseTriggers, runs, median,
+           worst);
+  }
+
+  return 0;
+}
@@ -0,0 +1,248 @@
+// Parallel parameter sweep of the flight launch predictor.
+//
+// Replays every recorded flight in a directory plus a batch of synthetic
+// flights through a grid of launch predictor configurations (see
+// LaunchReplay.h), spread over all
+// cores, and ranks the configurations. False triggers are ranked first (a
+// false launch ends the flight for us), then missed launches, then mean
+// detection latency. Configurations on the latency / false-trigger Pareto
+// front are marked with '*'.
+//
+// Usage:
+//   launch_sweep [--logs DIR] [--synthetic N] [--threads N] [--top N]
+//                [--threshold MIN:MAX:STEP] [--window MIN:MAX:STEP]
+//                [--interval MIN:MAX:STEP]
+//
+// See tools/README.md for build instructions and tools/FlightLog.h for the
+// log format.
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FlightLog.h"
+#include "LaunchReplay.h"
+#include "TrajectoryGenerator.h"
+
+struct SweepRange {
+  float min, max, step;
+};
+
+struct ConfigScore {
+  LaunchPredictorConfig cfg;
+  int falseTriggers;
+  int missed;
+  double meanLatency_ms;
+  int32_t maxLatency_ms;
+  bool pareto;
+};
+
+static bool parseRange(const char *arg, SweepRange &range) {
+  return sscanf(arg, "%f:%f:%f", &range.min, &range.max, &range.step) == 3 &&
+         range.step > 0.0f && range.max >= range.min;
+}
+
+static std::vector<float> expandRange(const SweepRange &range) {
+  std::vector<float> values;
+  // Half a step of slack so MAX is included despite rounding
+  for (float v = range.min; v <= range.max + 0.5f * range.step; v += range.step) {
+    values.push_back(v);
+  }
+  return values;
+}
+
+// Synthetic flights covering the situations we worry about on the pad and at
+// ignition. Seeds are fixed so sweeps are repeatable.
+static void addSyntheticFlights(std::vector<Trajectory> &flights, int count) {
+  for (int i = 0; i < count; i++) {
+    TrajectoryParams p;
+    p.seed = 5000u + (uint32_t)i;
+    p.name = "synthetic " + std::to_string(i);
+    p.thrustShape = (ThrustShape)(i % 3);
+    p.peakThrust_ms2 = 35.0f + 15.0f * (i % 7);
+    p.thrustRise_s = 0.05f + 0.05f * (i % 4);
+    p.vibration_ms2 = 3.0f * (i % 5);
+    p.vibration_hz = 40.0f + 20.0f * (i % 3);
+    p.padBumps = i % 6;
+    p.padBump_ms2 = 30.0f + 10.0f * (i % 4);
+    p.padBump_s = 0.05f + 0.1f * (i % 3);
+    if (i % 8 == 7) {
+      // Every eighth flight is a long pad-only recording
+      p.name = "synthetic pad-only " + std::to_string(i);
+      p.padTime_s = 120.0f;
+      p.flightTime_s = 0.0f;
+      p.padBumps = 15;
+    }
+    flights.push_back(generateTrajectory(p));
+  }
+}
+
+static ConfigScore scoreConfig(const LaunchPredictorConfig &cfg,
+                               const std::vector<Trajectory> &flights) {
+  ConfigScore score = {cfg, 0, 0, 0.0, 0, false};
+  int detected = 0;
+  double latencySum = 0.0;
+
+  for (const Trajectory &traj : flights) {
+    const bool hasFlight =
+        !traj.samples.empty() && traj.samples.back().time_ms >= traj.liftoffTime_ms;
+    LaunchReplayResult result = replayLaunch(traj, cfg);
+    if (result.falseTrigger) {
+      score.falseTriggers++;
+    } else if (result.detected) {
+      detected++;
+      latencySum += result.latency_ms;
+      score.maxLatency_ms = std::max(score.maxLatency_ms, result.latency_ms);
+    } else if (hasFlight) {
+      score.missed++;
+    }
+  }
+
+  score.meanLatency_ms = detected ? latencySum / detected : 1e9;
+  return score;
+}
+
+static void markParetoFront(std::vector<ConfigScore> &scores) {
+  for (ConfigScore &a : scores) {
+    a.pareto = true;
+    for (const ConfigScore &b : scores) {
+      bool noWorse = b.falseTriggers <= a.falseTriggers && b.missed <= a.missed &&
+                     b.meanLatency_ms <= a.meanLatency_ms;
+      bool better = b.falseTriggers < a.falseTriggers || b.missed < a.missed ||
+                    b.meanLatency_ms < a.meanLatency_ms;
+      if (noWorse && better) {
+        a.pareto = false;
+        break;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string logDir;
+  int syntheticCount = 48;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t top = 25;
+  SweepRange thresholdRange = {15.0f, 45.0f, 1.0f};
+  SweepRange windowRange = {200.0f, 2000.0f, 100.0f};
+  SweepRange intervalRange = {25.0f, 150.0f, 25.0f};
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    bool ok = value != NULL;
+    if (ok && !strcmp(arg, "--logs")) {
+      logDir = value;
+    } else if (ok && !strcmp(arg, "--synthetic")) {
+      syntheticCount = atoi(value);
+    } else if (ok && !strcmp(arg, "--threads")) {
+      threads = (unsigned)atoi(value);
+    } else if (ok && !strcmp(arg, "--top")) {
+      top = (size_t)atoi(value);
+    } else if (ok && !strcmp(arg, "--threshold")) {
+      ok = parseRange(value, thresholdRange);
+    } else if (ok && !strcmp(arg, "--window")) {
+      ok = parseRange(value, windowRange);
+    } else if (ok && !strcmp(arg, "--interval")) {
+      ok = parseRange(value, intervalRange);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "bad argument: %s\n", arg);
+      return 1;
+    }
+    i++;
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  std::vector<Trajectory> flights;
+  if (!logDir.empty()) {
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(logDir)) {
+      if (entry.is_regular_file()) {
+        paths.push_back(entry.path().string());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const std::string &path : paths) {
+      Trajectory traj;
+      if (loadFlightLog(path, traj)) {
+        flights.push_back(std::move(traj));
+      } else {
+        fprintf(stderr, "skipping %s: no samples\n", path.c_str());
+      }
+    }
+  }
+  addSyntheticFlights(flights, syntheticCount);
+
+  std::vector<LaunchPredictorConfig> configs;
+  size_t skipped = 0;
+  for (float threshold : expandRange(thresholdRange)) {
+    for (float window : expandRange(windowRange)) {
+      for (float interval : expandRange(intervalRange)) {
+        LaunchPredictorConfig cfg = {threshold, (uint16_t)window,
+                                     (uint16_t)interval};
+        if (isReplayableLaunchConfig(cfg)) {
+          configs.push_back(cfg);
+        } else {
+          skipped++;
+        }
+      }
+    }
+  }
+  if (skipped > 0) {
+    fprintf(stderr, "skipping %zu configurations whose window is not 3 to %d "
+                    "samples\n",
+            skipped, LAUNCH_REPLAY_MAX_WINDOW_SAMPLES);
+  }
+
+  fprintf(stderr, "%zu configurations x %zu flights on %u threads\n",
+          configs.size(), flights.size(), threads);
+
+  // Each worker claims the next unscored configuration. Flights are shared
+  // read-only and every score slot is written by exactly one worker.
+  std::vector<ConfigScore> scores(configs.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; t++) {
+    pool.emplace_back([&]() {
+      for (size_t i = next++; i < configs.size(); i = next++) {
+        scores[i] = scoreConfig(configs[i], flights);
+      }
+    });
+  }
+  for (std::thread &worker : pool) {
+    worker.join();
+  }
+
+  markParetoFront(scores);
+  std::sort(scores.begin(), scores.end(),
+            [](const ConfigScore &a, const ConfigScore &b) {
+              if (a.falseTriggers != b.falseTriggers)
+                return a.falseTriggers < b.falseTriggers;
+              if (a.missed != b.missed)
+                return a.missed < b.missed;
+              return a.meanLatency_ms < b.meanLatency_ms;
+            });
+
+  printf("| rank | threshold (m/s^2) | window (ms) | interval (ms) | false triggers | missed | mean latency (ms) | max latency (ms) | pareto |\n");
+  printf("|---:|---:|---:|---:|---:|---:|---:|---:|:---:|\n");
+  for (size_t i = 0; i < scores.size() && i < top; i++) {
+    const ConfigScore &s = scores[i];
+    printf("| %zu | %g | %u | %u | %d | %d | %.0f | %d | %s |\n", i + 1,
+           s.cfg.threshold_ms2, s.cfg.windowSize_ms, s.cfg.windowInterval_ms,
+           s.falseTriggers, s.missed, s.meanLatency_ms, (int)s.maxLatency_ms,
+           s.pareto ? "*" : "");
+  }
+
+  return 0;
+}
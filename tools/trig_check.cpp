@@ -0,0 +1,129 @@
+// Inverse trig check for the NXP fusion filter.
+//
+// Sweeps fasin_deg, facos_deg, fatan_deg and fatan2_deg from
+// lib/AHRS/src/Adafruit_AHRS_NXPTrig.h over their whole input range and
+// compares them with libm in double precision. Prints a markdown table of the
+// largest error, the angle it occurs at and the host time per call. Build it
+// once as is for the Pade kernel of the flight build and once with
+// -DAHRS_TRIG_LUT for the table kernel.
+//
+// Usage: trig_check [points]
+// Defaults to 2000000 points per function.
+//
+// See tools/README.md for build instructions.
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Adafruit_AHRS_NXPTrig.h"
+
+#define TRIG_RAD2DEG 57.295779513082321
+
+struct TrigResult {
+  double maxError_deg = 0.0;
+  double worstAngle_deg = 0.0; // exact result where the error peaks
+  double ns_per_call = 0.0;
+};
+
+// keeps the timed calls from being optimized away
+static volatile float trigSink;
+
+template <typename Approx, typename Exact>
+static TrigResult sweep(const std::vector<float> &inputs, Approx approx,
+                        Exact exact) {
+  TrigResult result;
+  for (float x : inputs) {
+    double truth = exact((double)x);
+    double err = fabs((double)approx(x) - truth);
+    if (err > result.maxError_deg) {
+      result.maxError_deg = err;
+      result.worstAngle_deg = truth;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  float acc = 0.0f;
+  for (float x : inputs) {
+    acc += approx(x);
+  }
+  auto end = std::chrono::steady_clock::now();
+  trigSink = acc;
+  result.ns_per_call =
+      std::chrono::duration<double, std::nano>(end - start).count() /
+      inputs.size();
+  return result;
+}
+
+static void printRow(const char *name, const TrigResult &r) {
+  printf("| %s | %.2e | %.4f | %.1f |\n", name, r.maxError_deg,
+         r.worstAngle_deg, r.ns_per_call);
+}
+
+int main(int argc, char **argv) {
+  size_t points = 2000000;
+  if (argc >= 2) {
+    points = (size_t)atol(argv[1]);
+  }
+
+  // -1 to 1 inclusive for asin and acos
+  std::vector<float> unit(points);
+  for (size_t k = 0; k < points; k++) {
+    unit[k] = (float)(-1.0 + 2.0 * k / (points - 1));
+  }
+
+  // atan: half the points evenly over -2 to 2, half log spaced out to 1E6
+  std::vector<float> line;
+  for (size_t k = 0; k < points / 2; k++) {
+    line.push_back((float)(-2.0 + 4.0 * k / (points / 2 - 1)));
+  }
+  for (size_t k = 0; k < points / 4; k++) {
+    float x = (float)pow(10.0, -6.0 + 12.0 * k / (points / 4 - 1));
+    line.push_back(x);
+    line.push_back(-x);
+  }
+
+  // atan2: angles around the full circle, passed as the index into a table
+  // of (y, x) pairs so every version sees the same inputs
+  std::vector<float> ys(points), xs(points), index(points);
+  for (size_t k = 0; k < points; k++) {
+    double a = -M_PI + 2.0 * M_PI * k / points;
+    double r = 0.1 + 10.0 * k / points;
+    ys[k] = (float)(r * sin(a));
+    xs[k] = (float)(r * cos(a));
+    index[k] = (float)k;
+  }
+
+#ifdef AHRS_TRIG_LUT
+  printf("atan kernel: %d interval table (AHRS_TRIG_LUT)\n\n",
+         ATAN_LUT_INTERVALS);
+#else
+  printf("atan kernel: Pade[3/2]\n\n");
+#endif
+  printf("| function | max error (deg) | at angle (deg) | ns/call |\n");
+  printf("|---|---|---|---|\n");
+
+  printRow("fasin_deg", sweep(unit, fasin_deg, [](double x) {
+             return asin(x) * TRIG_RAD2DEG;
+           }));
+  printRow("facos_deg", sweep(unit, facos_deg, [](double x) {
+             return acos(x) * TRIG_RAD2DEG;
+           }));
+  printRow("fatan_deg", sweep(line, fatan_deg, [](double x) {
+             return atan(x) * TRIG_RAD2DEG;
+           }));
+  printRow("fatan2_deg",
+           sweep(
+               index,
+               [&](float k) {
+                 return fatan2_deg(ys[(size_t)k], xs[(size_t)k]);
+               },
+               [&](double k) {
+                 return atan2((double)ys[(size_t)k], (double)xs[(size_t)k]) *
+                        TRIG_RAD2DEG;
+               }));
+
+  return 0;
+}
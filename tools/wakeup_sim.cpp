@@ -0,0 +1,211 @@
+// Pad wake-up simulator.
+//
+// Runs synthetic flights through LSM6DSOXWakeUpModel, the host model of the
+// LSM6DSOX wake-up engine as LSM6DSOXWakeUp programs it, and through the pad
+// idle logic of src/main.cpp: poll the latched event every poll interval,
+// then run at full rate until the hold time passes without another one. It
+// prints how long after liftoff the full-rate pipeline is running, how often
+// handling on the pad wakes it and how much of the pad time it spends awake.
+//
+// Usage: wakeup_sim [thresholdLsb duration] [poll_ms hold_ms] [runs]
+// Defaults to the flight configuration: WAKE_UP_THS_LSB, WAKE_UP_DUR_ODR from
+// LSM6DSOXWakeUpModel.h and the 50 ms / 10 s of src/main.cpp, 20 runs.
+//
+// See tools/README.md for build instructions.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "LSM6DSOXWakeUpModel.h"
+#include "TrajectoryGenerator.h"
+
+struct WakeUpConfig {
+  uint8_t thresholdLsb;
+  uint8_t duration;
+  uint32_t poll_ms;
+  uint32_t hold_ms;
+};
+
+struct WakeUpResult {
+  bool woke;          // full rate at some point after liftoff
+  int32_t latency_ms; // full rate start minus liftoff, 0 if already awake
+  int padWakeUps;     // idle to full rate switches before liftoff
+  uint32_t padAwake_ms;
+};
+
+static std::vector<TrajectoryParams> simulatorScenarios() {
+  std::vector<TrajectoryParams> scenarios;
+  TrajectoryParams p;
+
+  p.name = "nominal boxcar 8g";
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "regressive 4g slow rise";
+  p.thrustShape = THRUST_REGRESSIVE;
+  p.peakThrust_ms2 = 40.0f;
+  p.thrustRise_s = 0.3f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "progressive 3g slow rise";
+  p.thrustShape = THRUST_PROGRESSIVE;
+  p.peakThrust_ms2 = 30.0f;
+  p.thrustRise_s = 0.5f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "high thrust 15g";
+  p.peakThrust_ms2 = 150.0f;
+  p.burnTime_s = 1.0f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "pad bumps short";
+  p.padBumps = 6;
+  p.padBump_ms2 = 60.0f;
+  p.padBump_s = 0.05f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "pad bumps light";
+  p.padBumps = 6;
+  p.padBump_ms2 = 15.0f;
+  p.padBump_s = 0.3f;
+  scenarios.push_back(p);
+
+  // No flight at all: every wake-up is handling
+  p = TrajectoryParams();
+  p.name = "pad only, rough handling";
+  p.padTime_s = 120.0f;
+  p.flightTime_s = 0.0f;
+  p.padBumps = 20;
+  p.padBump_ms2 = 50.0f;
+  p.padBump_s = 0.3f;
+  p.vibration_ms2 = 5.0f;
+  scenarios.push_back(p);
+
+  p = TrajectoryParams();
+  p.name = "pad only, quiet";
+  p.padTime_s = 120.0f;
+  p.flightTime_s = 0.0f;
+  scenarios.push_back(p);
+
+  return scenarios;
+}
+
+static WakeUpResult simulate(const Trajectory &traj, const WakeUpConfig &cfg) {
+  LSM6DSOXWakeUpModel engine(cfg.thresholdLsb, cfg.duration);
+  WakeUpResult result = {false, 0, 0, 0};
+
+  bool latched = false;   // WU_IA waiting to be read
+  bool awake = false;     // full-rate pipeline running
+  uint32_t wakeUp_ms = 0; // last wake-up the firmware saw
+  uint32_t nextPoll_ms = 0;
+  uint32_t last_ms = 0;
+
+  for (const TrajectorySample &s : traj.samples) {
+    if (engine.update(s.ax / TRAJ_GRAVITY_MS2, s.ay / TRAJ_GRAVITY_MS2,
+                      s.az / TRAJ_GRAVITY_MS2)) {
+      latched = true;
+    }
+
+    const bool pad = s.time_ms < traj.liftoffTime_ms;
+    if (pad && awake) {
+      result.padAwake_ms += s.time_ms - last_ms;
+    }
+    last_ms = s.time_ms;
+
+    // Awake the loop polls every pass, idle only every poll interval
+    if (!awake && s.time_ms < nextPoll_ms) {
+      continue;
+    }
+    nextPoll_ms = s.time_ms + cfg.poll_ms;
+    if (latched) {
+      latched = false;
+      if (!awake && pad) {
+        result.padWakeUps++;
+      }
+      awake = true;
+      wakeUp_ms = s.time_ms;
+    } else if (awake && s.time_ms - wakeUp_ms >= cfg.hold_ms) {
+      awake = false;
+    }
+
+    if (!pad && awake && !result.woke) {
+      result.woke = true;
+      result.latency_ms = (int32_t)s.time_ms - (int32_t)traj.liftoffTime_ms;
+    }
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  WakeUpConfig cfg = {WAKE_UP_THS_LSB, WAKE_UP_DUR_ODR, 50, 10000};
+  int runs = 20;
+
+  if (argc >= 3) {
+    cfg.thresholdLsb = (uint8_t)atoi(argv[1]);
+    cfg.duration = (uint8_t)atoi(argv[2]);
+  }
+  if (argc >= 5) {
+    cfg.poll_ms = (uint32_t)atoi(argv[3]);
+    cfg.hold_ms = (uint32_t)atoi(argv[4]);
+  }
+  if (argc == 2 || argc == 6) {
+    runs = atoi(argv[argc - 1]);
+  }
+
+  LSM6DSOXWakeUpModel engine(cfg.thresholdLsb, cfg.duration);
+  printf("Wake-up %.2f g for %u samples at %g Hz, poll %u ms, hold %u ms, "
+         "%d runs per scenario\n\n",
+         engine.getThreshold_g(), cfg.duration, WAKE_UP_ODR_HZ, cfg.poll_ms,
+         cfg.hold_ms, runs);
+  printf("| scenario | woke | median latency (ms) | max latency (ms) "
+         "| pad wake-ups per run | pad time awake (%%) |\n");
+  printf("|---|---:|---:|---:|---:|---:|\n");
+
+  for (TrajectoryParams params : simulatorScenarios()) {
+    // The engine runs at its own rate whatever the pipeline samples at
+    params.sampleRate_hz = WAKE_UP_ODR_HZ;
+    std::vector<int32_t> latencies;
+    int woke = 0;
+    int padWakeUps = 0;
+    double padAwake_ms = 0.0;
+    const bool hasFlight = params.flightTime_s > 0.0f;
+
+    for (int run = 0; run < runs; run++) {
+      params.seed = 1000u + (uint32_t)run;
+      Trajectory traj = generateTrajectory(params);
+      WakeUpResult result = simulate(traj, cfg);
+      padWakeUps += result.padWakeUps;
+      padAwake_ms += result.padAwake_ms;
+      if (result.woke) {
+        woke++;
+        latencies.push_back(result.latency_ms);
+      }
+    }
+
+    char median[16] = "-";
+    char worst[16] = "-";
+    if (!latencies.empty()) {
+      std::sort(latencies.begin(), latencies.end());
+      snprintf(median, sizeof(median), "%d",
+               (int)latencies[latencies.size() / 2]);
+      snprintf(worst, sizeof(worst), "%d", (int)latencies.back());
+    }
+
+    char wokeCol[16] = "-";
+    if (hasFlight) {
+      snprintf(wokeCol, sizeof(wokeCol), "%d/%d", woke, runs);
+    }
+
+    printf("| %s | %s | %s | %s | %.1f | %.1f |\n", params.name.c_str(),
+           wokeCol, median, worst, (double)padWakeUps / runs,
+           100.0 * padAwake_ms / (runs * params.padTime_s * 1000.0));
+  }
+
+  return 0;
+}